@@ -0,0 +1,629 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Headless benchmark of VertexUtils mesh processing functions, over
+ * synthetic grid and sphere meshes. No render system (nor Ogre::Root) is
+ * needed. Results are written as JSON.
+ *
+ * Where fork is available, each case runs on its own child process, so its
+ * peakRssBytes is the peak of that case alone (including its input mesh).
+ * Elsewhere it's written as null, as the process high-water mark would
+ * only reflect the biggest case run so far.
+ *
+ * Usage: goblin_bench_vertexutils [options]
+ *    --max-triangles N   biggest mesh to generate (default 10000000)
+ *    --threads a,b,c     thread counts to test (default 1, 2, 4, ... cores)
+ *    --repeat N          runs of each case, keeping the fastest (default 3)
+ *    --simd scalar|4|8   widest SIMD path to use (default: best available)
+ *    --output file       write JSON to file instead of stdout */
+
+#include "vertexutils.h"
+
+#if OGRE_VERSION_MAJOR >= 2
+
+#include <OGRE/OgreTimer.h>
+#include <OGRE/OgrePlatformInformation.h>
+#include <OGRE/Threading/OgreThreads.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+   #include <windows.h>
+   #include <psapi.h>
+#else
+   #include <sys/resource.h>
+   #include <sys/wait.h>
+   #include <unistd.h>
+   #define BENCH_FORK_CASES
+#endif
+
+using namespace Goblin;
+
+/* Vertex: position, normal, tangent (float4), uv */
+#define BENCH_FLOATS_PER_VERTEX  12
+#define BENCH_BYTES_PER_VERTEX   (BENCH_FLOATS_PER_VERTEX * 4)
+#define BENCH_POS_STRIDE         0
+#define BENCH_NORMAL_STRIDE      12
+#define BENCH_TANGENT_STRIDE     24
+#define BENCH_UV_STRIDE          40
+
+typedef StaticVertexLayout<BENCH_FLOATS_PER_VERTEX, 0, 3, 6, 10> BenchLayout;
+
+/*! A synthetic mesh */
+class BenchMesh
+{
+   public:
+      std::string name;
+      std::vector<float> vertices;
+      std::vector<Ogre::uint32> indices;
+
+      uint32_t numVertices() const
+      {
+         return (uint32_t)(vertices.size() / BENCH_FLOATS_PER_VERTEX);
+      }
+      uint32_t numIndices() const { return (uint32_t)indices.size(); }
+      uint8_t* data() { return reinterpret_cast<uint8_t*>(&vertices[0]); }
+
+      /*! Set a vertex */
+      void setVertex(uint32_t i, float px, float py, float pz, float nx,
+            float ny, float nz, float u, float v)
+      {
+         float* f = &vertices[i * BENCH_FLOATS_PER_VERTEX];
+         f[0] = px; f[1] = py; f[2] = pz;
+         f[3] = nx; f[4] = ny; f[5] = nz;
+         f[6] = 0.0f; f[7] = 0.0f; f[8] = 0.0f; f[9] = 1.0f;
+         f[10] = u; f[11] = v;
+      }
+
+      /*! Triangulate a (rows + 1) x (columns + 1) vertex lattice */
+      void createLattice(uint32_t rows, uint32_t columns)
+      {
+         indices.resize(rows * columns * 6);
+         uint32_t cur = 0;
+         for(uint32_t r = 0; r < rows; r++)
+         {
+            for(uint32_t c = 0; c < columns; c++)
+            {
+               uint32_t a = r * (columns + 1) + c;
+               uint32_t b = a + columns + 1;
+               indices[cur++] = a;
+               indices[cur++] = b;
+               indices[cur++] = a + 1;
+               indices[cur++] = a + 1;
+               indices[cur++] = b;
+               indices[cur++] = b + 1;
+            }
+         }
+      }
+
+      /*! Create a slightly waved grid with about numTriangles */
+      void createGrid(uint32_t numTriangles)
+      {
+         name = "grid";
+         uint32_t side = (uint32_t)ceil(sqrt(numTriangles / 2.0));
+         vertices.resize((side + 1) * (side + 1) * BENCH_FLOATS_PER_VERTEX);
+         for(uint32_t z = 0; z <= side; z++)
+         {
+            for(uint32_t x = 0; x <= side; x++)
+            {
+               float u = x / (float)side;
+               float v = z / (float)side;
+               setVertex(z * (side + 1) + x, u * 100.0f,
+                     sinf(u * 20.0f) * cosf(v * 20.0f), v * 100.0f,
+                     0.0f, 1.0f, 0.0f, u, v);
+            }
+         }
+         createLattice(side, side);
+      }
+
+      /*! Create an uv sphere with about numTriangles */
+      void createSphere(uint32_t numTriangles)
+      {
+         name = "sphere";
+         uint32_t rings = (uint32_t)ceil(sqrt(numTriangles / 4.0));
+         if(rings < 2)
+         {
+            rings = 2;
+         }
+         uint32_t segments = rings * 2;
+         vertices.resize((rings + 1) * (segments + 1) *
+               BENCH_FLOATS_PER_VERTEX);
+         for(uint32_t r = 0; r <= rings; r++)
+         {
+            float theta = Ogre::Math::PI * r / rings;
+            for(uint32_t s = 0; s <= segments; s++)
+            {
+               float phi = Ogre::Math::TWO_PI * s / segments;
+               float nx = sinf(theta) * cosf(phi);
+               float ny = cosf(theta);
+               float nz = sinf(theta) * sinf(phi);
+               setVertex(r * (segments + 1) + s, nx * 10.0f, ny * 10.0f,
+                     nz * 10.0f, nx, ny, nz, s / (float)segments,
+                     r / (float)rings);
+            }
+         }
+         createLattice(rings, segments);
+      }
+};
+
+/*! Shared information of the threads running a step by hand */
+class BenchThreadInfo
+{
+   public:
+      BenchMesh* mesh;
+      Ogre::Vector3* uvBuffer;
+      size_t numThreads;
+      bool merging;
+
+      void run(size_t threadIdx)
+      {
+         uint32_t numVertices = mesh->numVertices();
+         if(!merging)
+         {
+            uint32_t numTriangles = mesh->numIndices() / 3;
+            uint32_t first = (uint32_t)((((Ogre::uint64)numTriangles) *
+                     threadIdx) / numThreads);
+            uint32_t last = (uint32_t)((((Ogre::uint64)numTriangles) *
+                     (threadIdx + 1)) / numThreads);
+            Ogre::Vector3* out = uvBuffer + numVertices * 2u * threadIdx;
+            for(uint32_t i = 0; i < numVertices * 2u; i++)
+            {
+               out[i] = Ogre::Vector3::ZERO;
+            }
+            VertexUtils::generateTanUV(mesh->data(),
+                  &mesh->indices[first * 3], BENCH_BYTES_PER_VERTEX,
+                  numVertices, (last - first) * 3, BENCH_POS_STRIDE,
+                  BENCH_NORMAL_STRIDE, BENCH_TANGENT_STRIDE,
+                  BENCH_UV_STRIDE, out);
+         }
+         else
+         {
+            uint32_t first = (uint32_t)((((Ogre::uint64)numVertices) *
+                     threadIdx) / numThreads);
+            uint32_t last = (uint32_t)((((Ogre::uint64)numVertices) *
+                     (threadIdx + 1)) / numThreads);
+            VertexUtils::generateTangentsMergeTUVRange(mesh->data(),
+                  BENCH_BYTES_PER_VERTEX, numVertices, BENCH_NORMAL_STRIDE,
+                  BENCH_TANGENT_STRIDE, uvBuffer, numThreads, first, last);
+         }
+      }
+};
+
+unsigned long benchWorkerThread(Ogre::ThreadHandle* threadHandle)
+{
+   BenchThreadInfo* info = reinterpret_cast<BenchThreadInfo*>(
+         threadHandle->getUserParam());
+   info->run(threadHandle->getThreadIdx());
+   return 0;
+}
+THREAD_DECLARE(benchWorkerThread);
+
+/*! \return peak resident set size of the process so far, in bytes */
+static size_t getPeakRss()
+{
+#if defined(_WIN32)
+   PROCESS_MEMORY_COUNTERS counters;
+   GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+   return counters.PeakWorkingSetSize;
+#else
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   #if defined(__APPLE__)
+      return usage.ru_maxrss;
+   #else
+      return usage.ru_maxrss * 1024;
+   #endif
+#endif
+}
+
+/*! The benchmark itself */
+class VertexUtilsBench
+{
+   public:
+      VertexUtilsBench()
+      {
+         repeat = 3;
+         first = true;
+         isolated = false;
+         out = stdout;
+      }
+
+      /*! The cases run over each mesh (and thread count) */
+      enum BenchCase
+      {
+         BENCH_CASE_SERIAL,
+         BENCH_CASE_STEPS,
+         BENCH_CASE_PER_THREAD,
+         BENCH_CASE_VERTEX_OWNER
+      };
+
+      /*! Run a case, on its own child process if possible (see
+       * #isolated). */
+      void runCase(BenchMesh& mesh, BenchCase benchCase, size_t numThreads)
+      {
+#if defined(BENCH_FORK_CASES)
+         fflush(out);
+         fflush(stderr);
+         pid_t pid = fork();
+         if(pid == 0)
+         {
+            isolated = true;
+            runCaseHere(mesh, benchCase, numThreads);
+            fflush(out);
+            fflush(stderr);
+            _exit(0);
+         }
+         else if(pid > 0)
+         {
+            int status = 0;
+            if((waitpid(pid, &status, 0) == pid) && (WIFEXITED(status)) &&
+               (WEXITSTATUS(status) == 0))
+            {
+               first = false;
+            }
+            else
+            {
+               fprintf(stderr, "%s %u tris: case %d (%u threads) failed\n",
+                     mesh.name.c_str(), mesh.numIndices() / 3, 
+                     (int)benchCase, (unsigned)numThreads);
+            }
+            return;
+         }
+         /* Couldn't fork: run it here (without its peak memory) */
+#endif
+         runCaseHere(mesh, benchCase, numThreads);
+      }
+
+      /*! Run a case on the current process */
+      void runCaseHere(BenchMesh& mesh, BenchCase benchCase, 
+            size_t numThreads)
+      {
+         switch(benchCase)
+         {
+            case BENCH_CASE_SERIAL:
+               runSerial(mesh);
+            break;
+            case BENCH_CASE_STEPS:
+               runSteps(mesh, numThreads);
+            break;
+            case BENCH_CASE_PER_THREAD:
+               runParallel(mesh, numThreads,
+                     VertexUtils::TANGENT_ACCUMULATION_PER_THREAD);
+            break;
+            case BENCH_CASE_VERTEX_OWNER:
+               runParallel(mesh, numThreads,
+                     VertexUtils::TANGENT_ACCUMULATION_VERTEX_OWNER);
+            break;
+         }
+      }
+
+      /*! Run step 01 (generateTanUV) and step 02 (MergeTUV) by hand, with
+       * numThreads, timing each one. */
+      void runSteps(BenchMesh& mesh, size_t numThreads)
+      {
+         BenchThreadInfo info;
+         info.mesh = &mesh;
+         info.numThreads = numThreads;
+         info.uvBuffer = new Ogre::Vector3[mesh.numVertices() * 2u *
+            numThreads];
+
+         Ogre::ThreadHandleVec threads;
+         threads.resize(numThreads - 1);
+         const char* names[2] = {"generateTanUV",
+                                 "generateTangentsMergeTUV"};
+         double best[2] = {-1.0, -1.0};
+         for(int r = 0; r < repeat; r++)
+         {
+            for(int step = 0; step < 2; step++)
+            {
+               info.merging = (step == 1);
+               timer.reset();
+               for(size_t i = 1; i < numThreads; i++)
+               {
+                  threads[i - 1] = Ogre::Threads::CreateThread(
+                        THREAD_GET(benchWorkerThread), i, &info);
+               }
+               info.run(0);
+               if(!threads.empty())
+               {
+                  Ogre::Threads::WaitForThreads(threads);
+               }
+               double elapsed = timer.getMicroseconds() / 1000000.0;
+               if((best[step] < 0.0) || (elapsed < best[step]))
+               {
+                  best[step] = elapsed;
+               }
+            }
+         }
+         delete[] info.uvBuffer;
+
+         size_t scratch = sizeof(Ogre::Vector3) * mesh.numVertices() * 2u *
+            numThreads;
+         for(int step = 0; step < 2; step++)
+         {
+            writeResult(mesh, names[step], numThreads, "perThread",
+                  best[step], scratch);
+         }
+      }
+
+      /*! Time the parallel driver with an accumulation mode */
+      void runParallel(BenchMesh& mesh, size_t numThreads,
+            VertexUtils::TangentAccumulation accumulation)
+      {
+         double best = -1.0;
+         for(int r = 0; r < repeat; r++)
+         {
+            timer.reset();
+            VertexUtils::generateTangentsParallel(mesh.data(),
+                  &mesh.indices[0], BENCH_BYTES_PER_VERTEX,
+                  mesh.numVertices(), mesh.numIndices(), BENCH_POS_STRIDE,
+                  BENCH_NORMAL_STRIDE, BENCH_TANGENT_STRIDE,
+                  BENCH_UV_STRIDE, numThreads, accumulation);
+            double elapsed = timer.getMicroseconds() / 1000000.0;
+            if((best < 0.0) || (elapsed < best))
+            {
+               best = elapsed;
+            }
+         }
+         writeResult(mesh, "generateTangentsParallel",
+               VertexUtils::getTangentThreadCount(mesh.numIndices(),
+                  numThreads),
+               (accumulation == VertexUtils::TANGENT_ACCUMULATION_PER_THREAD)
+                  ? "perThread" : "vertexOwner", best,
+               VertexUtils::getTangentScratchSize(mesh.numVertices(),
+                  mesh.numIndices(), numThreads, accumulation));
+      }
+
+      /*! Time the single threaded generateTangents (with a runtime and
+       * with a compile time vertex layout) */
+      void runSerial(BenchMesh& mesh)
+      {
+         VertexLayout layout(BENCH_FLOATS_PER_VERTEX, 0, 3, 6, 10);
+         double best[2] = {-1.0, -1.0};
+         for(int r = 0; r < repeat; r++)
+         {
+            for(int l = 0; l < 2; l++)
+            {
+               timer.reset();
+               if(l == 0)
+               {
+                  VertexUtils::generateTangents(&mesh.vertices[0],
+                        &mesh.indices[0], mesh.numVertices(),
+                        mesh.numIndices(), layout);
+               }
+               else
+               {
+                  VertexUtils::generateTangents(&mesh.vertices[0],
+                        &mesh.indices[0], mesh.numVertices(),
+                        mesh.numIndices(), BenchLayout());
+               }
+               double elapsed = timer.getMicroseconds() / 1000000.0;
+               if((best[l] < 0.0) || (elapsed < best[l]))
+               {
+                  best[l] = elapsed;
+               }
+            }
+         }
+         size_t scratch = sizeof(Ogre::Vector3) * mesh.numVertices() * 2u;
+         writeResult(mesh, "generateTangents", 1, "runtimeLayout", best[0],
+               scratch);
+         writeResult(mesh, "generateTangents", 1, "staticLayout", best[1],
+               scratch);
+      }
+
+      /*! Write a single result entry */
+      void writeResult(BenchMesh& mesh, const char* function,
+            size_t numThreads, const char* variant, double seconds,
+            size_t scratchBytes)
+      {
+         uint32_t numTriangles = mesh.numIndices() / 3;
+         char peakRss[32];
+         if(isolated)
+         {
+            snprintf(peakRss, sizeof(peakRss), "%lu", 
+                  (unsigned long)getPeakRss());
+         }
+         else
+         {
+            strcpy(peakRss, "null");
+         }
+         fprintf(out, "%s\n    {\"mesh\": \"%s\", \"triangles\": %u, "
+               "\"vertices\": %u, \"function\": \"%s\", "
+               "\"variant\": \"%s\", \"threads\": %u, "
+               "\"seconds\": %.6f, \"trianglesPerSecond\": %.1f, "
+               "\"scratchBytes\": %lu, \"peakRssBytes\": %s}",
+               (first) ? "" : ",", mesh.name.c_str(), numTriangles,
+               mesh.numVertices(), function, variant, (unsigned)numThreads,
+               seconds, (seconds > 0.0) ? numTriangles / seconds : 0.0,
+               (unsigned long)scratchBytes, peakRss);
+         fflush(out);
+         first = false;
+         fprintf(stderr, "%s %u tris: %s (%s) %u threads: %.2f Mtris/s\n",
+               mesh.name.c_str(), numTriangles, function, variant,
+               (unsigned)numThreads,
+               (seconds > 0.0) ? numTriangles / seconds / 1000000.0 : 0.0);
+      }
+
+      /*! Run all cases */
+      void run(uint32_t maxTriangles, const std::vector<size_t>& threads)
+      {
+         const char* simdNames[3] = {"scalar", "4", "8"};
+         fprintf(out, "{\n  \"benchmark\": \"vertexutils\",\n"
+               "  \"logicalCores\": %u,\n  \"simdPath\": \"%s\",\n"
+               "  \"repeat\": %d,\n  \"results\": [",
+               (unsigned)Ogre::PlatformInformation::getNumLogicalCores(),
+               simdNames[VertexUtils::getSimdPath()], repeat);
+
+         for(uint32_t tris = 1000; tris <= maxTriangles; tris *= 10)
+         {
+            for(int type = 0; type < 2; type++)
+            {
+               BenchMesh mesh;
+               if(type == 0)
+               {
+                  mesh.createGrid(tris);
+               }
+               else
+               {
+                  mesh.createSphere(tris);
+               }
+
+               runCase(mesh, BENCH_CASE_SERIAL, 1);
+               for(size_t t = 0; t < threads.size(); t++)
+               {
+                  runCase(mesh, BENCH_CASE_STEPS, threads[t]);
+                  runCase(mesh, BENCH_CASE_PER_THREAD, threads[t]);
+                  runCase(mesh, BENCH_CASE_VERTEX_OWNER, threads[t]);
+               }
+            }
+         }
+
+         fprintf(out, "\n  ]\n}\n");
+      }
+
+      int repeat;     /**< Runs of each case (keeping the fastest) */
+      FILE* out;      /**< Where to write the JSON */
+
+   private:
+      Ogre::Timer timer;
+      bool first;     /**< If no result was written yet */
+      /*! If running a single case on its own child process, thus with 
+       * a meaningful peak resident set size. */
+      bool isolated;
+};
+
+/***********************************************************************
+ *                                main                                 *
+ ***********************************************************************/
+int main(int argc, char* argv[])
+{
+   VertexUtilsBench bench;
+   uint32_t maxTriangles = 10000000;
+   std::vector<size_t> threads;
+   const char* outputFile = NULL;
+
+   for(int i = 1; i < argc; i++)
+   {
+      bool hasValue = (i + 1 < argc);
+      if((strcmp(argv[i], "--max-triangles") == 0) && (hasValue))
+      {
+         maxTriangles = (uint32_t)strtoul(argv[++i], NULL, 10);
+      }
+      else if((strcmp(argv[i], "--threads") == 0) && (hasValue))
+      {
+         char* cur = argv[++i];
+         while(*cur != '\0')
+         {
+            char* end;
+            size_t t = (size_t)strtoul(cur, &end, 10);
+            if(end == cur)
+            {
+               break;
+            }
+            if(t > 0)
+            {
+               threads.push_back(t);
+            }
+            cur = (*end == ',') ? end + 1 : end;
+         }
+      }
+      else if((strcmp(argv[i], "--repeat") == 0) && (hasValue))
+      {
+         bench.repeat = atoi(argv[++i]);
+         if(bench.repeat < 1)
+         {
+            bench.repeat = 1;
+         }
+      }
+      else if((strcmp(argv[i], "--simd") == 0) && (hasValue))
+      {
+         i++;
+         if(strcmp(argv[i], "scalar") == 0)
+         {
+            VertexUtils::setSimdPath(VertexUtils::SIMD_PATH_SCALAR);
+         }
+         else if(strcmp(argv[i], "4") == 0)
+         {
+            VertexUtils::setSimdPath(VertexUtils::SIMD_PATH_4);
+         }
+         else
+         {
+            VertexUtils::setSimdPath(VertexUtils::SIMD_PATH_8);
+         }
+      }
+      else if((strcmp(argv[i], "--output") == 0) && (hasValue))
+      {
+         outputFile = argv[++i];
+      }
+      else
+      {
+         fprintf(stderr, "Usage: %s [--max-triangles N] [--threads a,b,c] "
+               "[--repeat N] [--simd scalar|4|8] [--output file]\n",
+               argv[0]);
+         return 1;
+      }
+   }
+
+   if(threads.empty())
+   {
+      size_t cores = Ogre::PlatformInformation::getNumLogicalCores();
+      for(size_t t = 1; t < cores; t *= 2)
+      {
+         threads.push_back(t);
+      }
+      threads.push_back((cores > 0) ? cores : 1);
+   }
+
+   if(outputFile)
+   {
+      bench.out = fopen(outputFile, "w");
+      if(!bench.out)
+      {
+         fprintf(stderr, "Couldn't open '%s' for writing\n", outputFile);
+         return 1;
+      }
+   }
+
+   bench.run(maxTriangles, threads);
+
+   if(outputFile)
+   {
+      fclose(bench.out);
+   }
+
+   return 0;
+}
+
+#else
+
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+   fprintf(stderr, "VertexUtils benchmark needs Ogre 2.1 or newer.\n");
+   return 1;
+}
+
+#endif
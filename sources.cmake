@@ -11,12 +11,18 @@ src/guiobject.cpp
 src/ibar.cpp
 src/ibutton.cpp
 src/image.cpp
+src/mappedfile.cpp
 src/model3d.cpp
+src/modelmanager.cpp
 src/materiallistener.cpp
+src/meshbvh.cpp
+src/meshcache.cpp
+src/sceneindex.cpp
 src/screeninfo.cpp
 src/textbox.cpp
 src/texttitle.cpp
 src/vertexutils.cpp
+src/vertexutils_avx2.cpp
 )
 
 set(GOBLIN_HEADERS
@@ -29,13 +35,24 @@ src/ibar.h
 src/ibutton.h
 src/image.h
 src/model3d.h
+src/modelmanager.h
 src/materiallistener.h
+src/meshbvh.h
+src/meshcache.h
+src/sceneindex.h
 src/screeninfo.h
 src/textbox.h
 src/texttitle.h
 src/vertexutils.h
 )
 
+# Internal headers (not installed)
+set(GOBLIN_PRIVATE_HEADERS
+src/mappedfile.h
+src/vertexutils_avx2.h
+src/simd.h
+)
+
 if(${CMAKE_SYSTEM_NAME} STREQUAL "Android")
 set(GOBLIN_SOURCES
    ${GOBLIN_SOURCES}
@@ -44,3 +61,20 @@ set(GOBLIN_SOURCES
 endif(${CMAKE_SYSTEM_NAME} STREQUAL "Android")
  
 
+########################################################################
+# Benchmark tools
+########################################################################
+set(GOBLIN_BENCH_VERTEXUTILS_SOURCES
+bench/benchvertexutils.cpp
+src/vertexutils.cpp
+src/vertexutils_avx2.cpp
+)
+
+########################################################################
+# Tests
+########################################################################
+set(GOBLIN_TEST_VERTEXUTILS_SOURCES
+tests/testvertexutils.cpp
+src/vertexutils.cpp
+src/vertexutils_avx2.cpp
+)
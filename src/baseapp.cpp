@@ -21,6 +21,8 @@
 #include "baseapp.h"
 #include "camera.h"
 #include "screeninfo.h"
+#include "meshcache.h"
+#include "modelmanager.h"
 #include <kosound/sound.h>
 #include <kobold/userinfo.h>
 #include <kobold/ogre3d/i18n.h>
@@ -707,6 +709,11 @@ bool BaseApp::create(const Ogre::String& userHome, Ogre::uint32 wX,
    /* Add Cache temporary dir */
    Ogre::ResourceGroupManager::getSingleton().addResourceLocation(
          Kobold::UserInfo::getCacheDirectory(), "FileSystem", "cache", false);
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+   /* Persist cached collision meshes there too */
+   MeshCache::setDiskCacheDirectory(Kobold::UserInfo::getCacheDirectory());
+#endif
 
 
 #if OGRE_PLATFORM != OGRE_PLATFORM_APPLE_IOS &&\
@@ -975,8 +982,37 @@ void BaseApp::run()
     OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
          exit |= shouldQuit();
 #endif
+         /* Update the models, applying them before the render */
+         if(shouldUpdateModels())
+         {
+            ModelManager::prepare(ogreSceneManager);
+            ModelManager::commit();
+#if OGRE_PLATFORM != OGRE_PLATFORM_APPLE_IOS &&\
+    OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+            if(shouldInterpolateModels())
+            {
+               /* Just stepped: still at the previous step */
+               ModelManager::interpolate(0.0f);
+            }
+#endif
+         }
+
          /* Render the frame and update the window */
          renderFrame();
+#if OGRE_PLATFORM != OGRE_PLATFORM_APPLE_IOS &&\
+    OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+         if((shouldUpdateModels()) && (shouldInterpolateModels()))
+         {
+            /* Back to the current step, for the app cycle and queries */
+            ModelManager::restore();
+         }
+#endif
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+         /* Finish the cached mesh reads done by the GPU */
+         MeshCache::update();
+#endif
          
          /* Do the specific after-render app cycle */
          doAfterRender();
@@ -992,6 +1028,19 @@ void BaseApp::run()
          
 #if OGRE_PLATFORM != OGRE_PLATFORM_APPLE_IOS &&\
     OGRE_PLATFORM != OGRE_PLATFORM_ANDROID
+      }
+      else if((shouldUpdateModels()) && (shouldInterpolateModels()))
+      {
+         /* Render, between the updates, the models interpolated to the
+          * time passed since the last one. */
+         ModelManager::interpolate(updateTimer.getMicroseconds() / 
+               (BASE_APP_UPDATE_RATE * 1000.0f));
+         renderFrame();
+         ModelManager::restore();
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+         MeshCache::update();
+#endif
       }
       else if((BASE_APP_UPDATE_RATE - 1) - ((long)timeElapsed) > 0 )
       {
@@ -205,6 +205,20 @@ class BaseApp
 
       /*! \return if should use Kobold::I18n for internationalization. */
       virtual const bool shouldUseKoboldI18n() const { return true; };
+
+      /*! \return if should update all Model3d on each frame, with
+       * ModelManager::prepare (at the scene manager worker threads) and 
+       * ModelManager::commit, just before rendering it. If true, the
+       * application shouldn't call Model3d::update itself. */
+      virtual const bool shouldUpdateModels() const { return false; };
+      /*! \return if should render frames between the fixed rate updates,
+       * with the models updated by #shouldUpdateModels interpolated 
+       * between their last two steps (see ModelManager::interpolate).
+       * Only on desktop platforms, and the render will be a step behind
+       * the simulation. The nodes are interpolated just for the render: 
+       * out of it (ie: on doBeforeRender and doAfterRender) they are at 
+       * the current step, as got by Model3d::getPosition and others. */
+      virtual const bool shouldInterpolateModels() const { return false; };
       
 #if (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR < 2)
       /*! \return if should use BC5 compressed textures (usually .dds) for
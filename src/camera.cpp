@@ -1062,6 +1062,14 @@ bool Camera::isVisible(Ogre::AxisAlignedBox bbox)
 {
    return ogreCamera->isVisible(bbox);
 }
+
+/***********************************************************************
+ *                              isVisible                              *
+ ***********************************************************************/
+bool Camera::isVisible(const Ogre::Sphere& sphere)
+{
+   return ogreCamera->isVisible(sphere);
+}
    
 /***********************************************************************
  *                           enableRotations                           *
@@ -31,6 +31,7 @@
 #endif
 #include <OGRE/OgreMath.h>
 #include <OGRE/OgreRay.h>
+#include <OGRE/OgreSphere.h>
 
 #include <kobold/target.h>
 #include <kobold/keycodes.h>
@@ -219,6 +220,10 @@ class Camera
        * \param bbox -> bounding box defining the object 
        * \return -> true if visible, false otherwise */
       static bool isVisible(Ogre::AxisAlignedBox bbox);
+      /*! Verify if the object under sphere is visible at the current camera
+       * \param sphere -> bounding sphere defining the object
+       * \return -> true if visible, false otherwise */
+      static bool isVisible(const Ogre::Sphere& sphere);
    
       /*! Enable camera rotations inputs */
       static void enableRotations();
@@ -0,0 +1,134 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mappedfile.h"
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+   #include "windows.h"
+#else
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+using namespace Goblin;
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+MappedFile::MappedFile()
+{
+   data = NULL;
+   size = 0;
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+   mapping = NULL;
+#endif
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+MappedFile::~MappedFile()
+{
+   close();
+}
+
+/***********************************************************************
+ *                                 open                                *
+ ***********************************************************************/
+bool MappedFile::open(const Ogre::String& fileName)
+{
+   close();
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+   HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, 
+         FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      return false;
+   }
+   LARGE_INTEGER fileSize;
+   if((!GetFileSizeEx(file, &fileSize)) || (fileSize.QuadPart == 0))
+   {
+      CloseHandle(file);
+      return false;
+   }
+   mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   /* Note: the mapping keeps the file opened. */
+   CloseHandle(file);
+   if(mapping == NULL)
+   {
+      return false;
+   }
+   data = static_cast<const Ogre::uint8*>(MapViewOfFile(mapping, 
+            FILE_MAP_READ, 0, 0, 0));
+   if(data == NULL)
+   {
+      CloseHandle(mapping);
+      mapping = NULL;
+      return false;
+   }
+   size = static_cast<size_t>(fileSize.QuadPart);
+#else
+   int fd = ::open(fileName.c_str(), O_RDONLY);
+   if(fd < 0)
+   {
+      return false;
+   }
+   struct stat st;
+   if((fstat(fd, &st) != 0) || (st.st_size == 0))
+   {
+      ::close(fd);
+      return false;
+   }
+   void* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   /* Note: the mapping keeps the file opened. */
+   ::close(fd);
+   if(mapped == MAP_FAILED)
+   {
+      return false;
+   }
+   data = static_cast<const Ogre::uint8*>(mapped);
+   size = static_cast<size_t>(st.st_size);
+#endif
+
+   return true;
+}
+
+/***********************************************************************
+ *                                close                                *
+ ***********************************************************************/
+void MappedFile::close()
+{
+   if(data == NULL)
+   {
+      return;
+   }
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+   UnmapViewOfFile(data);
+   CloseHandle(mapping);
+   mapping = NULL;
+#else
+   munmap(const_cast<Ogre::uint8*>(data), size);
+#endif
+   data = NULL;
+   size = 0;
+}
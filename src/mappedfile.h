@@ -0,0 +1,64 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_mapped_file_h
+#define _goblin_mapped_file_h
+
+/* Internal header: read only memory mapped files (mmap on POSIX systems,
+ * file mappings on Windows). */
+
+#include <OGRE/OgrePrerequisites.h>
+
+namespace Goblin
+{
+
+/*! A file mapped, read only, to memory */
+class MappedFile
+{
+   public:
+      /*! Constructor */
+      MappedFile();
+      /*! Destructor (unmapping the file, if opened) */
+      ~MappedFile();
+
+      /*! Map a file to memory.
+       * \param fileName full path of the file
+       * \return if mapped. */
+      bool open(const Ogre::String& fileName);
+
+      /*! Unmap the current file, if any */
+      void close();
+
+      /*! \return pointer to the mapped file contents, or NULL */
+      const Ogre::uint8* getData() const { return data; };
+      /*! \return size of the mapped file, in bytes */
+      const size_t getSize() const { return size; };
+
+   private:
+      const Ogre::uint8* data; /**< Mapped contents */
+      size_t size;             /**< Mapped size */
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+      void* mapping;           /**< File mapping handle */
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,1280 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshbvh.h"
+#include "simd.h"
+
+#include <OGRE/OgreMatrix3.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace Goblin;
+
+#define MESH_BVH_BINS                 16
+#define MESH_BVH_MAX_LEAF_TRIANGLES   4
+#define MESH_BVH_MAX_DEPTH            60
+#define MESH_BVH_STACK_SIZE           64
+#define MESH_BVH_PACKET_SIZE          4
+#define MESH_BVH_MIN_DET              1e-12f
+#define MESH_BVH_MIN_DIR              1e-20f
+#define MESH_BVH_COHERENT_COS         0.9f
+#define MESH_BVH_PAIR_STACK_SIZE      128
+#define MESH_BVH_PLANE_EPS            1e-6f
+
+/***********************************************************************
+ *                             surfaceArea                             *
+ ***********************************************************************/
+static inline Ogre::Real surfaceArea(const Ogre::Vector3& min,
+      const Ogre::Vector3& max)
+{
+   Ogre::Vector3 e = max - min;
+   return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+/***********************************************************************
+ *                            inverseDirection                         *
+ ***********************************************************************/
+static inline Ogre::Real inverseDirection(Ogre::Real d)
+{
+   /* Avoiding infinite values, whose 0 * inf on the slab test (for
+    * origins just over a bounds plane) would be NaN. */
+   return 1.0f / ((Ogre::Math::Abs(d) > MESH_BVH_MIN_DIR) ? 
+         d : MESH_BVH_MIN_DIR);
+}
+
+/***********************************************************************
+ *                              orient2d                               *
+ ***********************************************************************/
+static inline Ogre::Real orient2d(const Ogre::Vector3& a, 
+      const Ogre::Vector3& b, const Ogre::Vector3& c, int i0, int i1)
+{
+   return (b[i0] - a[i0]) * (c[i1] - a[i1]) - 
+          (b[i1] - a[i1]) * (c[i0] - a[i0]);
+}
+
+/***********************************************************************
+ *                          segmentsIntersect2d                        *
+ ***********************************************************************/
+static bool segmentsIntersect2d(const Ogre::Vector3& p0, 
+      const Ogre::Vector3& p1, const Ogre::Vector3& q0, 
+      const Ogre::Vector3& q1, int i0, int i1)
+{
+   Ogre::Real o0 = orient2d(p0, p1, q0, i0, i1);
+   Ogre::Real o1 = orient2d(p0, p1, q1, i0, i1);
+   Ogre::Real o2 = orient2d(q0, q1, p0, i0, i1);
+   Ogre::Real o3 = orient2d(q0, q1, p1, i0, i1);
+   if((o0 == 0.0f) && (o1 == 0.0f))
+   {
+      /* Collinear: check their projections overlap */
+      for(int k = 0; k < 2; k++)
+      {
+         int i = (k == 0) ? i0 : i1;
+         if((std::max(p0[i], p1[i]) < std::min(q0[i], q1[i])) ||
+            (std::max(q0[i], q1[i]) < std::min(p0[i], p1[i])))
+         {
+            return false;
+         }
+      }
+      return true;
+   }
+   return (o0 * o1 <= 0.0f) && (o2 * o3 <= 0.0f);
+}
+
+/***********************************************************************
+ *                          pointInTriangle2d                          *
+ ***********************************************************************/
+static bool pointInTriangle2d(const Ogre::Vector3& p, 
+      const Ogre::Vector3* t, int i0, int i1)
+{
+   Ogre::Real o0 = orient2d(t[0], t[1], p, i0, i1);
+   Ogre::Real o1 = orient2d(t[1], t[2], p, i0, i1);
+   Ogre::Real o2 = orient2d(t[2], t[0], p, i0, i1);
+   return ((o0 >= 0.0f) && (o1 >= 0.0f) && (o2 >= 0.0f)) ||
+          ((o0 <= 0.0f) && (o1 <= 0.0f) && (o2 <= 0.0f));
+}
+
+/***********************************************************************
+ *                          triangleInterval                           *
+ ***********************************************************************/
+/* Get the interval where a triangle crosses the other triangle plane, 
+ * along the planes intersection line (projected on an axis).
+ * \param p vertices projections on the line
+ * \param d vertices distances to the other plane
+ * \return false if the triangle is on the plane (coplanar) */
+static bool triangleInterval(const Ogre::Real* p, const Ogre::Real* d,
+      Ogre::Real& t0, Ogre::Real& t1)
+{
+   /* Find the vertex alone on its plane side */
+   int alone;
+   if(d[0] * d[1] > 0.0f)
+   {
+      alone = 2;
+   }
+   else if(d[0] * d[2] > 0.0f)
+   {
+      alone = 1;
+   }
+   else if((d[1] * d[2] > 0.0f) || (d[0] != 0.0f))
+   {
+      alone = 0;
+   }
+   else if(d[1] != 0.0f)
+   {
+      alone = 1;
+   }
+   else if(d[2] != 0.0f)
+   {
+      alone = 2;
+   }
+   else
+   {
+      return false;
+   }
+
+   /* Its edges to the others cross the plane */
+   int o0 = (alone + 1) % 3;
+   int o1 = (alone + 2) % 3;
+   t0 = p[alone] + (p[o0] - p[alone]) * d[alone] / (d[alone] - d[o0]);
+   t1 = p[alone] + (p[o1] - p[alone]) * d[alone] / (d[alone] - d[o1]);
+   if(t0 > t1)
+   {
+      std::swap(t0, t1);
+   }
+   return true;
+}
+
+/***********************************************************************
+ *                            planeDistances                           *
+ ***********************************************************************/
+/* Distances of a triangle vertices to the plane of another one, with 
+ * the ones too near set to 0.
+ * \return false if the triangle is all at a side of the plane */
+static bool planeDistances(const Ogre::Vector3* plane, 
+      const Ogre::Vector3* t, Ogre::Vector3& normal, Ogre::Real* d)
+{
+   Ogre::Vector3 e1 = plane[1] - plane[0];
+   Ogre::Vector3 e2 = plane[2] - plane[0];
+   normal = e1.crossProduct(e2);
+   Ogre::Real len = normal.length();
+   if(len <= 0.0f)
+   {
+      /* Degenerated triangle */
+      return false;
+   }
+   normal /= len;
+   Ogre::Real eps = MESH_BVH_PLANE_EPS * (e1.length() + e2.length());
+   for(int i = 0; i < 3; i++)
+   {
+      d[i] = normal.dotProduct(t[i] - plane[0]);
+      if(Ogre::Math::Abs(d[i]) < eps)
+      {
+         d[i] = 0.0f;
+      }
+   }
+   return (d[0] * d[1] <= 0.0f) || (d[0] * d[2] <= 0.0f);
+}
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+MeshBvh::MeshBvh()
+{
+   useBuffers();
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+MeshBvh::~MeshBvh()
+{
+}
+
+/***********************************************************************
+ *                              useBuffers                             *
+ ***********************************************************************/
+void MeshBvh::useBuffers()
+{
+   nodeCount = nodesBuffer.size();
+   triangleCount = trianglesBuffer.size();
+   nodes = (nodeCount > 0) ? &nodesBuffer[0] : NULL;
+   triangles = (triangleCount > 0) ? &trianglesBuffer[0] : NULL;
+   triData = (!triDataBuffer.empty()) ? &triDataBuffer[0] : NULL;
+}
+
+/***********************************************************************
+ *                             getDataSize                             *
+ ***********************************************************************/
+size_t MeshBvh::getDataSize() const
+{
+   size_t triangleSize = sizeof(Ogre::uint32);
+   if(triData)
+   {
+      triangleSize += 3 * sizeof(Ogre::Vector3);
+   }
+   return 2 * sizeof(Ogre::uint32) + nodeCount * sizeof(Node) + 
+      triangleCount * triangleSize;
+}
+
+/***********************************************************************
+ *                              writeData                              *
+ ***********************************************************************/
+void MeshBvh::writeData(Ogre::uint8* dst) const
+{
+   Ogre::uint32 counts[2] = {nodeCount, triangleCount};
+   memcpy(dst, counts, sizeof(counts));
+   dst += sizeof(counts);
+   memcpy(dst, nodes, nodeCount * sizeof(Node));
+   dst += nodeCount * sizeof(Node);
+   memcpy(dst, triangles, triangleCount * sizeof(Ogre::uint32));
+   if(triData)
+   {
+      dst += triangleCount * sizeof(Ogre::uint32);
+      memcpy(dst, triData, triangleCount * 3 * sizeof(Ogre::Vector3));
+   }
+}
+
+/***********************************************************************
+ *                               setData                               *
+ ***********************************************************************/
+bool MeshBvh::setData(const Ogre::uint8* data, size_t size,
+      const QuantizedMesh* mesh)
+{
+   Ogre::uint32 counts[2];
+   if(size < sizeof(counts))
+   {
+      return false;
+   }
+   memcpy(counts, data, sizeof(counts));
+
+   /* Without the triangles data when referring to a quantized mesh */
+   Ogre::uint64 triangleSize = sizeof(Ogre::uint32);
+   if(!mesh)
+   {
+      triangleSize += 3 * sizeof(Ogre::Vector3);
+   }
+   Ogre::uint64 expected = 2 * sizeof(Ogre::uint32) + 
+      (Ogre::uint64) counts[0] * sizeof(Node) + 
+      (Ogre::uint64) counts[1] * triangleSize;
+   if(expected != size)
+   {
+      return false;
+   }
+
+   nodesBuffer.clear();
+   trianglesBuffer.clear();
+   triDataBuffer.clear();
+
+   nodeCount = counts[0];
+   triangleCount = counts[1];
+   data += sizeof(counts);
+   nodes = reinterpret_cast<const Node*>(data);
+   data += nodeCount * sizeof(Node);
+   triangles = reinterpret_cast<const Ogre::uint32*>(data);
+   data += triangleCount * sizeof(Ogre::uint32);
+   if(mesh)
+   {
+      quantized = *mesh;
+      triData = NULL;
+   }
+   else
+   {
+      quantized = QuantizedMesh();
+      triData = reinterpret_cast<const Ogre::Vector3*>(data);
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                             getMinimum                              *
+ ***********************************************************************/
+const Ogre::Vector3& MeshBvh::getMinimum() const
+{
+   return (nodeCount == 0) ? Ogre::Vector3::ZERO : nodes[0].min;
+}
+
+/***********************************************************************
+ *                             getMaximum                              *
+ ***********************************************************************/
+const Ogre::Vector3& MeshBvh::getMaximum() const
+{
+   return (nodeCount == 0) ? Ogre::Vector3::ZERO : nodes[0].max;
+}
+
+/***********************************************************************
+ *                                build                                *
+ ***********************************************************************/
+void MeshBvh::build(const Ogre::Vector3* vertices,
+      const Ogre::uint32* indices, size_t indexCount)
+{
+   nodesBuffer.clear();
+   trianglesBuffer.clear();
+   triDataBuffer.clear();
+   quantized = QuantizedMesh();
+   useBuffers();
+
+   Ogre::uint32 numTriangles = indexCount / 3;
+   if(numTriangles == 0)
+   {
+      return;
+   }
+
+   /* Triangles bounds and centroids, used while building */
+   std::vector<Ogre::Vector3> centroids(numTriangles);
+   std::vector<Ogre::Vector3> triMin(numTriangles);
+   std::vector<Ogre::Vector3> triMax(numTriangles);
+   trianglesBuffer.resize(numTriangles);
+   for(Ogre::uint32 t = 0; t < numTriangles; t++)
+   {
+      const Ogre::Vector3& v0 = vertices[indices[t * 3]];
+      const Ogre::Vector3& v1 = vertices[indices[t * 3 + 1]];
+      const Ogre::Vector3& v2 = vertices[indices[t * 3 + 2]];
+      triMin[t] = v0;
+      triMin[t].makeFloor(v1);
+      triMin[t].makeFloor(v2);
+      triMax[t] = v0;
+      triMax[t].makeCeil(v1);
+      triMax[t].makeCeil(v2);
+      centroids[t] = (triMin[t] + triMax[t]) * 0.5f;
+      trianglesBuffer[t] = t;
+   }
+
+   buildNodes(centroids, triMin, triMax);
+
+   /* Gather the triangles data, in leaves order */
+   triDataBuffer.resize(numTriangles * 3);
+   for(Ogre::uint32 i = 0; i < numTriangles; i++)
+   {
+      Ogre::uint32 t = trianglesBuffer[i];
+      const Ogre::Vector3& v0 = vertices[indices[t * 3]];
+      triDataBuffer[i * 3] = v0;
+      triDataBuffer[i * 3 + 1] = vertices[indices[t * 3 + 1]] - v0;
+      triDataBuffer[i * 3 + 2] = vertices[indices[t * 3 + 2]] - v0;
+   }
+
+   useBuffers();
+}
+
+/***********************************************************************
+ *                                build                                *
+ ***********************************************************************/
+void MeshBvh::build(const QuantizedMesh& mesh, size_t indexCount)
+{
+   nodesBuffer.clear();
+   trianglesBuffer.clear();
+   triDataBuffer.clear();
+   quantized = mesh;
+   useBuffers();
+
+   Ogre::uint32 numTriangles = indexCount / 3;
+   if(numTriangles == 0)
+   {
+      return;
+   }
+
+   /* Triangles bounds and centroids, used while building */
+   std::vector<Ogre::Vector3> centroids(numTriangles);
+   std::vector<Ogre::Vector3> triMin(numTriangles);
+   std::vector<Ogre::Vector3> triMax(numTriangles);
+   trianglesBuffer.resize(numTriangles);
+   for(Ogre::uint32 t = 0; t < numTriangles; t++)
+   {
+      Ogre::Vector3 v0 = mesh.getVertex(mesh.getIndex(t * 3));
+      Ogre::Vector3 v1 = mesh.getVertex(mesh.getIndex(t * 3 + 1));
+      Ogre::Vector3 v2 = mesh.getVertex(mesh.getIndex(t * 3 + 2));
+      triMin[t] = v0;
+      triMin[t].makeFloor(v1);
+      triMin[t].makeFloor(v2);
+      triMax[t] = v0;
+      triMax[t].makeCeil(v1);
+      triMax[t].makeCeil(v2);
+      centroids[t] = (triMin[t] + triMax[t]) * 0.5f;
+      trianglesBuffer[t] = t;
+   }
+
+   buildNodes(centroids, triMin, triMax);
+
+   /* No triangles data: they are decoded from the mesh when tested */
+   useBuffers();
+}
+
+/***********************************************************************
+ *                              buildNodes                             *
+ ***********************************************************************/
+void MeshBvh::buildNodes(const std::vector<Ogre::Vector3>& centroids,
+      const std::vector<Ogre::Vector3>& triMin,
+      const std::vector<Ogre::Vector3>& triMax)
+{
+   Ogre::uint32 numTriangles = trianglesBuffer.size();
+
+   /* Worst case: a leaf per triangle */
+   nodesBuffer.reserve(numTriangles * 2 - 1);
+
+   Node root;
+   root.first = 0;
+   root.count = numTriangles;
+   calculateBounds(root, triMin, triMax);
+   nodesBuffer.push_back(root);
+
+   /* Split nodes while worth it (depth first) */
+   std::vector<std::pair<Ogre::uint32, int> > toSplit;
+   toSplit.push_back(std::make_pair(0, 0));
+   while(!toSplit.empty())
+   {
+      Ogre::uint32 nodeIndex = toSplit.back().first;
+      int depth = toSplit.back().second;
+      toSplit.pop_back();
+
+      if((depth < MESH_BVH_MAX_DEPTH) &&
+         (split(nodeIndex, centroids, triMin, triMax)))
+      {
+         toSplit.push_back(std::make_pair(nodesBuffer[nodeIndex].first,
+                  depth + 1));
+         toSplit.push_back(std::make_pair(nodesBuffer[nodeIndex].first + 1,
+                  depth + 1));
+      }
+   }
+}
+
+/***********************************************************************
+ *                           calculateBounds                           *
+ ***********************************************************************/
+void MeshBvh::calculateBounds(Node& node,
+      const std::vector<Ogre::Vector3>& triMin,
+      const std::vector<Ogre::Vector3>& triMax)
+{
+   node.min = triMin[trianglesBuffer[node.first]];
+   node.max = triMax[trianglesBuffer[node.first]];
+   for(Ogre::uint32 i = node.first + 1; i < node.first + node.count; i++)
+   {
+      node.min.makeFloor(triMin[trianglesBuffer[i]]);
+      node.max.makeCeil(triMax[trianglesBuffer[i]]);
+   }
+}
+
+/***********************************************************************
+ *                                split                                *
+ ***********************************************************************/
+bool MeshBvh::split(Ogre::uint32 nodeIndex,
+      const std::vector<Ogre::Vector3>& centroids,
+      const std::vector<Ogre::Vector3>& triMin,
+      const std::vector<Ogre::Vector3>& triMax)
+{
+   Ogre::uint32 first = nodesBuffer[nodeIndex].first;
+   Ogre::uint32 count = nodesBuffer[nodeIndex].count;
+   if(count <= MESH_BVH_MAX_LEAF_TRIANGLES)
+   {
+      return false;
+   }
+
+   /* Centroid bounds, to define the bins */
+   Ogre::Vector3 cMin = centroids[trianglesBuffer[first]];
+   Ogre::Vector3 cMax = cMin;
+   for(Ogre::uint32 i = first + 1; i < first + count; i++)
+   {
+      cMin.makeFloor(centroids[trianglesBuffer[i]]);
+      cMax.makeCeil(centroids[trianglesBuffer[i]]);
+   }
+
+   /* Find the best split (the one with lower SAH cost) */
+   int bestAxis = -1;
+   int bestBin = 0;
+   Ogre::Real bestCost = Ogre::Math::POS_INFINITY;
+   for(int axis = 0; axis < 3; axis++)
+   {
+      Ogre::Real extent = cMax[axis] - cMin[axis];
+      if(extent <= 0.0f)
+      {
+         continue;
+      }
+      Ogre::Real scale = MESH_BVH_BINS / extent;
+
+      /* Fill the bins */
+      Ogre::uint32 binCount[MESH_BVH_BINS];
+      Ogre::Vector3 binMin[MESH_BVH_BINS];
+      Ogre::Vector3 binMax[MESH_BVH_BINS];
+      for(int b = 0; b < MESH_BVH_BINS; b++)
+      {
+         binCount[b] = 0;
+         binMin[b] = Ogre::Vector3(Ogre::Math::POS_INFINITY);
+         binMax[b] = Ogre::Vector3(-Ogre::Math::POS_INFINITY);
+      }
+      for(Ogre::uint32 i = first; i < first + count; i++)
+      {
+         Ogre::uint32 t = trianglesBuffer[i];
+         int b = std::min(MESH_BVH_BINS - 1,
+               (int)((centroids[t][axis] - cMin[axis]) * scale));
+         binCount[b]++;
+         binMin[b].makeFloor(triMin[t]);
+         binMax[b].makeCeil(triMax[t]);
+      }
+
+      /* Sweep, from the left and from the right */
+      Ogre::Real leftArea[MESH_BVH_BINS - 1];
+      Ogre::uint32 leftCount[MESH_BVH_BINS - 1];
+      Ogre::Vector3 accMin(Ogre::Math::POS_INFINITY);
+      Ogre::Vector3 accMax(-Ogre::Math::POS_INFINITY);
+      Ogre::uint32 acc = 0;
+      for(int b = 0; b < MESH_BVH_BINS - 1; b++)
+      {
+         acc += binCount[b];
+         accMin.makeFloor(binMin[b]);
+         accMax.makeCeil(binMax[b]);
+         leftCount[b] = acc;
+         leftArea[b] = (acc > 0) ? surfaceArea(accMin, accMax) : 0.0f;
+      }
+      accMin = Ogre::Vector3(Ogre::Math::POS_INFINITY);
+      accMax = Ogre::Vector3(-Ogre::Math::POS_INFINITY);
+      acc = 0;
+      for(int b = MESH_BVH_BINS - 1; b > 0; b--)
+      {
+         acc += binCount[b];
+         accMin.makeFloor(binMin[b]);
+         accMax.makeCeil(binMax[b]);
+         if((acc > 0) && (leftCount[b - 1] > 0))
+         {
+            Ogre::Real cost = leftCount[b - 1] * leftArea[b - 1] +
+                              acc * surfaceArea(accMin, accMax);
+            if(cost < bestCost)
+            {
+               bestCost = cost;
+               bestAxis = axis;
+               bestBin = b;
+            }
+         }
+      }
+   }
+
+   /* Check if splitting is better than keeping it as a leaf */
+   if((bestAxis < 0) ||
+      (bestCost >= count * surfaceArea(nodesBuffer[nodeIndex].min,
+                                       nodesBuffer[nodeIndex].max)))
+   {
+      return false;
+   }
+
+   /* Partition the triangles */
+   Ogre::Real scale = MESH_BVH_BINS / (cMax[bestAxis] - cMin[bestAxis]);
+   Ogre::uint32 i = first;
+   Ogre::uint32 j = first + count;
+   while(i < j)
+   {
+      int b = std::min(MESH_BVH_BINS - 1, (int)((
+                  centroids[trianglesBuffer[i]][bestAxis] - cMin[bestAxis]) * scale));
+      if(b < bestBin)
+      {
+         i++;
+      }
+      else
+      {
+         j--;
+         std::swap(trianglesBuffer[i], trianglesBuffer[j]);
+      }
+   }
+
+   /* Create the children */
+   Ogre::uint32 leftIndex = nodesBuffer.size();
+   Node left, right;
+   left.first = first;
+   left.count = i - first;
+   right.first = i;
+   right.count = count - left.count;
+   calculateBounds(left, triMin, triMax);
+   calculateBounds(right, triMin, triMax);
+   nodesBuffer.push_back(left);
+   nodesBuffer.push_back(right);
+
+   nodesBuffer[nodeIndex].first = leftIndex;
+   nodesBuffer[nodeIndex].count = 0;
+
+   return true;
+}
+
+/***********************************************************************
+ *                           intersectBounds                           *
+ ***********************************************************************/
+Ogre::Real MeshBvh::intersectBounds(const Node& node,
+      const Ogre::Vector3& origin, const Ogre::Vector3& invDir,
+      Ogre::Real maxDist)
+{
+   Ogre::Real tMin = 0.0f;
+   Ogre::Real tMax = maxDist;
+   for(int axis = 0; axis < 3; axis++)
+   {
+      Ogre::Real t1 = (node.min[axis] - origin[axis]) * invDir[axis];
+      Ogre::Real t2 = (node.max[axis] - origin[axis]) * invDir[axis];
+      tMin = std::max(tMin, std::min(t1, t2));
+      tMax = std::min(tMax, std::max(t1, t2));
+   }
+   return (tMin <= tMax) ? tMin : Ogre::Math::POS_INFINITY;
+}
+
+/***********************************************************************
+ *                          intersectTriangle                          *
+ ***********************************************************************/
+bool MeshBvh::intersectTriangle(const Ogre::Vector3& origin,
+      const Ogre::Vector3& dir, const Ogre::Vector3* tri,
+      MeshRayHit& hit)
+{
+   /* Moller-Trumbore */
+   const Ogre::Vector3& v0 = tri[0];
+   const Ogre::Vector3& e1 = tri[1];
+   const Ogre::Vector3& e2 = tri[2];
+   Ogre::Vector3 p = dir.crossProduct(e2);
+   Ogre::Real det = e1.dotProduct(p);
+   if(Ogre::Math::Abs(det) < MESH_BVH_MIN_DET)
+   {
+      /* Parallel (or degenerated triangle) */
+      return false;
+   }
+   Ogre::Real invDet = 1.0f / det;
+
+   Ogre::Vector3 s = origin - v0;
+   Ogre::Real u = s.dotProduct(p) * invDet;
+   if((u < 0.0f) || (u > 1.0f))
+   {
+      return false;
+   }
+   Ogre::Vector3 q = s.crossProduct(e1);
+   Ogre::Real v = dir.dotProduct(q) * invDet;
+   if((v < 0.0f) || (u + v > 1.0f))
+   {
+      return false;
+   }
+   Ogre::Real t = e2.dotProduct(q) * invDet;
+   if((t < 0.0f) || (t >= hit.distance))
+   {
+      return false;
+   }
+
+   hit.distance = t;
+   hit.u = u;
+   hit.v = v;
+   return true;
+}
+
+/***********************************************************************
+ *                             rayIntersect                            *
+ ***********************************************************************/
+bool MeshBvh::rayIntersect(const Ogre::Ray& ray, MeshRayHit& hit,
+      Ogre::Real maxDistance) const
+{
+   if(nodeCount == 0)
+   {
+      return false;
+   }
+
+   const Ogre::Vector3& origin = ray.getOrigin();
+   const Ogre::Vector3& dir = ray.getDirection();
+   Ogre::Vector3 invDir(inverseDirection(dir.x), inverseDirection(dir.y),
+         inverseDirection(dir.z));
+
+   MeshRayHit nearest;
+   nearest.distance = maxDistance;
+   bool found = false;
+   Ogre::Vector3 tmp[3]; /* Decoded triangle, if quantized */
+
+   /* Nodes to visit, with their entry distances */
+   Ogre::uint32 stack[MESH_BVH_STACK_SIZE];
+   Ogre::Real stackDist[MESH_BVH_STACK_SIZE];
+   int stackSize = 0;
+   Ogre::Real d = intersectBounds(nodes[0], origin, invDir, maxDistance);
+   if(d < maxDistance)
+   {
+      stack[stackSize] = 0;
+      stackDist[stackSize++] = d;
+   }
+
+   while(stackSize > 0)
+   {
+      stackSize--;
+      if(stackDist[stackSize] >= nearest.distance)
+      {
+         /* Already found a nearer hit */
+         continue;
+      }
+      const Node& node = nodes[stack[stackSize]];
+      if(node.count > 0)
+      {
+         /* Leaf: test its triangles */
+         for(Ogre::uint32 i = node.first; i < node.first + node.count; i++)
+         {
+            if(intersectTriangle(origin, dir, getTriangle(i, tmp), 
+                     nearest))
+            {
+               nearest.triangle = triangles[i];
+               found = true;
+            }
+         }
+      }
+      else
+      {
+         /* Visit the nearest child first */
+         Ogre::Real d0 = intersectBounds(nodes[node.first], origin, invDir,
+               nearest.distance);
+         Ogre::Real d1 = intersectBounds(nodes[node.first + 1], origin,
+               invDir, nearest.distance);
+         Ogre::uint32 c0 = node.first;
+         Ogre::uint32 c1 = node.first + 1;
+         if(d1 < d0)
+         {
+            std::swap(d0, d1);
+            std::swap(c0, c1);
+         }
+         if(d1 < nearest.distance)
+         {
+            stack[stackSize] = c1;
+            stackDist[stackSize++] = d1;
+         }
+         if(d0 < nearest.distance)
+         {
+            stack[stackSize] = c0;
+            stackDist[stackSize++] = d0;
+         }
+      }
+   }
+
+   if(found)
+   {
+      hit = nearest;
+   }
+   return found;
+}
+
+/***********************************************************************
+ *                             rayIntersect                            *
+ ***********************************************************************/
+size_t MeshBvh::rayIntersect(const Ogre::Ray* rays, size_t count,
+      MeshRayHit* hits, Ogre::Real maxDistance) const
+{
+   size_t total = 0;
+   for(size_t i = 0; i < count; i += MESH_BVH_PACKET_SIZE)
+   {
+      size_t packetSize = std::min(count - i, (size_t)MESH_BVH_PACKET_SIZE);
+      if(isCoherent(&rays[i], packetSize))
+      {
+         total += intersectPacket(&rays[i], packetSize, &hits[i], 
+               maxDistance);
+      }
+      else
+      {
+         /* Traversing divergent rays together would visit the nodes of
+          * all of them, being slower than one by one. */
+         for(size_t r = i; r < i + packetSize; r++)
+         {
+            hits[r] = MeshRayHit();
+            if(rayIntersect(rays[r], hits[r], maxDistance))
+            {
+               total++;
+            }
+         }
+      }
+   }
+   return total;
+}
+
+/***********************************************************************
+ *                              isCoherent                             *
+ ***********************************************************************/
+bool MeshBvh::isCoherent(const Ogre::Ray* rays, size_t count)
+{
+   Ogre::Vector3 dir = rays[0].getDirection().normalisedCopy();
+   for(size_t r = 1; r < count; r++)
+   {
+      if(dir.dotProduct(rays[r].getDirection().normalisedCopy()) < 
+            MESH_BVH_COHERENT_COS)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+/***********************************************************************
+ *                           intersectPacket                           *
+ ***********************************************************************/
+size_t MeshBvh::intersectPacket(const Ogre::Ray* rays, size_t count,
+      MeshRayHit* hits, Ogre::Real maxDistance) const
+{
+   /* Load the rays as SoA. Missing lanes get a negative distance, 
+    * thus never hitting anything. */
+   float o[3][MESH_BVH_PACKET_SIZE];
+   float d[3][MESH_BVH_PACKET_SIZE];
+   float inv[3][MESH_BVH_PACKET_SIZE];
+   float best[MESH_BVH_PACKET_SIZE];
+   Ogre::uint32 bestTri[MESH_BVH_PACKET_SIZE];
+   for(size_t r = 0; r < MESH_BVH_PACKET_SIZE; r++)
+   {
+      const Ogre::Ray& ray = rays[(r < count) ? r : 0];
+      for(int k = 0; k < 3; k++)
+      {
+         o[k][r] = ray.getOrigin()[k];
+         d[k][r] = ray.getDirection()[k];
+         inv[k][r] = inverseDirection(d[k][r]);
+      }
+      best[r] = (r < count) ? maxDistance : -1.0f;
+      bestTri[r] = MeshRayHit::NO_TRIANGLE;
+   }
+
+   const Simd::Float4 ox = Simd::load(o[0]);
+   const Simd::Float4 oy = Simd::load(o[1]);
+   const Simd::Float4 oz = Simd::load(o[2]);
+   const Simd::Float4 dx = Simd::load(d[0]);
+   const Simd::Float4 dy = Simd::load(d[1]);
+   const Simd::Float4 dz = Simd::load(d[2]);
+   const Simd::Float4 ix = Simd::load(inv[0]);
+   const Simd::Float4 iy = Simd::load(inv[1]);
+   const Simd::Float4 iz = Simd::load(inv[2]);
+   const Simd::Float4 fZero = Simd::zero();
+   const Simd::Float4 fOne = Simd::set1(1.0f);
+   const Simd::Float4 fMinDet = Simd::set1(MESH_BVH_MIN_DET);
+   Simd::Float4 tBest = Simd::load(best);
+   Simd::Float4 uBest = fZero;
+   Simd::Float4 vBest = fZero;
+   Ogre::Vector3 tmp[3]; /* Decoded triangle, if quantized */
+
+   /* Direction signs, to choose the nearest child to visit first */
+   float dirSum[3] = {0.0f, 0.0f, 0.0f};
+   for(size_t r = 0; r < count; r++)
+   {
+      for(int k = 0; k < 3; k++)
+      {
+         dirSum[k] += d[k][r];
+      }
+   }
+
+   Ogre::uint32 stack[MESH_BVH_STACK_SIZE];
+   int stackSize = 0;
+   if(nodeCount > 0)
+   {
+      stack[stackSize++] = 0;
+   }
+
+   while(stackSize > 0)
+   {
+      const Node& node = nodes[stack[--stackSize]];
+
+      /* Test the node bounds with all rays */
+      Simd::Float4 t1 = Simd::mul(Simd::sub(Simd::set1(node.min.x), ox), ix);
+      Simd::Float4 t2 = Simd::mul(Simd::sub(Simd::set1(node.max.x), ox), ix);
+      Simd::Float4 tMin = Simd::max(fZero, Simd::min(t1, t2));
+      Simd::Float4 tMax = Simd::min(tBest, Simd::max(t1, t2));
+      t1 = Simd::mul(Simd::sub(Simd::set1(node.min.y), oy), iy);
+      t2 = Simd::mul(Simd::sub(Simd::set1(node.max.y), oy), iy);
+      tMin = Simd::max(tMin, Simd::min(t1, t2));
+      tMax = Simd::min(tMax, Simd::max(t1, t2));
+      t1 = Simd::mul(Simd::sub(Simd::set1(node.min.z), oz), iz);
+      t2 = Simd::mul(Simd::sub(Simd::set1(node.max.z), oz), iz);
+      tMin = Simd::max(tMin, Simd::min(t1, t2));
+      tMax = Simd::min(tMax, Simd::max(t1, t2));
+      if(Simd::moveMask(Simd::cmpLe(tMin, tMax)) == 0)
+      {
+         /* No ray hits it */
+         continue;
+      }
+
+      if(node.count == 0)
+      {
+         /* Visit first the child nearest to the rays origin, along the
+          * axis where the children are most apart. */
+         const Node& left = nodes[node.first];
+         const Node& right = nodes[node.first + 1];
+         Ogre::Vector3 sep = (right.min + right.max) - (left.min + left.max);
+         int axis = 0;
+         for(int k = 1; k < 3; k++)
+         {
+            if(Ogre::Math::Abs(sep[k]) > Ogre::Math::Abs(sep[axis]))
+            {
+               axis = k;
+            }
+         }
+         bool rightFirst = (sep[axis] * dirSum[axis] < 0.0f);
+         stack[stackSize++] = (rightFirst) ? node.first : node.first + 1;
+         stack[stackSize++] = (rightFirst) ? node.first + 1 : node.first;
+         continue;
+      }
+
+      /* Leaf: test each triangle with all rays (Moller-Trumbore) */
+      for(Ogre::uint32 i = node.first; i < node.first + node.count; i++)
+      {
+         const Ogre::Vector3* tri = getTriangle(i, tmp);
+         Simd::Float4 e1x = Simd::set1(tri[1].x);
+         Simd::Float4 e1y = Simd::set1(tri[1].y);
+         Simd::Float4 e1z = Simd::set1(tri[1].z);
+         Simd::Float4 e2x = Simd::set1(tri[2].x);
+         Simd::Float4 e2y = Simd::set1(tri[2].y);
+         Simd::Float4 e2z = Simd::set1(tri[2].z);
+
+         Simd::Float4 px, py, pz;
+         Simd::cross3(dx, dy, dz, e2x, e2y, e2z, px, py, pz);
+         Simd::Float4 det = Simd::dot3(e1x, e1y, e1z, px, py, pz);
+         Simd::Float4 invDet = Simd::div(fOne, det);
+
+         Simd::Float4 sx = Simd::sub(ox, Simd::set1(tri[0].x));
+         Simd::Float4 sy = Simd::sub(oy, Simd::set1(tri[0].y));
+         Simd::Float4 sz = Simd::sub(oz, Simd::set1(tri[0].z));
+         Simd::Float4 u = Simd::mul(Simd::dot3(sx, sy, sz, px, py, pz), 
+               invDet);
+
+         Simd::Float4 qx, qy, qz;
+         Simd::cross3(sx, sy, sz, e1x, e1y, e1z, qx, qy, qz);
+         Simd::Float4 v = Simd::mul(Simd::dot3(dx, dy, dz, qx, qy, qz), 
+               invDet);
+         Simd::Float4 t = Simd::mul(Simd::dot3(e2x, e2y, e2z, qx, qy, qz),
+               invDet);
+
+         Simd::Mask4 hit = Simd::cmpGe(Simd::abs(det), fMinDet);
+         hit = Simd::maskAnd(hit, Simd::cmpGe(u, fZero));
+         hit = Simd::maskAnd(hit, Simd::cmpGe(v, fZero));
+         hit = Simd::maskAnd(hit, Simd::cmpLe(Simd::add(u, v), fOne));
+         hit = Simd::maskAnd(hit, Simd::cmpGe(t, fZero));
+         hit = Simd::maskAnd(hit, Simd::cmpLt(t, tBest));
+
+         int hitBits = Simd::moveMask(hit);
+         if(hitBits != 0)
+         {
+            tBest = Simd::select(hit, t, tBest);
+            uBest = Simd::select(hit, u, uBest);
+            vBest = Simd::select(hit, v, vBest);
+            for(int r = 0; r < MESH_BVH_PACKET_SIZE; r++)
+            {
+               if(hitBits & (1 << r))
+               {
+                  bestTri[r] = triangles[i];
+               }
+            }
+         }
+      }
+   }
+
+   /* Set the results */
+   float u[MESH_BVH_PACKET_SIZE];
+   float v[MESH_BVH_PACKET_SIZE];
+   Simd::store(best, tBest);
+   Simd::store(u, uBest);
+   Simd::store(v, vBest);
+   size_t total = 0;
+   for(size_t r = 0; r < count; r++)
+   {
+      hits[r].triangle = bestTri[r];
+      if(bestTri[r] != MeshRayHit::NO_TRIANGLE)
+      {
+         hits[r].distance = best[r];
+         hits[r].u = u[r];
+         hits[r].v = v[r];
+         total++;
+      }
+   }
+   return total;
+}
+
+/***********************************************************************
+ *                          intersectTriangles                         *
+ ***********************************************************************/
+bool MeshBvh::intersectTriangles(const Ogre::Vector3* a, 
+      const Ogre::Vector3* b)
+{
+   /* Each triangle must cross the other one plane */
+   Ogre::Vector3 na, nb;
+   Ogre::Real db[3];
+   Ogre::Real da[3];
+   if((!planeDistances(a, b, na, db)) || (!planeDistances(b, a, nb, da)))
+   {
+      return false;
+   }
+
+   /* Project both on the planes intersection line (on the axis it's
+    * most aligned with, as only the intervals order matters) */
+   Ogre::Vector3 dir = na.crossProduct(nb);
+   int axis = 0;
+   for(int k = 1; k < 3; k++)
+   {
+      if(Ogre::Math::Abs(dir[k]) > Ogre::Math::Abs(dir[axis]))
+      {
+         axis = k;
+      }
+   }
+   Ogre::Real pa[3] = {a[0][axis], a[1][axis], a[2][axis]};
+   Ogre::Real pb[3] = {b[0][axis], b[1][axis], b[2][axis]};
+
+   Ogre::Real a0, a1, b0, b1;
+   if((!triangleInterval(pa, da, a0, a1)) || 
+      (!triangleInterval(pb, db, b0, b1)))
+   {
+      /* Coplanar: test them on the plane (projected on the two axes
+       * with which the plane is less aligned). */
+      int i0 = 0, i1 = 1;
+      Ogre::Vector3 an(Ogre::Math::Abs(na.x), Ogre::Math::Abs(na.y), 
+            Ogre::Math::Abs(na.z));
+      if((an.x >= an.y) && (an.x >= an.z))
+      {
+         i0 = 1;
+         i1 = 2;
+      }
+      else if(an.y >= an.z)
+      {
+         i1 = 2;
+      }
+      for(int e = 0; e < 3; e++)
+      {
+         for(int f = 0; f < 3; f++)
+         {
+            if(segmentsIntersect2d(a[e], a[(e + 1) % 3], b[f], 
+                     b[(f + 1) % 3], i0, i1))
+            {
+               return true;
+            }
+         }
+      }
+      return (pointInTriangle2d(a[0], b, i0, i1)) || 
+             (pointInTriangle2d(b[0], a, i0, i1));
+   }
+
+   return (a0 <= b1) && (b0 <= a1);
+}
+
+/***********************************************************************
+ *                            collideLeaves                            *
+ ***********************************************************************/
+size_t MeshBvh::collideLeaves(const MeshBvh& a, const Node& leafA,
+      const MeshBvh& b, const Node& leafB, const float* rot,
+      const Ogre::Vector3& position, std::vector<MeshContact>* contacts, 
+      size_t maxContacts)
+{
+   const Simd::Float4 fZero = Simd::zero();
+   size_t found = 0;
+   Ogre::Vector3 tmp[3]; /* Decoded triangle, if quantized */
+
+   for(Ogre::uint32 chunk = 0; chunk < leafB.count; chunk += 4)
+   {
+      /* Bring 4 b triangles to a space, as SoA (missing lanes repeat 
+       * the first, and are masked out) */
+      Ogre::uint32 lanes = std::min(leafB.count - chunk, 4u);
+      Ogre::Vector3 tb[4][3];
+      float v[3][3][4];  /* [vertex][axis][lane] */
+      float n[3][4];     /* [axis][lane] */
+      float dist[4];
+      for(Ogre::uint32 k = 0; k < 4; k++)
+      {
+         const Ogre::Vector3* tri = b.getTriangle(
+               leafB.first + chunk + ((k < lanes) ? k : 0), tmp);
+         Ogre::Vector3 e1, e2;
+         for(int r = 0; r < 3; r++)
+         {
+            tb[k][0][r] = rot[r * 3] * tri[0].x + 
+               rot[r * 3 + 1] * tri[0].y + rot[r * 3 + 2] * tri[0].z + 
+               position[r];
+            e1[r] = rot[r * 3] * tri[1].x + rot[r * 3 + 1] * tri[1].y +
+               rot[r * 3 + 2] * tri[1].z;
+            e2[r] = rot[r * 3] * tri[2].x + rot[r * 3 + 1] * tri[2].y +
+               rot[r * 3 + 2] * tri[2].z;
+         }
+         tb[k][1] = tb[k][0] + e1;
+         tb[k][2] = tb[k][0] + e2;
+         Ogre::Vector3 normal = e1.crossProduct(e2);
+         for(int r = 0; r < 3; r++)
+         {
+            for(int j = 0; j < 3; j++)
+            {
+               v[j][r][k] = tb[k][j][r];
+            }
+            n[r][k] = normal[r];
+         }
+         dist[k] = normal.dotProduct(tb[k][0]);
+      }
+      const int validLanes = (1 << lanes) - 1;
+
+      Simd::Float4 bx[3], by[3], bz[3];
+      for(int j = 0; j < 3; j++)
+      {
+         bx[j] = Simd::load(v[j][0]);
+         by[j] = Simd::load(v[j][1]);
+         bz[j] = Simd::load(v[j][2]);
+      }
+      const Simd::Float4 nbx = Simd::load(n[0]);
+      const Simd::Float4 nby = Simd::load(n[1]);
+      const Simd::Float4 nbz = Simd::load(n[2]);
+      const Simd::Float4 db = Simd::load(dist);
+
+      for(Ogre::uint32 i = leafA.first; i < leafA.first + leafA.count; i++)
+      {
+         const Ogre::Vector3* tri = a.getTriangle(i, tmp);
+         Ogre::Vector3 ta[3] = {tri[0], tri[0] + tri[1], tri[0] + tri[2]};
+         Ogre::Vector3 na = tri[1].crossProduct(tri[2]);
+         Simd::Float4 nax = Simd::set1(na.x);
+         Simd::Float4 nay = Simd::set1(na.y);
+         Simd::Float4 naz = Simd::set1(na.z);
+         Simd::Float4 da = Simd::set1(na.dotProduct(ta[0]));
+
+         /* Reject the b triangles all at a side of the a plane, and the
+          * ones whose plane has the a triangle all at a side. */
+         Simd::Mask4 aboveA, belowA, aboveB, belowB;
+         for(int j = 0; j < 3; j++)
+         {
+            Simd::Float4 d = Simd::sub(Simd::dot3(nax, nay, naz, 
+                     bx[j], by[j], bz[j]), da);
+            Simd::Mask4 gt = Simd::cmpGt(d, fZero);
+            Simd::Mask4 lt = Simd::cmpLt(d, fZero);
+            aboveA = (j == 0) ? gt : Simd::maskAnd(aboveA, gt);
+            belowA = (j == 0) ? lt : Simd::maskAnd(belowA, lt);
+
+            d = Simd::sub(Simd::dot3(nbx, nby, nbz, Simd::set1(ta[j].x),
+                     Simd::set1(ta[j].y), Simd::set1(ta[j].z)), db);
+            gt = Simd::cmpGt(d, fZero);
+            lt = Simd::cmpLt(d, fZero);
+            aboveB = (j == 0) ? gt : Simd::maskAnd(aboveB, gt);
+            belowB = (j == 0) ? lt : Simd::maskAnd(belowB, lt);
+         }
+         int candidates = validLanes & ~Simd::moveMask(Simd::maskOr(
+                  Simd::maskOr(aboveA, belowA), 
+                  Simd::maskOr(aboveB, belowB)));
+
+         /* Exact test for the remaining */
+         for(Ogre::uint32 k = 0; (candidates != 0) && (k < lanes); k++)
+         {
+            if((candidates & (1 << k)) && (intersectTriangles(ta, tb[k])))
+            {
+               if(contacts)
+               {
+                  contacts->push_back(MeshContact(a.triangles[i], 
+                           b.triangles[leafB.first + chunk + k]));
+               }
+               found++;
+               if(found >= maxContacts)
+               {
+                  return found;
+               }
+            }
+         }
+      }
+   }
+
+   return found;
+}
+
+/***********************************************************************
+ *                               collide                               *
+ ***********************************************************************/
+size_t MeshBvh::collide(const MeshBvh& a, const MeshBvh& b,
+      const Ogre::Quaternion& orientation, const Ogre::Vector3& position, 
+      std::vector<MeshContact>* contacts, size_t maxContacts)
+{
+   if((a.nodeCount == 0) || (b.nodeCount == 0) || (maxContacts == 0))
+   {
+      return 0;
+   }
+
+   Ogre::Matrix3 mat;
+   orientation.ToRotationMatrix(mat);
+   float rot[9];
+   float absRot[9];
+   for(int r = 0; r < 3; r++)
+   {
+      for(int c = 0; c < 3; c++)
+      {
+         rot[r * 3 + c] = mat[r][c];
+         absRot[r * 3 + c] = Ogre::Math::Abs(mat[r][c]);
+      }
+   }
+
+   /* Node pairs to visit (a, b) */
+   Ogre::uint32 stack[MESH_BVH_PAIR_STACK_SIZE][2];
+   int stackSize = 0;
+   stack[stackSize][0] = 0;
+   stack[stackSize++][1] = 0;
+
+   size_t found = 0;
+   while(stackSize > 0)
+   {
+      stackSize--;
+      const Node& na = a.nodes[stack[stackSize][0]];
+      const Node& nb = b.nodes[stack[stackSize][1]];
+
+      /* Check if bounds overlap (b's ones as an AABB at a space) */
+      bool overlap = true;
+      for(int r = 0; (r < 3) && (overlap); r++)
+      {
+         Ogre::Real center = position[r];
+         Ogre::Real extent = 0.0f;
+         for(int c = 0; c < 3; c++)
+         {
+            center += rot[r * 3 + c] * (nb.min[c] + nb.max[c]) * 0.5f;
+            extent += absRot[r * 3 + c] * (nb.max[c] - nb.min[c]) * 0.5f;
+         }
+         overlap = (center - extent <= na.max[r]) && 
+                   (center + extent >= na.min[r]);
+      }
+      if(!overlap)
+      {
+         continue;
+      }
+
+      if((na.count > 0) && (nb.count > 0))
+      {
+         found += collideLeaves(a, na, b, nb, rot, position, contacts, 
+               maxContacts - found);
+         if(found >= maxContacts)
+         {
+            break;
+         }
+      }
+      else if((nb.count > 0) || ((na.count == 0) && 
+              (surfaceArea(na.min, na.max) >= surfaceArea(nb.min, nb.max))))
+      {
+         /* Descend on a */
+         Ogre::uint32 ib = stack[stackSize][1];
+         stack[stackSize][0] = na.first;
+         stack[stackSize++][1] = ib;
+         stack[stackSize][0] = na.first + 1;
+         stack[stackSize++][1] = ib;
+      }
+      else
+      {
+         /* Descend on b */
+         Ogre::uint32 ia = stack[stackSize][0];
+         stack[stackSize][0] = ia;
+         stack[stackSize++][1] = nb.first;
+         stack[stackSize][0] = ia;
+         stack[stackSize++][1] = nb.first + 1;
+      }
+   }
+
+   return found;
+}
+
+/***********************************************************************
+ *                              intersects                             *
+ ***********************************************************************/
+bool MeshBvh::intersects(const MeshBvh& a, const MeshBvh& b,
+      const Ogre::Quaternion& orientation, const Ogre::Vector3& position)
+{
+   return collide(a, b, orientation, position, NULL, 1) > 0;
+}
+
+/***********************************************************************
+ *                             getContacts                             *
+ ***********************************************************************/
+size_t MeshBvh::getContacts(const MeshBvh& a, const MeshBvh& b,
+      const Ogre::Quaternion& orientation, const Ogre::Vector3& position, 
+      std::vector<MeshContact>& contacts, size_t maxContacts)
+{
+   return collide(a, b, orientation, position, &contacts, maxContacts);
+}
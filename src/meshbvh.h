@@ -0,0 +1,324 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_mesh_bvh_h
+#define _goblin_mesh_bvh_h
+
+#include <OGRE/OgrePrerequisites.h>
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreRay.h>
+#include <OGRE/OgreQuaternion.h>
+#include <OGRE/OgreMath.h>
+
+#include <vector>
+
+/*! Default maximum triangle pairs got by MeshBvh::getContacts */
+#define MESH_BVH_MAX_CONTACTS   256
+
+namespace Goblin
+{
+
+/*! Result of a ray query against a mesh */
+class MeshRayHit
+{
+   public:
+      /*! Constructor */
+      MeshRayHit() : triangle(NO_TRIANGLE), distance(0.0f), u(0.0f), 
+                     v(0.0f) {};
+
+      /*! \return if this is a hit (or a miss of a batched query) */
+      const bool isHit() const { return triangle != NO_TRIANGLE; };
+
+      /*! Triangle value of a miss */
+      static const Ogre::uint32 NO_TRIANGLE = 0xFFFFFFFF;
+
+      Ogre::uint32 triangle; /**< Hit triangle (its first index / 3) */
+      Ogre::Real distance;   /**< Distance from the ray origin */
+      /*! Barycentric coordinates of the hit point: its weight on the
+       * triangle second (u) and third (v) vertices. The first vertex
+       * weight is 1 - u - v. */
+      Ogre::Real u;
+      Ogre::Real v;
+};
+
+/*! A pair of intersecting triangles of two meshes */
+class MeshContact
+{
+   public:
+      /*! Constructor */
+      MeshContact(Ogre::uint32 triangleA, Ogre::uint32 triangleB)
+         : triangleA(triangleA), triangleB(triangleB) {};
+
+      Ogre::uint32 triangleA; /**< Triangle of the first mesh */
+      Ogre::uint32 triangleB; /**< Triangle of the second mesh */
+};
+
+/*! A bounding volume hierarchy over a triangle mesh (built with the
+ * surface area heuristic), to accelerate ray queries on it.
+ * \note when built from full precision vertices, the BVH keeps its own
+ *       copy of the triangles, thus the mesh isn't needed after #build.
+ *       When built from a QuantizedMesh, it only refers to its triangles,
+ *       decoding them when tested, thus the mesh must be kept. */
+class MeshBvh
+{
+   public:
+      /*! A mesh with 16 bits quantized vertices (like the ones kept by
+       * CachedMesh on compact mode), not owned by the BVH. */
+      class QuantizedMesh
+      {
+         public:
+            /*! Constructor */
+            QuantizedMesh() : vertices(NULL), indices16(NULL), 
+                              indices(NULL) {};
+
+            /*! \return decoded vertex of an index */
+            Ogre::Vector3 getVertex(Ogre::uint32 index) const
+            {
+               const Ogre::uint16* q = &vertices[index * 3];
+               return Ogre::Vector3(quantMin.x + q[0] * quantStep.x,
+                     quantMin.y + q[1] * quantStep.y,
+                     quantMin.z + q[2] * quantStep.z);
+            };
+            /*! \return the i-th triangle list index */
+            Ogre::uint32 getIndex(size_t i) const
+            {
+               return (indices) ? indices[i] : indices16[i];
+            };
+
+            const Ogre::uint16* vertices; /**< x, y, z of each vertex */
+            Ogre::Vector3 quantMin;  /**< Decoded value of 0 */
+            Ogre::Vector3 quantStep; /**< Decoded value of 1 */
+            const Ogre::uint16* indices16; /**< 16 bits indices, or NULL */
+            const Ogre::uint32* indices; /**< 32 bits indices, or NULL */
+      };
+
+      /*! Constructor */
+      MeshBvh();
+      /*! Destructor */
+      ~MeshBvh();
+
+      /*! Build the BVH over a mesh.
+       * \param vertices the mesh vertices
+       * \param indices the mesh triangle list indices
+       * \param indexCount number of indices */
+      void build(const Ogre::Vector3* vertices, const Ogre::uint32* indices,
+            size_t indexCount);
+      /*! Build the BVH over a quantized mesh, referring to its triangles
+       * instead of copying them.
+       * \param mesh the mesh. Its data must be kept valid while the BVH 
+       *        is used (or rebuilt).
+       * \param indexCount number of indices */
+      void build(const QuantizedMesh& mesh, size_t indexCount);
+
+      /*! Get the nearest triangle hit by a ray.
+       * \param ray ray to test, in the mesh space
+       * \param hit receive the nearest hit, if any.
+       * \param maxDistance ignore hits farther than it
+       * \return true if hit any triangle. */
+      bool rayIntersect(const Ogre::Ray& ray, MeshRayHit& hit,
+            Ogre::Real maxDistance=Ogre::Math::POS_INFINITY) const;
+
+      /*! Get the nearest triangle hit by each ray of a batch. Each 4 
+       * consecutive rays with near directions (like ground probes) are
+       * traversed as a packet, testing each node and triangle against 
+       * all of them at once. Divergent ones are traversed one by one.
+       * \note for better performance, keep coherent rays consecutive.
+       * \param rays array with the rays to test, in the mesh space
+       * \param count number of rays
+       * \param hits array to receive the nearest hit of each ray. 
+       *        Rays that didn't hit receive MeshRayHit::NO_TRIANGLE.
+       * \param maxDistance ignore hits farther than it
+       * \return number of rays that hit any triangle */
+      size_t rayIntersect(const Ogre::Ray* rays, size_t count,
+            MeshRayHit* hits, 
+            Ogre::Real maxDistance=Ogre::Math::POS_INFINITY) const;
+
+      /*! Check if two meshes intersect (ie: any of their triangles), 
+       * traversing both BVHs together.
+       * \param a BVH of the first mesh
+       * \param b BVH of the second mesh
+       * \param orientation rotation from b to a space
+       * \param position translation from b to a space (after rotation)
+       * \return true if they intersect. */
+      static bool intersects(const MeshBvh& a, const MeshBvh& b,
+            const Ogre::Quaternion& orientation, 
+            const Ogre::Vector3& position);
+
+      /*! Get the intersecting triangle pairs of two meshes (see 
+       * #intersects for parameters).
+       * \param contacts vector to receive the intersecting triangles 
+       *        (appended to it, in no particular order).
+       * \param maxContacts stop after finding this many pairs
+       * \return number of pairs found */
+      static size_t getContacts(const MeshBvh& a, const MeshBvh& b,
+            const Ogre::Quaternion& orientation, 
+            const Ogre::Vector3& position, 
+            std::vector<MeshContact>& contacts, 
+            size_t maxContacts=MESH_BVH_MAX_CONTACTS);
+
+      /*! \return size, in bytes, of the BVH data (see #writeData) */
+      size_t getDataSize() const;
+      /*! Write the BVH data, to be later used with #setData.
+       * \param dst where to write (with at least #getDataSize bytes) */
+      void writeData(Ogre::uint8* dst) const;
+      /*! Use BVH data written by #writeData (usually on a mapped file),
+       * without copying it.
+       * \param data the BVH data. Must be 4 bytes aligned and be kept 
+       *        valid while the BVH is used (or rebuilt).
+       * \param size data size, in bytes.
+       * \param mesh the quantized mesh the BVH was built from, if any. 
+       *        Must be kept valid as the data.
+       * \return false if the data isn't valid. */
+      bool setData(const Ogre::uint8* data, size_t size,
+            const QuantizedMesh* mesh=NULL);
+
+      /*! \return if the BVH is empty (not built or no triangles) */
+      const bool isEmpty() const { return nodeCount == 0; };
+      /*! \return number of nodes of the BVH */
+      const size_t getNodeCount() const { return nodeCount; };
+      /*! \return minimum corner of the mesh bounds */
+      const Ogre::Vector3& getMinimum() const;
+      /*! \return maximum corner of the mesh bounds */
+      const Ogre::Vector3& getMaximum() const;
+
+   protected:
+      /*! A BVH node, with 32 bytes */
+      class Node
+      {
+         public:
+            Ogre::Vector3 min;   /**< Bounds minimum */
+            /*! First child node index (its sibling is the next one), or
+             * first triangle at #triangles for leaves */
+            Ogre::uint32 first;
+            Ogre::Vector3 max;   /**< Bounds maximum */
+            Ogre::uint32 count;  /**< Triangles, if leaf. 0 otherwise */
+      };
+
+      /*! Split a node (at #nodesBuffer), if worth it, by SAH over binned
+       * centroids.
+       * \return true if splitted */
+      bool split(Ogre::uint32 nodeIndex,
+            const std::vector<Ogre::Vector3>& centroids,
+            const std::vector<Ogre::Vector3>& triMin,
+            const std::vector<Ogre::Vector3>& triMax);
+
+      /*! Build the nodes, after the triangles bounds and centroids 
+       * (with #trianglesBuffer filled). */
+      void buildNodes(const std::vector<Ogre::Vector3>& centroids,
+            const std::vector<Ogre::Vector3>& triMin,
+            const std::vector<Ogre::Vector3>& triMax);
+
+      /*! Calculate a node bounds from its triangles */
+      void calculateBounds(Node& node,
+            const std::vector<Ogre::Vector3>& triMin,
+            const std::vector<Ogre::Vector3>& triMax);
+
+      /*! Get a triangle vertex 0 and edges, as at #triData.
+       * \param i triangle position at #triangles
+       * \param tmp where to decode it, if built from a QuantizedMesh
+       * \return pointer to its vertex 0 and edges */
+      const Ogre::Vector3* getTriangle(Ogre::uint32 i, 
+            Ogre::Vector3* tmp) const
+      {
+         if(triData)
+         {
+            return &triData[i * 3];
+         }
+         size_t t = triangles[i] * 3;
+         tmp[0] = quantized.getVertex(quantized.getIndex(t));
+         tmp[1] = quantized.getVertex(quantized.getIndex(t + 1)) - tmp[0];
+         tmp[2] = quantized.getVertex(quantized.getIndex(t + 2)) - tmp[0];
+         return tmp;
+      };
+
+      /*! Intersect a ray with a node bounds.
+       * \return entry distance, or POS_INFINITY if not hit before maxDist */
+      static Ogre::Real intersectBounds(const Node& node,
+            const Ogre::Vector3& origin, const Ogre::Vector3& invDir,
+            Ogre::Real maxDist);
+
+      /*! Intersect a ray with a triangle (both faces).
+       * \param tri the triangle vertex 0 and edges (see #getTriangle)
+       * \return if hit, before the current hit.distance */
+      static bool intersectTriangle(const Ogre::Vector3& origin,
+            const Ogre::Vector3& dir, const Ogre::Vector3* tri,
+            MeshRayHit& hit);
+
+      /*! Traverse two BVHs together, testing the triangles of each
+       * overlapping leaves pair (see #intersects for parameters).
+       * \param contacts where to append the found pairs, NULL to just 
+       *        count them.
+       * \param maxContacts stop after this many pairs
+       * \return number of pairs found */
+      static size_t collide(const MeshBvh& a, const MeshBvh& b,
+            const Ogre::Quaternion& orientation, 
+            const Ogre::Vector3& position, 
+            std::vector<MeshContact>* contacts, size_t maxContacts);
+
+      /*! Test the triangles of two leaves, 1 of a against up to 4 of b
+       * at once, rejecting the pairs separated by a triangle plane before
+       * the exact test.
+       * \param rot rotation matrix from b to a space (row major)
+       * \return number of pairs found (up to maxContacts) */
+      static size_t collideLeaves(const MeshBvh& a, const Node& leafA,
+            const MeshBvh& b, const Node& leafB, const float* rot,
+            const Ogre::Vector3& position, 
+            std::vector<MeshContact>* contacts, size_t maxContacts);
+
+      /*! Exact triangle-triangle intersection test (Moller's interval
+       * overlap, with coplanar triangles tested on their plane).
+       * \param a the first triangle vertices
+       * \param b the second triangle vertices
+       * \return if they intersect */
+      static bool intersectTriangles(const Ogre::Vector3* a, 
+            const Ogre::Vector3* b);
+
+      /*! \return if the rays have near directions, thus worth being
+       *          traversed together as a packet */
+      static bool isCoherent(const Ogre::Ray* rays, size_t count);
+
+      /*! Intersect a packet of up to 4 rays with the BVH.
+       * \return number of rays that hit */
+      size_t intersectPacket(const Ogre::Ray* rays, size_t count,
+            MeshRayHit* hits, Ogre::Real maxDistance) const;
+
+      /*! Point the data to our own buffers */
+      void useBuffers();
+
+      const Node* nodes;  /**< The nodes, root at first */
+      Ogre::uint32 nodeCount; /**< Number of nodes */
+      const Ogre::uint32* triangles; /**< Triangles, by leaf */
+      Ogre::uint32 triangleCount; /**< Number of triangles */
+      /*! Vertex 0, edge 0-1 and edge 0-2 of each triangle, in the same
+       * order of #triangles (so leaves are read sequentially). NULL when
+       * built from a QuantizedMesh. */
+      const Ogre::Vector3* triData;
+      /*! Mesh the triangles are decoded from, when without #triData */
+      QuantizedMesh quantized;
+
+      /* Our own data, when built (instead of set by #setData) */
+      std::vector<Node> nodesBuffer; /**< Nodes */
+      std::vector<Ogre::uint32> trianglesBuffer; /**< Triangles */
+      std::vector<Ogre::Vector3> triDataBuffer; /**< Triangles data */
+};
+
+}
+
+#endif
@@ -0,0 +1,1049 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "meshcache.h"
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+
+#include <OGRE/OgreSubMesh2.h>
+#include <OGRE/OgreResourceGroupManager.h>
+#include <OGRE/Vao/OgreIndexBufferPacked.h>
+#include <OGRE/Hash/MurmurHash3.h>
+
+#include <kobold/log.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "vertexutils.h"
+#include "meshbvh.h"
+#include "mappedfile.h"
+
+using namespace Goblin;
+
+/* Cache file identification ("GBCM") and version. Increment the version
+ * on any change to the file layout (or to what is stored on it). */
+#define MESH_CACHE_FILE_MAGIC     0x4D434247
+#define MESH_CACHE_FILE_VERSION   4
+#define MESH_CACHE_FILE_SEED      0x6F626C6E
+
+/* Cache file flags */
+#define MESH_CACHE_FILE_COMPACT   0x01 /**< Quantized vertices */
+#define MESH_CACHE_FILE_INDEX16   0x02 /**< 16 bits indices */
+#define MESH_CACHE_FILE_LOD_SHIFT 8    /**< LOD level, at bits 8-15 */
+#define MESH_CACHE_FILE_PROXY_SHIFT 16 /**< Proxy level, at bits 16-23 */
+
+/* Cells along the longest axis of the first auto simplified LOD level */
+#define MESH_CACHE_PROXY_GRID     64
+/* Minimum cells of an auto simplified LOD level */
+#define MESH_CACHE_MIN_PROXY_GRID 4
+
+/* Max vertices to keep 16 bits indices on compact mode */
+#define MESH_CACHE_MAX_INDEX16_VERTICES   65536
+
+/*! Header of a cached mesh file. It's followed by the mesh name, the
+ * vertices, the indices (each padded to 4 bytes) and the BVH data (if 
+ * any), all to be used directly from the mapped file. */
+class MeshCacheFileHeader
+{
+   public:
+      Ogre::uint32 magic;         /**< MESH_CACHE_FILE_MAGIC */
+      Ogre::uint32 version;       /**< MESH_CACHE_FILE_VERSION */
+      Ogre::uint64 contentHash[2]; /**< Hash of the mesh file */
+      float scale[3];             /**< Scale applied to the vertices */
+      Ogre::uint32 nameSize;      /**< Mesh name size, in bytes */
+      Ogre::uint32 vertexCount;   /**< Number of vertices */
+      Ogre::uint32 indexCount;    /**< Number of indices */
+      Ogre::uint32 bvhSize;       /**< BVH data size, in bytes */
+      Ogre::uint32 flags;         /**< MESH_CACHE_FILE_* flags */
+      float quantMin[3];          /**< Quantization origin, if compact */
+      float quantStep[3];         /**< Quantization step, if compact */
+};
+
+/***********************************************************************
+ *                             padTo4Bytes                             *
+ ***********************************************************************/
+static inline size_t padTo4Bytes(size_t size)
+{
+   return (size + 3) & ~((size_t)3);
+}
+
+/***********************************************************************
+ *                             writePadded                             *
+ ***********************************************************************/
+static bool writePadded(FILE* f, const void* data, size_t size)
+{
+   const char padding[4] = {0, 0, 0, 0};
+   size_t paddingSize = padTo4Bytes(size) - size;
+   return ((size == 0) || (fwrite(data, 1, size, f) == size)) &&
+          ((paddingSize == 0) || 
+           (fwrite(padding, 1, paddingSize, f) == paddingSize));
+}
+
+/***********************************************************************
+ *                            offsetIndices                            *
+ ***********************************************************************/
+template<class SrcType, class DstType> static void offsetIndices(
+      const SrcType* src, DstType* dst, size_t count, Ogre::uint32 offset)
+{
+   for(size_t i = 0; i < count; i++)
+   {
+      dst[i] = static_cast<DstType>(src[i] + offset);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////
+//                                                                       //
+//                              CachedMesh                               //
+//                                                                       //
+///////////////////////////////////////////////////////////////////////////
+
+/***********************************************************************
+ *                             Constructor                             *
+ ***********************************************************************/
+CachedMesh::CachedMesh(const Ogre::String& meshName, 
+      const Ogre::Vector3& scale, bool compact, Ogre::uint8 lod)
+{
+   this->meshName = meshName;
+   this->scale = scale;
+   this->vertexCount = 0;
+   this->vertices = NULL;
+   this->indexCount = 0;
+   this->indices = NULL;
+   this->compact = compact;
+   this->lod = lod;
+   this->proxyLevel = 0;
+   this->quantizedVertices = NULL;
+   this->quantMin = Ogre::Vector3::ZERO;
+   this->quantStep = Ogre::Vector3::ZERO;
+   this->indices16 = NULL;
+   this->meshlets = NULL;
+   this->bvh = NULL;
+   this->references = 0;
+   this->ready = false;
+   this->contentHash[0] = 0;
+   this->contentHash[1] = 0;
+   this->mappedFile = NULL;
+}
+
+/***********************************************************************
+ *                              Destructor                             *
+ ***********************************************************************/
+CachedMesh::~CachedMesh()
+{
+   if(mappedFile)
+   {
+      /* Note: bvh must be deleted before, as it could use mapped data */
+      if(bvh)
+      {
+         delete bvh;
+         bvh = NULL;
+      }
+      delete mappedFile;
+   }
+   else
+   {
+      if(vertices)
+      {
+         delete[] vertices;
+      }
+      if(indices)
+      {
+         delete[] indices;
+      }
+      if(quantizedVertices)
+      {
+         delete[] quantizedVertices;
+      }
+      if(indices16)
+      {
+         delete[] indices16;
+      }
+   }
+   if(meshlets)
+   {
+      delete meshlets;
+   }
+   if(bvh)
+   {
+      delete bvh;
+   }
+}
+
+/***********************************************************************
+ *                            buildMeshlets                            *
+ ***********************************************************************/
+void CachedMesh::buildMeshlets(Ogre::uint32 maxVertices, 
+      Ogre::uint32 maxTriangles)
+{
+   if(!meshlets)
+   {
+      meshlets = new MeshletList();
+   }
+
+   /* Compact ones must be decoded first */
+   std::vector<Ogre::Vector3> decodedVertices;
+   std::vector<Ogre::uint32> decodedIndices;
+   const Ogre::Vector3* srcVertices = vertices;
+   const Ogre::uint32* srcIndices = indices;
+   if(((!vertices) || (!indices)) && (indexCount > 0))
+   {
+      decode(decodedVertices, decodedIndices);
+      srcVertices = &decodedVertices[0];
+      srcIndices = &decodedIndices[0];
+   }
+
+   VertexUtils::buildMeshlets(reinterpret_cast<const uint8_t*>(srcVertices),
+         sizeof(Ogre::Vector3), vertexCount, 0, srcIndices, indexCount, 
+         *meshlets, maxVertices, maxTriangles);
+}
+
+/***********************************************************************
+ *                                decode                               *
+ ***********************************************************************/
+void CachedMesh::decode(std::vector<Ogre::Vector3>& outVertices,
+      std::vector<Ogre::uint32>& outIndices) const
+{
+   outVertices.resize(vertexCount);
+   for(size_t i = 0; i < vertexCount; i++)
+   {
+      outVertices[i] = getVertex(i);
+   }
+   outIndices.resize(indexCount);
+   for(size_t i = 0; i < indexCount; i++)
+   {
+      outIndices[i] = getIndex(i);
+   }
+}
+
+/***********************************************************************
+ *                            getMemorySize                            *
+ ***********************************************************************/
+const size_t CachedMesh::getMemorySize() const
+{
+   size_t vertexSize = (vertices) ? sizeof(Ogre::Vector3) : 
+                                    3 * sizeof(Ogre::uint16);
+   size_t indexSize = (indices) ? sizeof(Ogre::uint32) : 
+                                  sizeof(Ogre::uint16);
+   size_t bvhSize = (bvh) ? bvh->getDataSize() : 0;
+   return vertexCount * vertexSize + indexCount * indexSize + bvhSize;
+}
+
+/***********************************************************************
+ *                               quantize                              *
+ ***********************************************************************/
+void CachedMesh::quantize(const Ogre::Vector3* src)
+{
+   if(quantizedVertices)
+   {
+      delete[] quantizedVertices;
+      quantizedVertices = NULL;
+   }
+   if(vertexCount == 0)
+   {
+      return;
+   }
+
+   /* Define the quantization grid over the bounds */
+   Ogre::Vector3 vMin = src[0];
+   Ogre::Vector3 vMax = src[0];
+   for(size_t i = 1; i < vertexCount; i++)
+   {
+      vMin.makeFloor(src[i]);
+      vMax.makeCeil(src[i]);
+   }
+   quantMin = vMin;
+   quantStep = (vMax - vMin) / 65535.0f;
+   Ogre::Vector3 invStep;
+   for(int axis = 0; axis < 3; axis++)
+   {
+      invStep[axis] = (quantStep[axis] > 0.0f) ? 1.0f / quantStep[axis] :
+                                                 0.0f;
+   }
+
+   /* Quantize to its nearest grid point */
+   quantizedVertices = new Ogre::uint16[vertexCount * 3];
+   for(size_t i = 0; i < vertexCount; i++)
+   {
+      for(int axis = 0; axis < 3; axis++)
+      {
+         float q = (src[i][axis] - quantMin[axis]) * invStep[axis] + 0.5f;
+         quantizedVertices[i * 3 + axis] = static_cast<Ogre::uint16>(
+               Ogre::Math::Clamp(q, 0.0f, 65535.0f));
+      }
+   }
+}
+
+/***********************************************************************
+ *                               getBvh                                *
+ ***********************************************************************/
+const MeshBvh* CachedMesh::getBvh()
+{
+   if(!ready)
+   {
+      return NULL;
+   }
+   if(!bvh)
+   {
+      bvh = new MeshBvh();
+      if((vertices) && (indices))
+      {
+         bvh->build(vertices, indices, indexCount);
+      }
+      else if(indexCount > 0)
+      {
+         /* Compact: the BVH refers to our quantized triangles, instead
+          * of keeping its own full precision copy */
+         MeshBvh::QuantizedMesh mesh;
+         mesh.vertices = quantizedVertices;
+         mesh.quantMin = quantMin;
+         mesh.quantStep = quantStep;
+         mesh.indices16 = indices16;
+         mesh.indices = indices;
+         bvh->build(mesh, indexCount);
+      }
+
+      /* Persist it for next runs */
+      saveToCacheFile();
+   }
+   return bvh;
+}
+
+/***********************************************************************
+ *                             setCacheFile                            *
+ ***********************************************************************/
+void CachedMesh::setCacheFile(const Ogre::String& fileName, 
+      const Ogre::uint64* contentHash)
+{
+   this->cacheFile = fileName;
+   this->contentHash[0] = contentHash[0];
+   this->contentHash[1] = contentHash[1];
+}
+
+/***********************************************************************
+ *                          loadFromCacheFile                          *
+ ***********************************************************************/
+bool CachedMesh::loadFromCacheFile()
+{
+   if(cacheFile.empty())
+   {
+      return false;
+   }
+
+   MappedFile* file = new MappedFile();
+   if(!file->open(cacheFile))
+   {
+      /* No cache file yet */
+      delete file;
+      return false;
+   }
+
+   /* Check if it's a valid (and up to date) file for this mesh */
+   const Ogre::uint8* data = file->getData();
+   size_t size = file->getSize();
+   MeshCacheFileHeader header;
+   memset(&header, 0, sizeof(header));
+   bool valid = (size >= sizeof(header));
+   if(valid)
+   {
+      memcpy(&header, data, sizeof(header));
+      valid = (header.magic == MESH_CACHE_FILE_MAGIC) &&
+              (header.version == MESH_CACHE_FILE_VERSION) &&
+              (header.contentHash[0] == contentHash[0]) &&
+              (header.contentHash[1] == contentHash[1]) &&
+              (header.scale[0] == scale.x) && 
+              (header.scale[1] == scale.y) &&
+              (header.scale[2] == scale.z) &&
+              (header.nameSize == meshName.size()) &&
+              (((header.flags & MESH_CACHE_FILE_COMPACT) != 0) == compact) &&
+              (((header.flags >> MESH_CACHE_FILE_LOD_SHIFT) & 0xFF) == lod);
+   }
+   bool index16 = (header.flags & MESH_CACHE_FILE_INDEX16) != 0;
+   size_t nameOffset = sizeof(header);
+   size_t vertexOffset = nameOffset + padTo4Bytes(header.nameSize);
+   size_t indexOffset = vertexOffset + ((compact) ?
+      padTo4Bytes((size_t) header.vertexCount * 3 * sizeof(Ogre::uint16)) :
+      (size_t) header.vertexCount * sizeof(Ogre::Vector3));
+   size_t bvhOffset = indexOffset + ((index16) ?
+      padTo4Bytes((size_t) header.indexCount * sizeof(Ogre::uint16)) :
+      (size_t) header.indexCount * sizeof(Ogre::uint32));
+   valid = valid && (bvhOffset + header.bvhSize == size) &&
+      (memcmp(data + nameOffset, meshName.c_str(), header.nameSize) == 0);
+
+   /* Use the data directly from the file */
+   MeshBvh* fileBvh = NULL;
+   if((valid) && (header.bvhSize > 0))
+   {
+      fileBvh = new MeshBvh();
+      if(compact)
+      {
+         /* Without triangles data: refers to the mapped mesh */
+         MeshBvh::QuantizedMesh mesh;
+         mesh.vertices = reinterpret_cast<const Ogre::uint16*>(
+               data + vertexOffset);
+         mesh.quantMin = Ogre::Vector3(header.quantMin);
+         mesh.quantStep = Ogre::Vector3(header.quantStep);
+         if(index16)
+         {
+            mesh.indices16 = reinterpret_cast<const Ogre::uint16*>(
+                  data + indexOffset);
+         }
+         else
+         {
+            mesh.indices = reinterpret_cast<const Ogre::uint32*>(
+                  data + indexOffset);
+         }
+         valid = fileBvh->setData(data + bvhOffset, header.bvhSize, &mesh);
+      }
+      else
+      {
+         valid = fileBvh->setData(data + bvhOffset, header.bvhSize);
+      }
+   }
+   if(!valid)
+   {
+      Kobold::Log::add(Kobold::LOG_LEVEL_DEBUG, 
+            "Mesh cache file '%s' is outdated or invalid.", 
+            cacheFile.c_str());
+      if(fileBvh)
+      {
+         delete fileBvh;
+      }
+      delete file;
+      return false;
+   }
+
+   mappedFile = file;
+   Ogre::uint8* vertexData = const_cast<Ogre::uint8*>(data + vertexOffset);
+   Ogre::uint8* indexData = const_cast<Ogre::uint8*>(data + indexOffset);
+   proxyLevel = static_cast<Ogre::uint8>(
+         (header.flags >> MESH_CACHE_FILE_PROXY_SHIFT) & 0xFF);
+   vertexCount = header.vertexCount;
+   if(compact)
+   {
+      quantizedVertices = reinterpret_cast<Ogre::uint16*>(vertexData);
+      quantMin = Ogre::Vector3(header.quantMin);
+      quantStep = Ogre::Vector3(header.quantStep);
+   }
+   else
+   {
+      vertices = reinterpret_cast<Ogre::Vector3*>(vertexData);
+   }
+   indexCount = header.indexCount;
+   if(index16)
+   {
+      indices16 = reinterpret_cast<Ogre::uint16*>(indexData);
+   }
+   else
+   {
+      indices = reinterpret_cast<Ogre::uint32*>(indexData);
+   }
+   bvh = fileBvh;
+   ready = true;
+
+   return true;
+}
+
+/***********************************************************************
+ *                           saveToCacheFile                           *
+ ***********************************************************************/
+void CachedMesh::saveToCacheFile()
+{
+   if((cacheFile.empty()) || (!ready))
+   {
+      return;
+   }
+
+   MeshCacheFileHeader header;
+   memset(&header, 0, sizeof(header));
+   header.magic = MESH_CACHE_FILE_MAGIC;
+   header.version = MESH_CACHE_FILE_VERSION;
+   header.contentHash[0] = contentHash[0];
+   header.contentHash[1] = contentHash[1];
+   header.scale[0] = scale.x;
+   header.scale[1] = scale.y;
+   header.scale[2] = scale.z;
+   header.nameSize = meshName.size();
+   header.vertexCount = vertexCount;
+   header.indexCount = indexCount;
+   header.bvhSize = (bvh) ? bvh->getDataSize() : 0;
+   header.flags = ((compact) ? MESH_CACHE_FILE_COMPACT : 0) |
+                  ((indices16) ? MESH_CACHE_FILE_INDEX16 : 0) |
+                  (lod << MESH_CACHE_FILE_LOD_SHIFT) |
+                  (proxyLevel << MESH_CACHE_FILE_PROXY_SHIFT);
+   for(int axis = 0; axis < 3; axis++)
+   {
+      header.quantMin[axis] = quantMin[axis];
+      header.quantStep[axis] = quantStep[axis];
+   }
+
+   /* Vertices and indices, as stored */
+   const void* vertexData = vertices;
+   size_t vertexSize = vertexCount * sizeof(Ogre::Vector3);
+   if(compact)
+   {
+      vertexData = quantizedVertices;
+      vertexSize = vertexCount * 3 * sizeof(Ogre::uint16);
+   }
+   const void* indexData = indices;
+   size_t indexSize = indexCount * sizeof(Ogre::uint32);
+   if(indices16)
+   {
+      indexData = indices16;
+      indexSize = indexCount * sizeof(Ogre::uint16);
+   }
+
+   /* Write to a temporary, replacing the file only when complete (also
+    * keeping valid the one that could be mapped right now). */
+   Ogre::String tmpFile = cacheFile + ".tmp";
+   FILE* f = fopen(tmpFile.c_str(), "wb");
+   if(!f)
+   {
+      Kobold::Log::add(Kobold::LOG_LEVEL_ERROR, 
+            "Error: couldn't create mesh cache file '%s'", tmpFile.c_str());
+      return;
+   }
+   bool ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+      (writePadded(f, meshName.c_str(), header.nameSize)) &&
+      (writePadded(f, vertexData, vertexSize)) &&
+      (writePadded(f, indexData, indexSize));
+   if((ok) && (bvh))
+   {
+      std::vector<Ogre::uint8> bvhData(header.bvhSize);
+      bvh->writeData(&bvhData[0]);
+      ok = (fwrite(&bvhData[0], 1, bvhData.size(), f) == bvhData.size());
+   }
+   ok &= (fclose(f) == 0);
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+   /* Windows' rename doesn't overwrite. Note that it will fail if the
+    * file is mapped, keeping the older one (that is still valid). */
+   if(ok)
+   {
+      remove(cacheFile.c_str());
+   }
+#endif
+   if((!ok) || (rename(tmpFile.c_str(), cacheFile.c_str()) != 0))
+   {
+      Kobold::Log::add(Kobold::LOG_LEVEL_ERROR, 
+            "Error: couldn't write mesh cache file '%s'", cacheFile.c_str());
+      remove(tmpFile.c_str());
+   }
+}
+
+/***********************************************************************
+ *                             requestLoad                             *
+ ***********************************************************************/
+void CachedMesh::requestLoad(const Ogre::MeshPtr& mesh)
+{
+   /* Original Code - Code found on this forum link: 
+    * http://www.ogre3d.org/wiki/index.php/RetrieveVertexData
+    * Most Code courtesy of al2950( thanks m8 :)), but then edited by 
+    * Jayce Young & Hannah Young at Aurasoft UK (Skyline Game Engine) 
+    * to work with Items in the scene. MIT License. 
+    * Later split in request and finish, to not wait for the transfers. */
+
+   /* Define the LOD level to read: the desired one, if all submeshes 
+    * have it, or else the coarsest one, to simplify from. */
+   size_t readLod = lod;
+   Ogre::Mesh::SubMeshVec::const_iterator subMeshIterator = 
+      mesh->getSubMeshes().begin();
+   while (subMeshIterator != mesh->getSubMeshes().end())
+   {
+      const Ogre::VertexArrayObjectArray& vaos = (*subMeshIterator)->mVao[0];
+      if(!vaos.empty())
+      {
+         readLod = std::min(readLod, vaos.size() - 1);
+      }
+      subMeshIterator++;
+   }
+   proxyLevel = static_cast<Ogre::uint8>(lod - readLod);
+
+   /* First, we compute the total number of vertices and indices 
+    * and init the buffers. */
+   unsigned int numVertices = 0;
+   unsigned int numIndices = 0;
+
+   subMeshIterator = mesh->getSubMeshes().begin();
+   while (subMeshIterator != mesh->getSubMeshes().end())
+   {
+      Ogre::SubMesh *subMesh = *subMeshIterator;
+
+      if(!subMesh->mVao[0].empty())
+      {
+         Ogre::VertexArrayObject* vao = subMesh->mVao[0][readLod];
+         numVertices += vao->getVertexBuffers()[0]->getNumElements();
+         numIndices += vao->getIndexBuffer()->getNumElements();
+      }
+
+      subMeshIterator++;
+   }
+  
+   /* Alloc (or realloc) buffers. Note that compact vertices are only
+    * quantized after read (as they need the bounds), and proxies are
+    * read in full, to be simplified. */
+   if(vertices)
+   {
+      delete[] vertices;
+      vertices = NULL;
+   }
+   if(indices)
+   {
+      delete[] indices;
+      indices = NULL;
+   }
+   if(indices16)
+   {
+      delete[] indices16;
+      indices16 = NULL;
+   }
+   if((!compact) || (proxyLevel > 0))
+   {
+      vertices = new Ogre::Vector3[numVertices];
+   }
+   if((compact) && (proxyLevel == 0) &&
+      (numVertices <= MESH_CACHE_MAX_INDEX16_VERTICES))
+   {
+      indices16 = new Ogre::uint16[numIndices];
+   }
+   else
+   {
+      indices = new Ogre::uint32[numIndices];
+   }
+
+   vertexCount = numVertices;
+   indexCount = numIndices;
+   ready = false;
+   pendingReads.clear();
+
+   unsigned int addedIndices = 0;
+   unsigned int subMeshOffset = 0;
+
+   /* Request the read of each submesh */
+   subMeshIterator = mesh->getSubMeshes().begin();
+   while (subMeshIterator != mesh->getSubMeshes().end())
+   {
+      Ogre::SubMesh *subMesh = *subMeshIterator;
+      Ogre::VertexArrayObjectArray vaos = subMesh->mVao[0];
+
+      if (!vaos.empty())
+      {
+         /* Get the LOD level to read */
+         Ogre::VertexArrayObject *vao = vaos[readLod];
+         Ogre::IndexBufferPacked *indexBuffer = vao->getIndexBuffer();
+
+         pendingReads.push_back(PendingRead());
+         PendingRead& pending = pendingReads.back();
+         pending.vao = vao;
+         pending.vertexOffset = subMeshOffset;
+         pending.indexOffset = addedIndices;
+
+         /* request async read from buffer */
+         pending.requests.push_back(Ogre::VertexArrayObject::ReadRequests(
+                  Ogre::VES_POSITION));
+         vao->readRequests(pending.requests);
+
+         if (indexBuffer)
+         {
+            pending.indices32 = (indexBuffer->getIndexType() == 
+                  Ogre::IndexBufferPacked::IT_32BIT);
+            pending.indexTicket = indexBuffer->readRequest(
+                  0, indexBuffer->getNumElements());
+            addedIndices += indexBuffer->getNumElements();
+         }
+         subMeshOffset += vao->getVertexBuffers()[0]->getNumElements();
+      }
+      subMeshIterator++;
+   }
+}
+
+/***********************************************************************
+ *                               simplify                              *
+ ***********************************************************************/
+void CachedMesh::simplify()
+{
+   /* Each missing level halves the grid */
+   Ogre::uint32 gridSize = std::max<Ogre::uint32>(MESH_CACHE_PROXY_GRID >> 
+         std::min<Ogre::uint32>(proxyLevel - 1, 31), 
+         MESH_CACHE_MIN_PROXY_GRID);
+   std::vector<Ogre::Vector3> proxyVertices;
+   std::vector<Ogre::uint32> proxyIndices;
+   VertexUtils::simplifyByClustering(vertices, vertexCount, indices, 
+         indexCount, gridSize, proxyVertices, proxyIndices);
+
+   /* Replace the full ones */
+   delete[] vertices;
+   vertices = NULL;
+   delete[] indices;
+   indices = NULL;
+   vertexCount = proxyVertices.size();
+   indexCount = proxyIndices.size();
+   if(compact)
+   {
+      quantize((vertexCount > 0) ? &proxyVertices[0] : NULL);
+   }
+   else
+   {
+      vertices = new Ogre::Vector3[vertexCount];
+      std::copy(proxyVertices.begin(), proxyVertices.end(), vertices);
+   }
+   if((compact) && (vertexCount <= MESH_CACHE_MAX_INDEX16_VERTICES))
+   {
+      indices16 = new Ogre::uint16[indexCount];
+      offsetIndices((indexCount > 0) ? &proxyIndices[0] : NULL, indices16,
+            indexCount, 0);
+   }
+   else
+   {
+      indices = new Ogre::uint32[indexCount];
+      std::copy(proxyIndices.begin(), proxyIndices.end(), indices);
+   }
+}
+
+/***********************************************************************
+ *                           isTransferDone                            *
+ ***********************************************************************/
+bool CachedMesh::isTransferDone()
+{
+   for(size_t i = 0; i < pendingReads.size(); i++)
+   {
+      PendingRead& pending = pendingReads[i];
+      for(size_t r = 0; r < pending.requests.size(); r++)
+      {
+         if(!pending.requests[r].asyncTicket->queryIsTransferDone())
+         {
+            return false;
+         }
+      }
+      if((!pending.indexTicket.isNull()) && 
+         (!pending.indexTicket->queryIsTransferDone()))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+/***********************************************************************
+ *                             finishLoad                              *
+ ***********************************************************************/
+bool CachedMesh::finishLoad(bool wait)
+{
+   if(ready)
+   {
+      return true;
+   }
+   if((!wait) && (!isTransferDone()))
+   {
+      /* Not yet, let's try again later. */
+      return false;
+   }
+
+   /* Compact vertices are decoded to a temporary, to be quantized */
+   std::vector<Ogre::Vector3> decodedVertices;
+   Ogre::Vector3* dstVertices = vertices;
+   if((!vertices) && (vertexCount > 0))
+   {
+      decodedVertices.resize(vertexCount);
+      dstVertices = &decodedVertices[0];
+   }
+
+   for(size_t p = 0; p < pendingReads.size(); p++)
+   {
+      PendingRead& pending = pendingReads[p];
+      Ogre::VertexArrayObject::ReadRequestsArray& requests = 
+         pending.requests;
+
+      /* Copy the positions */
+      pending.vao->mapAsyncTickets(requests);
+      unsigned int subMeshVerticiesNum = 
+         requests[0].vertexBuffer->getNumElements();
+
+      Ogre::Vector3* subMeshVertices = dstVertices + pending.vertexOffset;
+      if(VertexUtils::decodeVertexStream(
+               reinterpret_cast<const uint8_t*>(requests[0].data),
+               requests[0].vertexBuffer->getBytesPerElement(),
+               requests[0].type, 
+               reinterpret_cast<uint8_t*>(subMeshVertices),
+               sizeof(Ogre::Vector3), 3, subMeshVerticiesNum))
+      {
+         if(scale != Ogre::Vector3::UNIT_SCALE)
+         {
+            for (size_t i = 0; i < subMeshVerticiesNum; ++i)
+            {
+               subMeshVertices[i] *= scale;
+            }
+         }
+      }
+      else
+      {
+         Kobold::Log::add(Kobold::LOG_LEVEL_ERROR, 
+               "Error: Vertex Buffer type not recognised!");
+      }
+      pending.vao->unmapAsyncTickets(requests);
+
+      /* Copy the indices, offsetting them to our vertices */
+      if(!pending.indexTicket.isNull())
+      {
+         size_t numIndices = pending.vao->getIndexBuffer()->getNumElements();
+         Ogre::uint32 offset = pending.vertexOffset;
+         const void* src = pending.indexTicket->map();
+         if(indices16)
+         {
+            /* Note: all offsetted indices fit, as vertexCount fits */
+            Ogre::uint16* dst = indices16 + pending.indexOffset;
+            if(pending.indices32)
+            {
+               offsetIndices(static_cast<const Ogre::uint32*>(src), dst,
+                     numIndices, offset);
+            }
+            else
+            {
+               offsetIndices(static_cast<const Ogre::uint16*>(src), dst,
+                     numIndices, offset);
+            }
+         }
+         else
+         {
+            Ogre::uint32* dst = indices + pending.indexOffset;
+            if(pending.indices32)
+            {
+               offsetIndices(static_cast<const Ogre::uint32*>(src), dst,
+                     numIndices, offset);
+            }
+            else
+            {
+               offsetIndices(static_cast<const Ogre::uint16*>(src), dst,
+                     numIndices, offset);
+            }
+         }
+         pending.indexTicket->unmap();
+      }
+   }
+
+   if(proxyLevel > 0)
+   {
+      simplify();
+   }
+   else if(compact)
+   {
+      quantize(dstVertices);
+   }
+
+   /* Done: no more need for the tickets */
+   pendingReads.clear();
+   ready = true;
+
+   /* Persist it for next runs */
+   saveToCacheFile();
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////
+//                                                                       //
+//                               MeshCache                               //
+//                                                                       //
+///////////////////////////////////////////////////////////////////////////
+
+/***********************************************************************
+ *                             Key::operator<                          *
+ ***********************************************************************/
+bool MeshCache::Key::operator<(const Key& other) const
+{
+   int cmp = meshName.compare(other.meshName);
+   if(cmp != 0)
+   {
+      return cmp < 0;
+   }
+   for(int i = 0; i < 3; i++)
+   {
+      if(scale[i] != other.scale[i])
+      {
+         return scale[i] < other.scale[i];
+      }
+   }
+   if(compact != other.compact)
+   {
+      return compact < other.compact;
+   }
+   return lod < other.lod;
+}
+
+/***********************************************************************
+ *                               acquire                               *
+ ***********************************************************************/
+CachedMesh* MeshCache::acquire(const Ogre::MeshPtr& mesh, 
+      const Ogre::Vector3& scale, bool async, bool compact, Ogre::uint8 lod)
+{
+   Key key(mesh->getName(), scale, compact, lod);
+   CachedMesh* cachedMesh;
+
+   CachedMeshMap::iterator it = meshes.find(key);
+   if(it != meshes.end())
+   {
+      /* Already cached (or requested), just share it */
+      cachedMesh = it->second;
+   }
+   else
+   {
+      cachedMesh = new CachedMesh(key.meshName, scale, compact, lod);
+      meshes.insert(std::make_pair(key, cachedMesh));
+
+      /* Try to load it from the disk cache */
+      Ogre::uint64 contentHash[2];
+      if((!diskCacheDirectory.empty()) && 
+         (getContentHash(mesh, contentHash)))
+      {
+         cachedMesh->setCacheFile(getCacheFileName(key), contentHash);
+      }
+      if(!cachedMesh->loadFromCacheFile())
+      {
+         /* Must read it from the GPU */
+         cachedMesh->requestLoad(mesh);
+         pending.push_back(cachedMesh);
+      }
+   }
+
+   if(!async)
+   {
+      cachedMesh->finishLoad(true);
+   }
+
+   cachedMesh->references++;
+   return cachedMesh;
+}
+
+/***********************************************************************
+ *                               release                               *
+ ***********************************************************************/
+void MeshCache::release(CachedMesh* cachedMesh)
+{
+   if(cachedMesh == NULL)
+   {
+      return;
+   }
+
+   cachedMesh->references--;
+   if(cachedMesh->references <= 0)
+   {
+      /* Last user: no more needed */
+      meshes.erase(Key(cachedMesh->meshName, cachedMesh->scale, 
+               cachedMesh->compact, cachedMesh->lod));
+      std::vector<CachedMesh*>::iterator it = std::find(pending.begin(), 
+            pending.end(), cachedMesh);
+      if(it != pending.end())
+      {
+         pending.erase(it);
+      }
+      delete cachedMesh;
+   }
+}
+
+/***********************************************************************
+ *                        setDiskCacheDirectory                        *
+ ***********************************************************************/
+void MeshCache::setDiskCacheDirectory(const Ogre::String& dir)
+{
+   diskCacheDirectory = dir;
+   if((!dir.empty()) && (dir[dir.size() - 1] != '/') && 
+      (dir[dir.size() - 1] != '\\'))
+   {
+      diskCacheDirectory += "/";
+   }
+}
+
+/***********************************************************************
+ *                            getContentHash                           *
+ ***********************************************************************/
+bool MeshCache::getContentHash(const Ogre::MeshPtr& mesh, 
+      Ogre::uint64* hash)
+{
+   try
+   {
+      Ogre::DataStreamPtr stream = 
+         Ogre::ResourceGroupManager::getSingleton().openResource(
+               mesh->getName(), mesh->getGroup(), true);
+      Ogre::String contents = stream->getAsString();
+      Ogre::MurmurHash3_x64_128(contents.data(), (int) contents.size(), 
+            MESH_CACHE_FILE_SEED, hash);
+   }
+   catch(Ogre::Exception&)
+   {
+      /* No file for the mesh (for example, a manual one) */
+      return false;
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                           getCacheFileName                          *
+ ***********************************************************************/
+Ogre::String MeshCache::getCacheFileName(const Key& key)
+{
+   Ogre::uint32 nameHash;
+   Ogre::MurmurHash3_x86_32(key.meshName.data(), (int) key.meshName.size(),
+         MESH_CACHE_FILE_SEED, &nameHash);
+   float scale[3] = {key.scale.x, key.scale.y, key.scale.z};
+   Ogre::uint32 scaleHash;
+   Ogre::MurmurHash3_x86_32(scale, sizeof(scale), MESH_CACHE_FILE_SEED, 
+         &scaleHash);
+
+   char fileName[64];
+   snprintf(fileName, sizeof(fileName), "goblin_mesh_%08x_%08x_%u%s.gcm", 
+         nameHash, scaleHash, (unsigned int) key.lod, 
+         (key.compact) ? "_c" : "");
+
+   return diskCacheDirectory + fileName;
+}
+
+/***********************************************************************
+ *                                update                               *
+ ***********************************************************************/
+void MeshCache::update()
+{
+   size_t i = 0;
+   while(i < pending.size())
+   {
+      if(pending[i]->finishLoad(false))
+      {
+         /* Loaded (or was loaded synchronously by an acquire) */
+         pending[i] = pending.back();
+         pending.pop_back();
+      }
+      else
+      {
+         i++;
+      }
+   }
+}
+
+/***********************************************************************
+ *                           static members                            *
+ ***********************************************************************/
+MeshCache::CachedMeshMap MeshCache::meshes;
+std::vector<CachedMesh*> MeshCache::pending;
+Ogre::String MeshCache::diskCacheDirectory;
+
+#endif
+
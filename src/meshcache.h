@@ -0,0 +1,324 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_mesh_cache_h
+#define _goblin_mesh_cache_h
+
+#include <OGRE/OgrePrerequisites.h>
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreMesh2.h>
+#include <OGRE/Vao/OgreAsyncTicket.h>
+#include <OGRE/Vao/OgreVertexArrayObject.h>
+
+#include <map>
+#include <vector>
+
+namespace Goblin
+{
+
+class MeshletList;
+class MeshBvh;
+class MappedFile;
+
+/*! A CPU side copy of a mesh vertices (already scaled) and indices,
+ * usually used for collision detection. It's shared by all models
+ * using the same mesh with the same scale.
+ * \note Get them through MeshCache, never directly.
+ * \note Its data is shared (and could be mapped, read only, from a disk
+ *       cache file), thus must never be changed.
+ * \note On compact mode, positions are quantized to 16 bits per axis 
+ *       (relative to the mesh bounds) and indices are kept with 16 bits
+ *       when the mesh has up to 65536 vertices, thus #getVertices and
+ *       #getIndices (or only the latter) are NULL: use #getVertex and 
+ *       #getIndex, which decode them on the fly.
+ * \note Besides the full detail one (level 0), a mesh could be cached at
+ *       coarser levels of detail, for cheaper distant queries: from the 
+ *       mesh own LOD levels when it has them, or else from a proxy, auto
+ *       simplified (see VertexUtils::simplifyByClustering) from its
+ *       coarsest available level. */
+class CachedMesh
+{
+   public:
+      /*! \return name of the cached mesh */
+      const Ogre::String& getMeshName() const { return meshName; };
+      /*! \return scale applied to the cached vertices */
+      const Ogre::Vector3& getScale() const { return scale; };
+
+      /*! \return if the vertices and indices are available, false while
+       *          they are still being read from the GPU. */
+      const bool isReady() const { return ready; };
+
+      /*! \return level of detail of the cached mesh (0 for full) */
+      const Ogre::uint8 getLod() const { return lod; };
+      /*! \return if the mesh is an auto simplified proxy (ie: the mesh 
+       *          hasn't its own #getLod level) */
+      const bool isProxy() const { return proxyLevel > 0; };
+
+      /*! \return if the mesh is kept on compact mode */
+      const bool isCompact() const { return compact; };
+
+      /*! \return number of cached vertices */
+      const size_t getVertexCount() const { return vertexCount; };
+      /*! \return the cached vertices (NULL on compact mode)
+       * \note shared by all models of the mesh (and could be a read-only 
+       *       file mapping): never change them. */
+      const Ogre::Vector3* getVertices() const { return vertices; };
+      /*! \return number of cached indices */
+      const size_t getIndexCount() const { return indexCount; };
+      /*! \return the cached indices (NULL if kept with 16 bits)
+       * \note shared, as the vertices: never change them. */
+      const Ogre::uint32* getIndices() const { return indices; };
+
+      /*! \return a cached vertex, decoding it if on compact mode */
+      Ogre::Vector3 getVertex(size_t index) const
+      {
+         if(vertices)
+         {
+            return vertices[index];
+         }
+         const Ogre::uint16* q = &quantizedVertices[index * 3];
+         return Ogre::Vector3(quantMin.x + q[0] * quantStep.x,
+                              quantMin.y + q[1] * quantStep.y,
+                              quantMin.z + q[2] * quantStep.z);
+      };
+      /*! \return a cached index, whatever its storage */
+      Ogre::uint32 getIndex(size_t index) const
+      {
+         return (indices) ? indices[index] : indices16[index];
+      };
+      /*! Get all vertices and indices, decoded (if on compact mode).
+       * \param outVertices vector to receive the vertices
+       * \param outIndices vector to receive the indices */
+      void decode(std::vector<Ogre::Vector3>& outVertices,
+            std::vector<Ogre::uint32>& outIndices) const;
+
+      /*! \return memory used by the cached vertices, indices and BVH
+       *          (if built), in bytes (meshlets not included). */
+      const size_t getMemorySize() const;
+
+      /*! Split the mesh in meshlets.
+       * \see VertexUtils::buildMeshlets for parameters */
+      void buildMeshlets(Ogre::uint32 maxVertices,
+            Ogre::uint32 maxTriangles);
+      /*! \return the mesh meshlets, or NULL if not built */
+      const MeshletList* getMeshlets() const { return meshlets; };
+
+      /*! \return the BVH of the mesh, building it on first call.
+       *          NULL if the mesh isn't yet ready. */
+      const MeshBvh* getBvh();
+
+      /*! \return number of current users of this cached mesh */
+      const int getReferences() const { return references; };
+
+   protected:
+      friend class MeshCache;
+
+      /*! Constructor
+       * \param meshName name of the mesh to cache
+       * \param scale scale to apply to its vertices
+       * \param compact if should keep the mesh on compact mode
+       * \param lod level of detail to cache */
+      CachedMesh(const Ogre::String& meshName, const Ogre::Vector3& scale,
+            bool compact, Ogre::uint8 lod);
+      /*! Destructor */
+      ~CachedMesh();
+
+      /*! Request the read of the mesh vertices and indices from the GPU
+       * buffers, without waiting for them. 
+       * \note the data is only available after #finishLoad. */
+      void requestLoad(const Ogre::MeshPtr& mesh);
+
+      /*! Copy the data requested by #requestLoad, when available.
+       * \param wait if should wait for the transfers to end. Note that 
+       *        waiting 'locks' the GPU, killing performance.
+       * \return true if the data is ready, false if still transfering. */
+      bool finishLoad(bool wait);
+
+      /*! \return if all pending transfers are done */
+      bool isTransferDone();
+
+      /*! Quantize the vertices to #quantizedVertices, relative to their
+       * bounds.
+       * \param src vertices to quantize (#vertexCount) */
+      void quantize(const Ogre::Vector3* src);
+
+      /*! Replace the read full vertices and indices by its simplified 
+       * proxy (at #proxyLevel). */
+      void simplify();
+
+      /*! Define the disk cache file of this mesh.
+       * \param fileName full path of the file
+       * \param contentHash hash of the mesh contents (128 bits), to 
+       *        check if the file is still valid. */
+      void setCacheFile(const Ogre::String& fileName, 
+            const Ogre::uint64* contentHash);
+      /*! Load the mesh (and its BVH, if there) by mapping its cache file 
+       * to memory (see #setCacheFile).
+       * \return false if there's no valid cache file for the mesh. */
+      bool loadFromCacheFile();
+      /*! Save the mesh (and its BVH, if built) to its cache file, if
+       * defined. */
+      void saveToCacheFile();
+
+   private:
+      Ogre::String meshName;   /**< Name of the cached mesh */
+      Ogre::Vector3 scale;     /**< Scale applied to the vertices */
+      size_t vertexCount;      /**< Current vertex count */
+      Ogre::Vector3* vertices; /**< The cached vertices */
+      size_t indexCount;       /**< Current index count */
+      Ogre::uint32* indices;   /**< The cached indices */
+      bool compact;            /**< If on compact mode */
+      Ogre::uint8 lod;         /**< Level of detail */
+      /*! Levels simplified over the mesh coarsest level read (0 if the
+       * mesh has the #lod level) */
+      Ogre::uint8 proxyLevel;
+      /*! Quantized vertices (3 per vertex), on compact mode */
+      Ogre::uint16* quantizedVertices;
+      Ogre::Vector3 quantMin;  /**< Quantization origin (bounds minimum) */
+      Ogre::Vector3 quantStep; /**< Quantization step, by axis */
+      Ogre::uint16* indices16; /**< 16 bits indices, on compact mode */
+      MeshletList* meshlets;   /**< Meshlets of the cached mesh */
+      MeshBvh* bvh;            /**< BVH of the mesh, if built */
+      int references;          /**< Number of users of this mesh */
+      bool ready;              /**< If vertices and indices are read */
+
+      Ogre::String cacheFile;  /**< Disk cache file, if any */
+      Ogre::uint64 contentHash[2]; /**< Hash of the mesh contents */
+      /*! The mapped cache file, if loaded from it (thus vertices, 
+       * indices and bvh data are from it, instead of owned). */
+      MappedFile* mappedFile;
+
+      /*! A pending read of a submesh buffers */
+      class PendingRead
+      {
+         public:
+            /*! Constructor */
+            PendingRead() : vao(NULL), indices32(false), vertexOffset(0),
+               indexOffset(0) {};
+
+            Ogre::VertexArrayObject* vao; /**< Submesh's VAO */
+            /*! Position read request */
+            Ogre::VertexArrayObject::ReadRequestsArray requests;
+            Ogre::AsyncTicketPtr indexTicket; /**< Index read request */
+            bool indices32; /**< If the index buffer is 32 bits */
+            Ogre::uint32 vertexOffset; /**< First submesh vertex */
+            Ogre::uint32 indexOffset;  /**< First submesh index */
+      };
+      std::vector<PendingRead> pendingReads; /**< Pending reads */
+};
+
+/*! The process-wide cache of CachedMesh, keyed by mesh name and scale.
+ * Each cached mesh is reference counted, and deleted when its last
+ * user releases it.
+ * \note not thread safe: acquire and release from the main thread. */
+class MeshCache
+{
+   public:
+      /*! Get the CachedMesh of a mesh at a scale, reading it from the
+       * GPU buffers if not yet cached.
+       * \param mesh the mesh to get
+       * \param scale scale to apply to the mesh vertices.
+       * \param async if true, won't wait for the GPU transfers: the 
+       *        CachedMesh will only be ready (see CachedMesh::isReady) 
+       *        after a later #update call. If false, will wait for them
+       *        (even if the mesh was requested before asynchronously).
+       * \param compact if should get it on compact mode (see CachedMesh).
+       *        Compact and full versions of a mesh are cached apart.
+       * \param lod level of detail to get: 0 for full detail. If the mesh
+       *        has no such LOD level, a proxy is simplified from its 
+       *        coarsest one, halving the simplification grid (which starts
+       *        with MESH_CACHE_PROXY_GRID cells) on each missing level.
+       * \return pointer to the CachedMesh. Must be released with
+       *         #release when no more used. */
+      static CachedMesh* acquire(const Ogre::MeshPtr& mesh,
+            const Ogre::Vector3& scale, bool async=false, 
+            bool compact=false, Ogre::uint8 lod=0);
+
+      /*! Release a CachedMesh got with #acquire, deleting it if
+       * no more used.
+       * \param cachedMesh pointer to the cached mesh to release */
+      static void release(CachedMesh* cachedMesh);
+
+      /*! Finish the asynchronous reads whose transfers are done.
+       * \note called once per frame by BaseApp. */
+      static void update();
+
+      /*! Define the directory where to persist the cached meshes (as
+       * versioned binary files), to load them on next runs without any 
+       * GPU read (by mapping the file to memory). Files are keyed by 
+       * mesh name and scale, and checked against a hash of the mesh 
+       * file contents.
+       * \param dir directory to use. Empty to disable the disk cache.
+       * \note BaseApp sets it to Kobold::UserInfo::getCacheDirectory(). */
+      static void setDiskCacheDirectory(const Ogre::String& dir);
+      /*! \return current disk cache directory (empty if disabled) */
+      static const Ogre::String& getDiskCacheDirectory() 
+      { 
+         return diskCacheDirectory; 
+      };
+
+      /*! \return number of meshes still waiting for its GPU data */
+      static size_t getTotalPending() { return pending.size(); };
+
+      /*! \return number of meshes currently at the cache */
+      static size_t getTotalMeshes() { return meshes.size(); };
+
+   private:
+      /*! Key of the cached meshes */
+      class Key
+      {
+         public:
+            /*! Constructor */
+            Key(const Ogre::String& meshName, const Ogre::Vector3& scale,
+                bool compact, Ogre::uint8 lod)
+               : meshName(meshName), scale(scale), compact(compact), 
+                 lod(lod) {};
+
+            /*! Strict weak order, for std::map */
+            bool operator<(const Key& other) const;
+
+            Ogre::String meshName;
+            Ogre::Vector3 scale;
+            bool compact;
+            Ogre::uint8 lod;
+      };
+
+      /*! Calculate the hash of a mesh file contents.
+       * \return false if couldn't (like for manual meshes) */
+      static bool getContentHash(const Ogre::MeshPtr& mesh, 
+            Ogre::uint64* hash);
+      /*! \return the disk cache file name for a cached mesh */
+      static Ogre::String getCacheFileName(const Key& key);
+
+      typedef std::map<Key, CachedMesh*> CachedMeshMap;
+      static CachedMeshMap meshes; /**< All cached meshes */
+      static std::vector<CachedMesh*> pending; /**< Not yet ready ones */
+      static Ogre::String diskCacheDirectory; /**< Where to persist */
+};
+
+}
+
+#endif
+
+#endif
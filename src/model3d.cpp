@@ -19,22 +19,23 @@
 */
 
 #include "model3d.h"
+#include "sceneindex.h"
+#include "modelmanager.h"
 
 #include <OGRE/OgreSkeleton.h>
 #if OGRE_VERSION_MAJOR == 1
    #include <OGRE/OgreSkeletonInstance.h>
 #elif OGRE_VERSION_MAJOR > 2 || OGRE_VERSION_MINOR > 0
    #include <OGRE/Animation/OgreSkeletonInstance.h>
-   #include <OGRE/OgreSubMesh2.h>
-   #include <OGRE/OgreMesh2.h>
-   #include <OGRE/Vao/OgreAsyncTicket.h>
-   #include <OGRE/Vao/OgreIndexBufferPacked.h>
-   #include <OGRE/OgreBitwise.h>
+   #include "vertexutils.h"
+   #include "camera.h"
 #endif
 
 #include <kobold/log.h>
 
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
 
 using namespace Goblin;
 
@@ -53,14 +54,13 @@ Model3d::Model3d(const Ogre::String& modelName, const Ogre::String& modelFile,
 {
    model = NULL;
 #if(OGRE_VERSION_MAJOR > 2 || (OGRE_VERSION_MAJOR==2 && OGRE_VERSION_MINOR>0))
-   vertexCount = 0;
-   vertices = NULL;
-   indexCount = 0;
-   indices = NULL;
+   cachedMesh = NULL;
+   worldMesh = NULL;
+   meshletMaxVertices = 0;
+   meshletMaxTriangles = 0;
 #endif
-   dirtyPos = false;
-   dirtyOri = false;
-   dirtyScale = false;
+   sceneIndexNode = -1;
+   transform = ModelManager::add(this);
 
    load(modelName, modelFile, groupName, sceneManager, type, parent);
 }
@@ -73,11 +73,13 @@ Model3d::Model3d()
    visible = false;
    node = NULL;
    model = NULL;
+   sceneIndexNode = -1;
+   transform = ModelManager::add(this);
 #if(OGRE_VERSION_MAJOR > 2 || (OGRE_VERSION_MAJOR==2 && OGRE_VERSION_MINOR>0))
-   vertexCount = 0;
-   vertices = NULL;
-   indexCount = 0;
-   indices = NULL;
+   cachedMesh = NULL;
+   worldMesh = NULL;
+   meshletMaxVertices = 0;
+   meshletMaxTriangles = 0;
 #endif
 }
 
@@ -86,18 +88,21 @@ Model3d::Model3d()
  ***********************************************************************/
 Model3d::~Model3d()
 {
+   SceneIndex::remove(this);
+   ModelManager::remove(transform);
+
 #if(OGRE_VERSION_MAJOR > 2 || (OGRE_VERSION_MAJOR==2 && OGRE_VERSION_MINOR>0))
-   /* Remove our cached vertices and indices */
-   if(vertices)
+   /* Release our cached vertices and indices */
+   if(cachedMesh)
    {
-      delete[] vertices;
-      vertices = NULL;
+      MeshCache::release(cachedMesh);
+      cachedMesh = NULL;
    }
-   if(indices)
+   for(size_t i = 0; i < cachedLods.size(); i++)
    {
-      delete[] indices;
-      indices = NULL;
+      MeshCache::release(cachedLods[i]);
    }
+   cachedLods.clear();
 #endif
 
    /* Remove model and node */
@@ -192,6 +197,11 @@ bool Model3d::load(const Ogre::String& modelName,
 #endif
    }
    node->attachObject(model);
+   if(!isStatic())
+   {
+      ModelManager::setFlags(transform, ModelManager::FLAG_DYNAMIC);
+   }
+   updateSceneIndex();
 
    return true;
 }
@@ -205,6 +215,7 @@ void Model3d::notifyStaticDirty()
    assert(sceneType == Ogre::SCENE_STATIC);
    ogreSceneManager->notifyStaticDirty(node);
 #endif
+   updateSceneIndex();
 }
 
 /***********************************************************************
@@ -236,11 +247,13 @@ void Model3d::setMaterial(const Ogre::String& materialName)
 void Model3d::clearOrientation()
 {
    node->resetOrientation();
-   ori[0].setCurrent(0.0f);
-   ori[1].setCurrent(0.0f);
-   ori[2].setCurrent(0.0f);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_PITCH, 0.0f);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_YAW, 0.0f);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_ROLL, 0.0f);
 
-   dirtyOri = false;
+   clearTransformFlags(ModelManager::FLAG_DIRTY_ORIENTATION | 
+         ModelManager::FLAG_MOVED_ORIENTATION);
+   updateSceneIndex();
 }
 
 /***********************************************************************
@@ -257,16 +270,12 @@ void Model3d::setOrientation(Ogre::Real yawValue)
 void Model3d::setOrientation(Ogre::Real pitchValue, Ogre::Real yawValue, 
             Ogre::Real rollValue)
 {
-   /* Define Target and previous */
-   prevOri[0] = ori[0].getValue();
-   prevOri[1] = ori[1].getValue();
-   prevOri[2] = ori[2].getValue();
-   
-   ori[0].setCurrent(pitchValue);
-   ori[1].setCurrent(yawValue);
-   ori[2].setCurrent(rollValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_PITCH, 
+         pitchValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_YAW, yawValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_ROLL, rollValue);
 
-   dirtyOri = true;
+   ModelManager::setFlags(transform, ModelManager::FLAG_DIRTY_ORIENTATION);
 }
 
 /***********************************************************************
@@ -275,17 +284,18 @@ void Model3d::setOrientation(Ogre::Real pitchValue, Ogre::Real yawValue,
 void Model3d::setOrientationNow(Ogre::Real pitchValue, Ogre::Real yawValue, 
             Ogre::Real rollValue)
 {
-   /* Define scene node, based on previous */
-   node->pitch(Ogre::Radian(Ogre::Degree(pitchValue-ori[0].getValue())));
-   node->yaw(Ogre::Radian(Ogre::Degree(yawValue-ori[1].getValue())));
-   node->roll(Ogre::Radian(Ogre::Degree(rollValue-ori[2].getValue())));
-
    /* Define Target */
-   ori[0].setCurrent(pitchValue);
-   ori[1].setCurrent(yawValue);
-   ori[2].setCurrent(rollValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_PITCH, 
+         pitchValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_YAW, yawValue);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_ROLL, rollValue);
+
+   /* And the scene node */
+   node->setOrientation(getAngleOrientation());
 
-   dirtyOri = false;
+   clearTransformFlags(ModelManager::FLAG_DIRTY_ORIENTATION | 
+         ModelManager::FLAG_MOVED_ORIENTATION);
+   updateSceneIndex();
 }
 
 /***********************************************************************
@@ -317,12 +327,22 @@ void Model3d::setTargetOrientation(Ogre::Real pitchValue, Ogre::Real yawValue,
 #endif
 
    /* Define Target */
-   ori[0].setTarget(getNearestEquivalentAngle(ori[0].getValue(), pitchValue),
-         nSteps);
-   ori[1].setTarget(getNearestEquivalentAngle(ori[1].getValue(), yawValue),
-         nSteps);
-   ori[2].setTarget(getNearestEquivalentAngle(ori[2].getValue(), rollValue),
-         nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_PITCH,
+         getNearestEquivalentAngle(getPitch(), pitchValue), nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_YAW,
+         getNearestEquivalentAngle(getYaw(), yawValue), nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_ROLL,
+         getNearestEquivalentAngle(getRoll(), rollValue), nSteps);
+}
+
+/***********************************************************************
+ *                      setTargetOrientationByTime                     *
+ ***********************************************************************/
+void Model3d::setTargetOrientationByTime(Ogre::Real pitchValue, 
+      Ogre::Real yawValue, Ogre::Real rollValue, Ogre::Real seconds)
+{
+   setTargetOrientation(pitchValue, yawValue, rollValue, 
+         ModelManager::getSteps(seconds));
 }
 
 /***********************************************************************
@@ -331,11 +351,11 @@ void Model3d::setTargetOrientation(Ogre::Real pitchValue, Ogre::Real yawValue,
 void Model3d::setPosition(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ)
 {
    /* Set Target */
-   pos[0].setCurrent(pX);
-   pos[1].setCurrent(pY);
-   pos[2].setCurrent(pZ);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_X, pX);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_Y, pY);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_Z, pZ);
    
-   dirtyPos = true;
+   ModelManager::setFlags(transform, ModelManager::FLAG_DIRTY_POSITION);
 }
 
 /***********************************************************************
@@ -360,14 +380,16 @@ void Model3d::setPositionNow(const Ogre::Vector3& p)
 void Model3d::setPositionNow(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ)
 {
    /* Set Target */
-   pos[0].setCurrent(pX);
-   pos[1].setCurrent(pY);
-   pos[2].setCurrent(pZ);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_X, pX);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_Y, pY);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_POSITION_Z, pZ);
 
    /* Set node */
    node->setPosition(pX, pY, pZ);
 
-   dirtyPos = false;
+   clearTransformFlags(ModelManager::FLAG_DIRTY_POSITION | 
+         ModelManager::FLAG_MOVED_POSITION);
+   updateSceneIndex();
 }
 
 /***********************************************************************
@@ -375,9 +397,10 @@ void Model3d::setPositionNow(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ)
  ***********************************************************************/
 const Ogre::Vector3 Model3d::getPosition() const
 {
-   return Ogre::Vector3(pos[0].getValue(), 
-                        pos[1].getValue(), 
-                        pos[2].getValue());
+   return Ogre::Vector3(
+         ModelManager::getValue(transform, ModelManager::CHANNEL_POSITION_X),
+         ModelManager::getValue(transform, ModelManager::CHANNEL_POSITION_Y),
+         ModelManager::getValue(transform, ModelManager::CHANNEL_POSITION_Z));
 }
 
 /***********************************************************************
@@ -391,9 +414,21 @@ void Model3d::setTargetPosition(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ,
 #endif
 
    /* Set Target */
-   pos[0].setTarget(pX, nSteps);
-   pos[1].setTarget(pY, nSteps);
-   pos[2].setTarget(pZ, nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_POSITION_X, pX,
+         nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_POSITION_Y, pY,
+         nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_POSITION_Z, pZ,
+         nSteps);
+}
+
+/***********************************************************************
+ *                       setTargetPositionByTime                       *
+ ***********************************************************************/
+void Model3d::setTargetPositionByTime(Ogre::Real pX, Ogre::Real pY, 
+      Ogre::Real pZ, Ogre::Real seconds)
+{
+   setTargetPosition(pX, pY, pZ, ModelManager::getSteps(seconds));
 }
 
 /***********************************************************************
@@ -402,11 +437,11 @@ void Model3d::setTargetPosition(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ,
 void Model3d::setScale(Ogre::Real x, Ogre::Real y, Ogre::Real z)
 {
    /* Set Target */
-   scala[0].setCurrent(x);
-   scala[1].setCurrent(y);
-   scala[2].setCurrent(z);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_X, x);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_Y, y);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_Z, z);
 
-   dirtyScale = true;
+   ModelManager::setFlags(transform, ModelManager::FLAG_DIRTY_SCALE);
 }
 
 /***********************************************************************
@@ -415,14 +450,16 @@ void Model3d::setScale(Ogre::Real x, Ogre::Real y, Ogre::Real z)
 void Model3d::setScaleNow(Ogre::Real x, Ogre::Real y, Ogre::Real z)
 {
    /* Set Target */
-   scala[0].setCurrent(x);
-   scala[1].setCurrent(y);
-   scala[2].setCurrent(z);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_X, x);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_Y, y);
+   ModelManager::setCurrent(transform, ModelManager::CHANNEL_SCALE_Z, z);
 
    /* Set node */
    node->setScale(x, y, z);
 
-   dirtyScale = false;
+   clearTransformFlags(ModelManager::FLAG_DIRTY_SCALE | 
+         ModelManager::FLAG_MOVED_SCALE);
+   updateSceneIndex();
 }
 
 /***********************************************************************
@@ -430,9 +467,10 @@ void Model3d::setScaleNow(Ogre::Real x, Ogre::Real y, Ogre::Real z)
  ***********************************************************************/
 const Ogre::Vector3 Model3d::getScale() const
 {
-   return Ogre::Vector3(scala[0].getValue(), 
-                        scala[1].getValue(),
-                        scala[2].getValue());
+   return Ogre::Vector3(
+         ModelManager::getValue(transform, ModelManager::CHANNEL_SCALE_X),
+         ModelManager::getValue(transform, ModelManager::CHANNEL_SCALE_Y),
+         ModelManager::getValue(transform, ModelManager::CHANNEL_SCALE_Z));
 }
 
 /***********************************************************************
@@ -446,9 +484,21 @@ void Model3d::setTargetScale(Ogre::Real x, Ogre::Real y, Ogre::Real z,
 #endif
 
    /* Set Target */
-   scala[0].setTarget(x, nSteps);
-   scala[1].setTarget(y, nSteps);
-   scala[2].setTarget(z, nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_SCALE_X, x, 
+         nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_SCALE_Y, y, 
+         nSteps);
+   ModelManager::setTarget(transform, ModelManager::CHANNEL_SCALE_Z, z, 
+         nSteps);
+}
+
+/***********************************************************************
+ *                         setTargetScaleByTime                        *
+ ***********************************************************************/
+void Model3d::setTargetScaleByTime(Ogre::Real x, Ogre::Real y, Ogre::Real z,
+      Ogre::Real seconds)
+{
+   setTargetScale(x, y, z, ModelManager::getSteps(seconds));
 }
 
 /***********************************************************************
@@ -485,265 +535,540 @@ bool Model3d::update()
 #if OGRE_VERSION_MAJOR != 1
    assert(sceneType == Ogre::SCENE_DYNAMIC);
 #endif
-   bool updated = false;
+   ModelManager::step(transform);
+   return applyTransform();
+}
 
-   /* Update position */
-   if(dirtyPos)
+/***********************************************************************
+ *                              updateAll                              *
+ ***********************************************************************/
+size_t Model3d::updateAll(Ogre::SceneManager* sceneManager)
+{
+   return ModelManager::update(sceneManager);
+}
+
+/***********************************************************************
+ *                           applyTransform                            *
+ ***********************************************************************/
+bool Model3d::applyTransform()
+{
+   Ogre::uint8 flags = ModelManager::getFlags(transform);
+   if(!(flags & ModelManager::FLAGS_CHANGED))
    {
-      node->setPosition(pos[0].getValue(), pos[1].getValue(),
-            pos[2].getValue());
-      updated = true;
-      dirtyPos = false;
+      return false;
    }
-   else if( (pos[0].needUpdate()) || (pos[1].needUpdate()) || 
-            (pos[2].needUpdate()) )
+
+   /* Update position */
+   if(flags & (ModelManager::FLAG_DIRTY_POSITION | 
+               ModelManager::FLAG_MOVED_POSITION))
    {
-      pos[0].update();
-      pos[1].update();
-      pos[2].update();
-      node->setPosition(pos[0].getValue(),pos[1].getValue(),pos[2].getValue());
-      updated = true;
+      node->setPosition(getPosition());
    }
 
    /* Update scale */
-   if(dirtyScale)
+   if(flags & (ModelManager::FLAG_DIRTY_SCALE | 
+               ModelManager::FLAG_MOVED_SCALE))
    {
-      node->setScale(scala[0].getValue(), scala[1].getValue(),
-            scala[2].getValue());
-      updated = true;
-      dirtyScale = false;
+      node->setScale(getScale());
    }
-   else if( (scala[0].needUpdate()) || (scala[1].needUpdate()) || 
-            (scala[2].needUpdate()) )
+
+   /* Update node orientation */
+   if(flags & (ModelManager::FLAG_DIRTY_ORIENTATION |
+               ModelManager::FLAG_MOVED_ORIENTATION))
    {
-      scala[0].update();
-      scala[1].update();
-      scala[2].update();
-      node->setScale(scala[0].getValue(), scala[1].getValue(),
-            scala[2].getValue());
-      updated = true;
+      node->setOrientation(getAngleOrientation());
    }
 
-   /* Update node orientation */
-   if(dirtyOri)
+   clearTransformFlags(ModelManager::FLAGS_CHANGED);
+   updateSceneIndex();
+
+   return true;
+}
+
+/***********************************************************************
+ *                          applyInterpolation                         *
+ ***********************************************************************/
+void Model3d::applyInterpolation(Ogre::Real factor)
+{
+   node->setPosition(
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_POSITION_X, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_POSITION_Y, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_POSITION_Z, factor));
+   node->setOrientation(getAngleOrientation(
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_PITCH, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_YAW, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_ROLL, factor)));
+   node->setScale(
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_SCALE_X, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_SCALE_Y, factor),
+      ModelManager::getInterpolated(transform, 
+         ModelManager::CHANNEL_SCALE_Z, factor));
+}
+
+/***********************************************************************
+ *                        applyCurrentTransform                        *
+ ***********************************************************************/
+void Model3d::applyCurrentTransform()
+{
+   node->setPosition(getPosition());
+   node->setOrientation(getAngleOrientation());
+   node->setScale(getScale());
+}
+
+/***********************************************************************
+ *                         getAngleOrientation                         *
+ ***********************************************************************/
+Ogre::Quaternion Model3d::getAngleOrientation() const
+{
+   return getAngleOrientation(getPitch(), getYaw(), getRoll());
+}
+
+/***********************************************************************
+ *                         getAngleOrientation                         *
+ ***********************************************************************/
+Ogre::Quaternion Model3d::getAngleOrientation(Ogre::Real pitchValue,
+      Ogre::Real yawValue, Ogre::Real rollValue)
+{
+   /* Half angles of each axis rotation */
+   Ogre::Real hPitch = Ogre::Degree(pitchValue * 0.5f).valueRadians();
+   Ogre::Real hYaw = Ogre::Degree(yawValue * 0.5f).valueRadians();
+   Ogre::Real hRoll = Ogre::Degree(rollValue * 0.5f).valueRadians();
+   Ogre::Real sp = Ogre::Math::Sin(hPitch), cp = Ogre::Math::Cos(hPitch);
+   Ogre::Real sy = Ogre::Math::Sin(hYaw), cy = Ogre::Math::Cos(hYaw);
+   Ogre::Real sr = Ogre::Math::Sin(hRoll), cr = Ogre::Math::Cos(hRoll);
+
+   /* Pitch * Yaw (as both have a single axis, most terms are 0)... */
+   Ogre::Real w = cp * cy;
+   Ogre::Real x = sp * cy;
+   Ogre::Real y = cp * sy;
+   Ogre::Real z = sp * sy;
+
+   /* ... * Roll */
+   return Ogre::Quaternion(w * cr - z * sr, x * cr + y * sr, 
+         y * cr - x * sr, z * cr + w * sr);
+}
+
+/***********************************************************************
+ *                            getWorldBounds                           *
+ ***********************************************************************/
+Ogre::AxisAlignedBox Model3d::getWorldBounds()
+{
+#if OGRE_VERSION_MAJOR == 1
+   return model->getWorldBoundingBox(true);
+#else
+   Ogre::Aabb aabb = model->getWorldAabbUpdated();
+   Ogre::Vector3 min = aabb.getMinimum();
+   Ogre::Vector3 max = aabb.getMaximum();
+   if((min.x > max.x) || (min.y > max.y) || (min.z > max.z))
    {
-      node->pitch(Ogre::Radian(Ogre::Degree(ori[0].getValue() - prevOri[0])));
-      node->yaw(Ogre::Radian(Ogre::Degree(ori[1].getValue() - prevOri[1])));
-      node->roll(Ogre::Radian(Ogre::Degree(ori[2].getValue() - prevOri[2])));
-      updated = true;
-      dirtyOri = false;
+      /* Null box (ie: empty mesh) */
+      return Ogre::AxisAlignedBox();
    }
-   else
+   if((!std::isfinite(min.x)) || (!std::isfinite(min.y)) || 
+      (!std::isfinite(min.z)) || (!std::isfinite(max.x)) || 
+      (!std::isfinite(max.y)) || (!std::isfinite(max.z)))
    {
-      if(ori[0].needUpdate())
-      {
-         ori[0].update();
-         node->pitch(Ogre::Radian(Ogre::Degree(ori[0].getLastDelta())));
-         updated = true;
-      }
-      if(ori[1].needUpdate())
-      {
-         ori[1].update();
-         node->yaw(Ogre::Radian(Ogre::Degree(ori[1].getLastDelta())));
-         updated = true;
-      }
-      if(ori[2].needUpdate())
-      {
-         ori[2].update();
-         node->roll(Ogre::Radian(Ogre::Degree(ori[2].getLastDelta())));
-         updated = true;
-      }
+      return Ogre::AxisAlignedBox(Ogre::AxisAlignedBox::EXTENT_INFINITE);
    }
+   return Ogre::AxisAlignedBox(min, max);
+#endif
+}
 
-   return updated;
+/***********************************************************************
+ *                          updateSceneIndex                           *
+ ***********************************************************************/
+void Model3d::updateSceneIndex()
+{
+   if((model) && (SceneIndex::isEnabled()))
+   {
+      SceneIndex::update(this, getWorldBounds());
+   }
 }
 
 #if(OGRE_VERSION_MAJOR > 2 || (OGRE_VERSION_MAJOR==2 && OGRE_VERSION_MINOR>0))
 /***********************************************************************
  *                              getCachedMesh                          *
  ***********************************************************************/
-void Model3d::getCachedMesh(size_t &vertexCount, Ogre::Vector3* &vertices,
-      size_t &indexCount, Ogre::uint32* &indices)
+bool Model3d::getCachedMesh(size_t &vertexCount, 
+      const Ogre::Vector3* &vertices, size_t &indexCount, 
+      const Ogre::uint32* &indices)
 {
    /* Check if need to generate the cache */
-   if((this->vertices == NULL) || (this->indices == NULL))
+   validateCachedMesh();
+   
+   if(!cachedMesh->isReady())
    {
-      updateCachedMeshInformation();
+      /* Still waiting for the GPU */
+      vertexCount = 0;
+      vertices = NULL;
+      indexCount = 0;
+      indices = NULL;
+      return false;
    }
-   
+
    /* Set returns */
-   vertexCount = this->vertexCount;
-   vertices = this->vertices;
-   indexCount = this->indexCount;
-   indices = this->indices;
+   vertexCount = cachedMesh->getVertexCount();
+   vertices = cachedMesh->getVertices();
+   indexCount = cachedMesh->getIndexCount();
+   indices = cachedMesh->getIndices();
+
+   return true;
 }
 
 /***********************************************************************
- *                      updateCachedMeshInformation                    *
+ *                        updateWorldCachedMesh                        *
  ***********************************************************************/
-void Model3d::updateCachedMeshInformation()
+bool Model3d::updateWorldCachedMesh()
 {
-   /* Original Code - Code found on this forum link: 
-    * http://www.ogre3d.org/wiki/index.php/RetrieveVertexData
-    * Most Code courtesy of al2950( thanks m8 :)), but then edited by 
-    * Jayce Young & Hannah Young at Aurasoft UK (Skyline Game Engine) 
-    * to work with Items in the scene. MIT License. */
+   validateCachedMesh();
+   if(!cachedMesh->isReady())
+   {
+      return false;
+   }
+
+   const Ogre::Vector3& pos = node->_getDerivedPositionUpdated();
+   const Ogre::Quaternion& ori = node->_getDerivedOrientationUpdated();
+   if((worldMesh == cachedMesh) && (pos == worldPosition) && 
+      (ori == worldOrientation))
+   {
+      /* Nothing changed: still valid */
+      return true;
+   }
+
+   /* Transform it (compact ones decoded first, to transform in place) */
+   size_t vertexCount = cachedMesh->getVertexCount();
+   worldVertices.resize(vertexCount);
+   const Ogre::Vector3* src = cachedMesh->getVertices();
+   if((!src) && (vertexCount > 0))
+   {
+      for(size_t i = 0; i < vertexCount; i++)
+      {
+         worldVertices[i] = cachedMesh->getVertex(i);
+      }
+      src = &worldVertices[0];
+   }
+   if(vertexCount > 0)
+   {
+      Ogre::Vector3 vMin, vMax;
+      VertexUtils::transformPositions(src, &worldVertices[0], vertexCount,
+            ori, pos, vMin, vMax);
+      worldBounds.setExtents(vMin, vMax);
+   }
+   else
+   {
+      worldBounds.setNull();
+   }
 
-   Ogre::MeshPtr mesh = model->getMesh();
-   Ogre::Vector3 scale = node->getScale();
+   worldMesh = cachedMesh;
+   worldPosition = pos;
+   worldOrientation = ori;
 
-   /* First, we compute the total number of vertices and indices 
-    * and init the buffers. */
-   unsigned int numVertices = 0;
-   unsigned int numIndices = 0;
+   return true;
+}
 
-   Ogre::Mesh::SubMeshVec::const_iterator subMeshIterator = 
-      mesh->getSubMeshes().begin();
+/***********************************************************************
+ *                        getWorldCachedVertices                       *
+ ***********************************************************************/
+const Ogre::Vector3* Model3d::getWorldCachedVertices(size_t& vertexCount)
+{
+   if((!updateWorldCachedMesh()) || (worldVertices.empty()))
+   {
+      vertexCount = 0;
+      return NULL;
+   }
+   vertexCount = worldVertices.size();
+   return &worldVertices[0];
+}
 
-   while (subMeshIterator != mesh->getSubMeshes().end())
+/***********************************************************************
+ *                         getWorldCachedBounds                        *
+ ***********************************************************************/
+bool Model3d::getWorldCachedBounds(Ogre::AxisAlignedBox& bounds)
+{
+   if(!updateWorldCachedMesh())
    {
-      Ogre::SubMesh *subMesh = *subMeshIterator;
+      return false;
+   }
+   bounds = worldBounds;
+   return true;
+}
 
-      numVertices += 
-         subMesh->mVao[0][0]->getVertexBuffers()[0]->getNumElements();
-      numIndices += 
-         subMesh->mVao[0][0]->getIndexBuffer()->getNumElements();
+/***********************************************************************
+ *                             getCachedMesh                           *
+ ***********************************************************************/
+const CachedMesh* Model3d::getCachedMesh(Ogre::uint8 lod) const
+{
+   return getCollisionMesh(lod);
+}
 
-      subMeshIterator++;
+/***********************************************************************
+ *                          getCollisionMesh                           *
+ ***********************************************************************/
+CachedMesh* Model3d::getCollisionMesh(Ogre::uint8 lod) const
+{
+   /* Nearest finer ready level */
+   for(size_t l = std::min((size_t) lod, cachedLods.size()); l > 0; l--)
+   {
+      if((cachedLods[l - 1]) && (cachedLods[l - 1]->isReady()))
+      {
+         return cachedLods[l - 1];
+      }
    }
-  
-   /* Alloc (or realloc) buffers */
-   if(vertices)
+   return cachedMesh;
+}
+
+/***********************************************************************
+ *                           getCollisionBvh                           *
+ ***********************************************************************/
+const MeshBvh* Model3d::getCollisionBvh(Ogre::uint8 lod)
+{
+   validateCachedMesh();
+   return getCollisionMesh(lod)->getBvh();
+}
+
+/***********************************************************************
+ *                          validateCachedMesh                         *
+ ***********************************************************************/
+void Model3d::validateCachedMesh()
+{
+   if(cachedMesh == NULL)
    {
-      delete[] vertices;
-      vertices = NULL;
+      updateCachedMeshInformation();
    }
-   vertices = new Ogre::Vector3[numVertices];
-   if(indices)
+   else if(cachedMesh->getScale() != node->_getDerivedScaleUpdated())
    {
-      delete[] indices;
-      indices = NULL;
+      /* Scaled since cached: its vertices (and BVH) are at the old one */
+      updateCachedMeshInformation(cachedMesh->isCompact());
+      if((meshletMaxVertices > 0) && (cachedMesh->isReady()) &&
+         (!cachedMesh->getMeshlets()))
+      {
+         cachedMesh->buildMeshlets(meshletMaxVertices, meshletMaxTriangles);
+      }
+   }
+}
+
+/***********************************************************************
+ *                          cacheCollisionLod                          *
+ ***********************************************************************/
+void Model3d::cacheCollisionLod(Ogre::uint8 lod, bool compact, bool async)
+{
+   if(lod == 0)
+   {
+      return;
+   }
+   if(cachedLods.size() < lod)
+   {
+      cachedLods.resize(lod, NULL);
+   }
+   CachedMesh* prev = cachedLods[lod - 1];
+   cachedLods[lod - 1] = MeshCache::acquire(model->getMesh(), 
+         node->_getDerivedScaleUpdated(), async, compact, lod);
+   MeshCache::release(prev);
+}
+
+/***********************************************************************
+ *                             rayIntersect                            *
+ ***********************************************************************/
+bool Model3d::rayIntersect(const Ogre::Ray& ray, MeshRayHit& hit, 
+      Ogre::uint8 lod)
+{
+   const MeshBvh* bvh = getCollisionBvh(lod);
+   if(!bvh)
+   {
+      return false;
+   }
+
+   /* Bring the ray to model space (cached vertices are already scaled, so
+    * just the inverse node rotation and translation, keeping distances) */
+   Ogre::Quaternion invOri = node->_getDerivedOrientationUpdated().Inverse();
+   Ogre::Ray localRay(invOri * (ray.getOrigin() - 
+            node->_getDerivedPositionUpdated()), 
+         invOri * ray.getDirection());
+
+   return bvh->rayIntersect(localRay, hit);
+}
+
+/***********************************************************************
+ *                             rayIntersect                            *
+ ***********************************************************************/
+size_t Model3d::rayIntersect(const Ogre::Ray* rays, size_t count, 
+      MeshRayHit* hits, Ogre::uint8 lod)
+{
+   const MeshBvh* bvh = getCollisionBvh(lod);
+   if(!bvh)
+   {
+      for(size_t i = 0; i < count; i++)
+      {
+         hits[i] = MeshRayHit();
+      }
+      return 0;
+   }
+
+   /* Bring the rays to model space */
+   Ogre::Quaternion invOri = node->_getDerivedOrientationUpdated().Inverse();
+   Ogre::Vector3 nodePos = node->_getDerivedPositionUpdated();
+   std::vector<Ogre::Ray> localRays(count);
+   for(size_t i = 0; i < count; i++)
+   {
+      localRays[i].setOrigin(invOri * (rays[i].getOrigin() - nodePos));
+      localRays[i].setDirection(invOri * rays[i].getDirection());
+   }
+
+   return (count > 0) ? bvh->rayIntersect(&localRays[0], count, hits) : 0;
+}
+
+/***********************************************************************
+ *                         getRelativeTransform                        *
+ ***********************************************************************/
+void Model3d::getRelativeTransform(Model3d& other, 
+      Ogre::Quaternion& orientation, Ogre::Vector3& position)
+{
+   /* From other model space to ours (as on rayIntersect, cached vertices 
+    * are already scaled, so just rotation and translation) */
+   Ogre::Quaternion invOri = node->_getDerivedOrientationUpdated().Inverse();
+   orientation = invOri * other.node->_getDerivedOrientationUpdated();
+   position = invOri * (other.node->_getDerivedPositionUpdated() - 
+         node->_getDerivedPositionUpdated());
+}
+
+/***********************************************************************
+ *                              intersects                             *
+ ***********************************************************************/
+bool Model3d::intersects(Model3d& other, Ogre::uint8 lod)
+{
+   const MeshBvh* bvh = getCollisionBvh(lod);
+   const MeshBvh* otherBvh = other.getCollisionBvh(lod);
+   if((!bvh) || (!otherBvh))
+   {
+      return false;
+   }
+
+   Ogre::Quaternion relOri;
+   Ogre::Vector3 relPos;
+   getRelativeTransform(other, relOri, relPos);
+
+   return MeshBvh::intersects(*bvh, *otherBvh, relOri, relPos);
+}
+
+/***********************************************************************
+ *                             getContacts                             *
+ ***********************************************************************/
+size_t Model3d::getContacts(Model3d& other, 
+      std::vector<MeshContact>& contacts, size_t maxContacts, 
+      Ogre::uint8 lod)
+{
+   const MeshBvh* bvh = getCollisionBvh(lod);
+   const MeshBvh* otherBvh = other.getCollisionBvh(lod);
+   if((!bvh) || (!otherBvh))
+   {
+      return 0;
    }
-   indices = new Ogre::uint32[numIndices];
 
-   vertexCount = numVertices;
-   indexCount = numIndices;
+   Ogre::Quaternion relOri;
+   Ogre::Vector3 relPos;
+   getRelativeTransform(other, relOri, relPos);
 
-   unsigned int addedIndices = 0;
+   return MeshBvh::getContacts(*bvh, *otherBvh, relOri, relPos, contacts,
+         maxContacts);
+}
 
-   unsigned int index_offset = 0;
-   unsigned int subMeshOffset = 0;
+/***********************************************************************
+ *                            buildMeshlets                            *
+ ***********************************************************************/
+bool Model3d::buildMeshlets(Ogre::uint32 maxVertices, 
+      Ogre::uint32 maxTriangles)
+{
+   validateCachedMesh();
+   if(!cachedMesh->isReady())
+   {
+      return false;
+   }
+   cachedMesh->buildMeshlets(maxVertices, maxTriangles);
+   meshletMaxVertices = maxVertices;
+   meshletMaxTriangles = maxTriangles;
 
-   /* Read each submesh */
-   subMeshIterator = mesh->getSubMeshes().begin();
-   while (subMeshIterator != mesh->getSubMeshes().end())
+   return true;
+}
+
+/***********************************************************************
+ *                          getVisibleMeshlets                         *
+ ***********************************************************************/
+size_t Model3d::getVisibleMeshlets(std::vector<Ogre::uint32>& visible)
+{
+   visible.clear();
+   if(cachedMesh)
+   {
+      validateCachedMesh();
+   }
+   const MeshletList* meshlets = getMeshlets();
+   if(!meshlets)
    {
-      Ogre::SubMesh *subMesh = *subMeshIterator;
-      Ogre::VertexArrayObjectArray vaos = subMesh->mVao[0];
+      return 0;
+   }
 
-      if (!vaos.empty())
+   /* Note: cached vertices are already scaled, so model space is just 
+    * the node rotation and translation. */
+   const Ogre::Vector3 nodePos = node->_getDerivedPositionUpdated();
+   const Ogre::Quaternion nodeOri = node->_getDerivedOrientationUpdated();
+   Ogre::Vector3 viewPos = nodeOri.Inverse() * 
+      (Camera::getOgreCamera()->getDerivedPosition() - nodePos);
+
+   for(size_t i = 0; i < meshlets->meshlets.size(); i++)
+   {
+      const Meshlet& m = meshlets->meshlets[i];
+      if((!m.isBackFacing(viewPos)) &&
+         (Camera::isVisible(Ogre::Sphere(nodePos + nodeOri * m.center, 
+                                         m.radius))))
       {
-         /* Get the first LOD level */
-         Ogre::VertexArrayObject *vao = vaos[0];
-         bool indices32 = (vao->getIndexBuffer()->getIndexType() == 
-               Ogre::IndexBufferPacked::IT_32BIT);
-
-         const Ogre::VertexBufferPackedVec &vertexBuffers = 
-            vao->getVertexBuffers();
-         Ogre::IndexBufferPacked *indexBuffer = vao->getIndexBuffer();
-
-         /* request async read from buffer */
-         Ogre::VertexArrayObject::ReadRequestsArray requests;
-         requests.push_back(Ogre::VertexArrayObject::ReadRequests(
-                  Ogre::VES_POSITION));
-
-         vao->readRequests(requests);
-         vao->mapAsyncTickets(requests);
-         unsigned int subMeshVerticiesNum = 
-            requests[0].vertexBuffer->getNumElements();
-
-         if (requests[0].type == Ogre::VET_HALF4)
-         {
-            for (size_t i = 0; i < subMeshVerticiesNum; ++i)
-            {
-               const Ogre::uint16* pos = 
-                  reinterpret_cast<const Ogre::uint16*>(requests[0].data);
-               Ogre::Vector3 vec;
-               vec.x = Ogre::Bitwise::halfToFloat(pos[0]);
-               vec.y = Ogre::Bitwise::halfToFloat(pos[1]);
-               vec.z = Ogre::Bitwise::halfToFloat(pos[2]);
-               requests[0].data += 
-                  requests[0].vertexBuffer->getBytesPerElement();
-               //vertices[i + subMeshOffset] = 
-               //      (orient * (vec * scale)) + position;
-               vertices[i + subMeshOffset] = (vec * scale);
-            }
-         }
-         else if (requests[0].type == Ogre::VET_FLOAT3)
-         {
-            for (size_t i = 0; i < subMeshVerticiesNum; ++i)
-            {
-               const float* pos = reinterpret_cast<const float*>(
-                     requests[0].data);
-               Ogre::Vector3 vec;
-               vec.x = *pos++;
-               vec.y = *pos++;
-               vec.z = *pos++;
-               requests[0].data += 
-                  requests[0].vertexBuffer->getBytesPerElement();
-               //vertices[i + subMeshOffset] = 
-               //   (orient * (vec * scale)) + position;
-               vertices[i + subMeshOffset] = (vec * scale);
-            }
-         }
-         else
-         {
-            Kobold::Log::add(Kobold::LOG_LEVEL_ERROR, 
-                  "Error: Vertex Buffer type not recognised!");
-         }
-         subMeshOffset += subMeshVerticiesNum;
-         vao->unmapAsyncTickets(requests);
+         visible.push_back((Ogre::uint32)i);
+      }
+   }
 
-         /* Read index data */
-         if (indexBuffer)
-         {
-            Ogre::AsyncTicketPtr asyncTicket = indexBuffer->readRequest(
-                  0, indexBuffer->getNumElements());
-
-            unsigned int *pIndices = 0;
-            if (indices32)
-            {
-               pIndices = (unsigned*)(asyncTicket->map());
-            }
-            else
-            {
-               unsigned short *pShortIndices = (unsigned short*)(
-                     asyncTicket->map());
-               pIndices = new unsigned int[indexBuffer->getNumElements()];
-               for (size_t k = 0; k < indexBuffer->getNumElements(); k++)
-               {
-                  pIndices[k] = static_cast<unsigned int>(pShortIndices[k]);
-               }
-            }
-            unsigned int bufferIndex = 0;
-
-            for (size_t i = addedIndices; 
-                  i < addedIndices + indexBuffer->getNumElements(); i++)
-            {
-               indices[i] = pIndices[bufferIndex] + index_offset;
-               bufferIndex++;
-            }
-            addedIndices += indexBuffer->getNumElements();
-
-            if (!indices32) delete[] pIndices;
-
-            asyncTicket->unmap();
-         }
-         index_offset += vertexBuffers[0]->getNumElements();
+   return visible.size();
+}
+
+/***********************************************************************
+ *                      updateCachedMeshInformation                    *
+ ***********************************************************************/
+void Model3d::updateCachedMeshInformation(bool compact)
+{
+   /* Get the current one (note: acquiring before releasing, to avoid
+    * reading it again from the GPU if it's the same) */
+   CachedMesh* prev = cachedMesh;
+   cachedMesh = MeshCache::acquire(model->getMesh(), 
+         node->_getDerivedScaleUpdated(), false, compact);
+   MeshCache::release(prev);
+   worldMesh = NULL;
+
+   /* And the coarser levels, to keep them at the same scale */
+   for(size_t l = 0; l < cachedLods.size(); l++)
+   {
+      if(cachedLods[l])
+      {
+         cacheCollisionLod(l + 1, cachedLods[l]->isCompact());
       }
-      subMeshIterator++;
    }
 }
+
+/***********************************************************************
+ *                     requestCachedMeshInformation                    *
+ ***********************************************************************/
+void Model3d::requestCachedMeshInformation(bool compact)
+{
+   CachedMesh* prev = cachedMesh;
+   cachedMesh = MeshCache::acquire(model->getMesh(), 
+         node->_getDerivedScaleUpdated(), true, compact);
+   MeshCache::release(prev);
+   worldMesh = NULL;
+}
 #endif
 
 ///////////////////////////////////////////////////////////////////////////
@@ -760,6 +1085,9 @@ AnimatedModel3d::AnimationInfo::AnimationInfo()
    animation = NULL;
    fadingIn = false;
    fadingOut = false;
+   weight = 1.0f;
+   weightChanged = false;
+   disable = false;
 }
 
 /***********************************************************************
@@ -780,6 +1108,7 @@ void AnimatedModel3d::AnimationInfo::setAnimation(
    assert(animation != NULL);
    this->animation = animation;
    this->animation->setEnabled(false);
+   this->weight = animation->getWeight();
 }
 
 /***********************************************************************
@@ -799,6 +1128,7 @@ void AnimatedModel3d::AnimationInfo::setAnimation(
    assert(animation != NULL);
    this->animation = animation;
    this->animation->setEnabled(false);
+   this->weight = animation->mWeight;
 }
 
 /***********************************************************************
@@ -861,12 +1191,7 @@ bool AnimatedModel3d::AnimationInfo::isElapsed(Ogre::Real curTimer)
  ***********************************************************************/
 Ogre::Real AnimatedModel3d::AnimationInfo::getWeight()
 {
-#if OGRE_VERSION_MAJOR == 1 || \
-    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR == 0)
-   return animation->getWeight();
-#else
-   return animation->mWeight;
-#endif
+   return weight;
 }
 
 /***********************************************************************
@@ -874,12 +1199,38 @@ Ogre::Real AnimatedModel3d::AnimationInfo::getWeight()
  ***********************************************************************/
 void AnimatedModel3d::AnimationInfo::setWeight(Ogre::Real weight)
 {
+   this->weight = weight;
+   weightChanged = true;
+}
+
+/***********************************************************************
+ *                             setDisable                              *
+ ***********************************************************************/
+void AnimatedModel3d::AnimationInfo::setDisable()
+{
+   disable = true;
+}
+
+/***********************************************************************
+ *                               commit                                *
+ ***********************************************************************/
+void AnimatedModel3d::AnimationInfo::commit()
+{
+   if(weightChanged)
+   {
 #if OGRE_VERSION_MAJOR == 1 || \
     (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR == 0)
-   animation->setWeight(weight);
+      animation->setWeight(weight);
 #else
-   animation->mWeight = weight;
+      animation->mWeight = weight;
 #endif
+      weightChanged = false;
+   }
+   if(disable)
+   {
+      animation->setEnabled(false);
+      disable = false;
+   }
 }
 
 /***********************************************************************
@@ -924,9 +1275,11 @@ AnimatedModel3d::AnimatedModel3d(const Ogre::String& modelName,
    this->baseAnimationIndex = -1;
    this->looping = false;
    this->animationSet = false;
+   this->animationFinished = false;
    this->previousAnimationIndex = -1;
    this->timer = 0;
    this->totalFadings = 0;
+   ModelManager::setFlags(transform, ModelManager::FLAG_ANIMATED);
 
 #if OGRE_VERSION_MAJOR == 1
    /* Define animation blend */
@@ -960,16 +1313,57 @@ AnimatedModel3d::~AnimatedModel3d()
 bool AnimatedModel3d::update()
 {
    bool res = Model3d::update();
+   updateAnimations();
+
+   return res;
+}
+
+/***********************************************************************
+ *                           updateAnimations                          *
+ ***********************************************************************/
+void AnimatedModel3d::updateAnimations()
+{
+   prepareAnimations();
+   commitAnimations();
+}
+
+/***********************************************************************
+ *                          prepareAnimations                          *
+ ***********************************************************************/
+void AnimatedModel3d::prepareAnimations()
+{
    animationSet = false;
 
    timer += ANIM_UPDATE_RATE;
 
    /* Check finish non-looping animations */
-   if((!looping) && (baseAnimation) && (baseAnimation->isElapsed(timer))) 
+   animationFinished = (!looping) && (baseAnimation) && 
+                       (baseAnimation->isElapsed(timer));
+
+   /* When finished, the fadings will change by the new base animation,
+    * thus only done at commit. */
+   assert(totalFadings >= 0);
+   if((!animationFinished) && (totalFadings > 0))
+   {
+      doFadeInAndFadeOut();
+   }
+}
+
+/***********************************************************************
+ *                           commitAnimations                          *
+ ***********************************************************************/
+void AnimatedModel3d::commitAnimations()
+{
+   if(animationFinished)
    {
       /* A non looping animation just finished, let's reset to previous
        * looping one. */
+      animationFinished = false;
       setBaseAnimation(previousAnimationIndex, true); 
+      if(totalFadings > 0)
+      {
+         doFadeInAndFadeOut();
+      }
    }
 
    /* Update base animation time */
@@ -978,13 +1372,11 @@ bool AnimatedModel3d::update()
       baseAnimation->getAnimation()->addTime(ANIM_UPDATE_RATE);
    }
 
-   assert(totalFadings >= 0);
-   if(totalFadings > 0)
+   /* Apply the new weights */
+   for(int i = 0; i < totalAnimations; i++)
    {
-      doFadeInAndFadeOut();
+      animations[i].commit();
    }
-
-   return res;
 }
 
 /***********************************************************************
@@ -1023,7 +1415,7 @@ void AnimatedModel3d::doFadeInAndFadeOut()
          if (newWeight <= 0)
          {
             /* Done fading out */
-            animations[i].getAnimation()->setEnabled(false);
+            animations[i].setDisable();
             animations[i].setFadingOut(false);
             totalFadings--;
          }
@@ -1093,10 +1485,12 @@ void AnimatedModel3d::setBaseAnimation(int index, bool loop, bool reset)
    {
       baseAnimation = &animations[index]; 
 
-      /* Enable it */
+      /* Enable it (applying its weight before, to not render it with
+       * the one it had) */
+      baseAnimation->setWeight(0.0f);
+      baseAnimation->commit();
       baseAnimation->getAnimation()->setEnabled(true);
       baseAnimation->getAnimation()->setLoop(loop);
-      baseAnimation->setWeight(0.0f);
 
       /* Check fade-in and fade-out (and its totals) */
       if(baseAnimation->isFadingOut())
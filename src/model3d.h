@@ -29,13 +29,19 @@
 #else
    #include <OGRE/OgreItem.h>
    #include <OGRE/Animation/OgreSkeletonAnimation.h>
+   #include "meshcache.h"
+   #include "meshbvh.h"
 #endif
 #include <OGRE/OgreSceneNode.h>
 #include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreAxisAlignedBox.h>
 
 #include <kobold/target.h>
 
 #include "goblinconfig.h"
+#include "modelmanager.h"
+
+#include <vector>
 
 namespace Goblin
 {
@@ -43,6 +49,9 @@ namespace Goblin
 /*! A 3d model abstraction */
 class Model3d
 {
+   friend class SceneIndex;
+   friend class ModelManager;
+
    public:
 
       enum Model3dType
@@ -87,29 +96,57 @@ class Model3d
        * \param yawValue new value for Y orientation.
        * \note this function won't change pitch and roll */
       void setOrientation(Ogre::Real yawValue);
-      /*! Set current orientation */
+      /*! Set current orientation.
+       * \note the node orientation is always the one composed from the
+       *       pitch, yaw and roll angles (on this order, see 
+       *       #getAngleOrientation), replacing any other set directly to
+       *       the scene node. */
       void setOrientation(Ogre::Real pitchValue, Ogre::Real yawValue, 
             Ogre::Real rollValue);
       /*! Set next orientation. 
        * \note Will rotate at the nearest equivalent angles. */
       void setTargetOrientation(Ogre::Real pitchValue, Ogre::Real yawValue, 
             Ogre::Real rollValue, int nSteps = TARGET_DEFAULT_STEPS);
+      /*! Set next orientation, to reach it in some time (see 
+       * ModelManager::getSteps) */
+      void setTargetOrientationByTime(Ogre::Real pitchValue, 
+            Ogre::Real yawValue, Ogre::Real rollValue, Ogre::Real seconds);
  
       /*! Clear current model orientation, reseting its angles to 0.  */
       void clearOrientation();
 
       /*! \return current model's pitch (X) angle */
-      const Ogre::Real getPitch() const { return ori[0].getValue(); };
+      const Ogre::Real getPitch() const 
+      { 
+         return ModelManager::getValue(transform, 
+               ModelManager::CHANNEL_PITCH); 
+      };
       /*! \return current model's yaw (Y) angle */
-      const Ogre::Real getYaw() const { return ori[1].getValue(); };
+      const Ogre::Real getYaw() const 
+      { 
+         return ModelManager::getValue(transform, ModelManager::CHANNEL_YAW);
+      };
       /*! Same as #getYaw()  */
       const Ogre::Real getOrientation() const { return getYaw(); };
       /*! \return current model's roll (Z) angle */
-      const Ogre::Real getRoll() const { return ori[2].getValue(); };
+      const Ogre::Real getRoll() const 
+      { 
+         return ModelManager::getValue(transform, ModelManager::CHANNEL_ROLL);
+      };
+      /*! \return orientation composed from the current pitch, yaw and roll
+       *          angles (the one set to the scene node). */
+      Ogre::Quaternion getAngleOrientation() const;
+      /*! \return orientation composed from pitch, yaw and roll angles */
+      static Ogre::Quaternion getAngleOrientation(Ogre::Real pitchValue,
+            Ogre::Real yawValue, Ogre::Real rollValue);
 
       /* Set model's next position */
       void setTargetPosition(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ,
             int nSteps = TARGET_DEFAULT_STEPS);
+      /*! Set model's next position, to reach it in some time (see 
+       * ModelManager::getSteps) */
+      void setTargetPositionByTime(Ogre::Real pX, Ogre::Real pY, 
+            Ogre::Real pZ, Ogre::Real seconds);
       /*! Set model's position */
       void setPosition(Ogre::Real pX, Ogre::Real pY, Ogre::Real pZ);
       void setPosition(const Ogre::Vector3& p);
@@ -122,6 +159,10 @@ class Model3d
       /*! Set next model scale */
       void setTargetScale(Ogre::Real x, Ogre::Real y, Ogre::Real z,
             int nSteps = TARGET_DEFAULT_STEPS);
+      /*! Set next model scale, to reach it in some time (see 
+       * ModelManager::getSteps) */
+      void setTargetScaleByTime(Ogre::Real x, Ogre::Real y, Ogre::Real z,
+            Ogre::Real seconds);
 
       /*! \return current model scale */
       const Ogre::Vector3 getScale() const;
@@ -144,10 +185,20 @@ class Model3d
 
       /*! Update model's position, scale or orientation, according to its
        * defined targets.
+       * \note for a lot of models, prefer a single #updateAll call per
+       *       frame instead.
        * \return true if any of these elements are updated, false if no
        *         update was needed. */
       virtual bool update();
 
+      /*! Update all active models (the ones with targets to reach, set 
+       * transforms or animations), as ModelManager::update. Idle models
+       * aren't touched, thus its cost is of the active ones.
+       * \note don't call #update for the models too.
+       * \param sceneManager whose worker threads to use (if any).
+       * \return number of models whose nodes were changed */
+      static size_t updateAll(Ogre::SceneManager* sceneManager=NULL);
+
       /*! hide model */
       void hide();
       /*! show model */
@@ -167,6 +218,10 @@ class Model3d
       /*! \return scene node used by the model */
       Ogre::SceneNode* getSceneNode() { return node; };
 
+      /*! \return current model bounds, in world space (from its mesh
+       *          bounds and node transform) */
+      Ogre::AxisAlignedBox getWorldBounds();
+
 #if OGRE_VERSION_MAJOR == 1 || \
     (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR == 0)
       /*! \return model's Ogre::Entity pointer */
@@ -176,15 +231,138 @@ class Model3d
       Ogre::Item* getItem() { return model; };
 
       /*! Update cached mesh information. This info should be used
-       * when doing mesh collision detection.
+       * when doing mesh collision detection. 
+       * The information is shared (see MeshCache) with all other models 
+       * of the same mesh and scale, thus only read from the GPU when no 
+       * other model has it cached.
        * \note: avoid calling it too often, as it is an expensive
        *        call and should 'lock' the GPU, killing performance.
-       *        Ideally, one should only call this function once per model. */
-      void updateCachedMeshInformation();
+       *        Ideally, one should only call this function once per model.
+       *        Queries call it again when the node (derived) scale 
+       *        changed, so avoid changing often the scale of models used
+       *        on them.
+       * \param compact if should cache it on compact mode (quantized
+       *        positions and 16 bits indices, see CachedMesh), for less 
+       *        memory on collision-only uses.
+       * \see #requestCachedMeshInformation for a non-blocking version */
+      void updateCachedMeshInformation(bool compact=false);
+      /*! Same as #updateCachedMeshInformation, but without waiting for
+       * the GPU: the read is only requested, and finished on a later 
+       * frame (at MeshCache::update), when its transfers are done. Use 
+       * #getCachedMesh to know when it's available. */
+      void requestCachedMeshInformation(bool compact=false);
       /*! Get the cached mesh buffers. If no cache mesh is at the buffers, 
-       * will call #updateCachedMeshInformation to generate them. */
-      void getCachedMesh(size_t &vertexCount, Ogre::Vector3* &vertices,
-            size_t &indexCount, Ogre::uint32* &indices);
+       * will call #updateCachedMeshInformation to generate them. 
+       * \note on compact mode, vertices and (usually) indices are NULL:
+       *       decode them with #getCachedMesh()->getVertex and getIndex.
+       * \note the buffers are shared by all models of the same mesh (and
+       *       could be a read-only file mapping), thus constant. Copy 
+       *       them to change (or see #getWorldCachedVertices).
+       * \return true if got them, false if its asynchronous read (see 
+       *         #requestCachedMeshInformation) isn't yet done (with
+       *         counts set to 0 and buffers to NULL). */
+      bool getCachedMesh(size_t &vertexCount, 
+            const Ogre::Vector3* &vertices, size_t &indexCount, 
+            const Ogre::uint32* &indices);
+      /*! Get the cached mesh vertices in world space (with the current 
+       * node position and orientation). They are kept by the model, and
+       * only transformed again (with a vectorized transform) when its 
+       * node transform changed since the last call. Its indices are the
+       * same of the cached mesh (see #getCachedMesh). Will cache the mesh
+       * if not yet done.
+       * \param vertexCount receive the number of vertices
+       * \return pointer to the world space vertices, or NULL if the 
+       *         cached mesh isn't yet available. */
+      const Ogre::Vector3* getWorldCachedVertices(size_t& vertexCount);
+      /*! Get the world space bounds of the cached mesh (tight, from its 
+       * world space vertices, see #getWorldCachedVertices).
+       * \param bounds receive the world bounds
+       * \return false if the cached mesh isn't yet available. */
+      bool getWorldCachedBounds(Ogre::AxisAlignedBox& bounds);
+
+      /*! \return the cached mesh used by queries at a level of detail 
+       *          (see #cacheCollisionLod), or NULL if not cached. */
+      const CachedMesh* getCachedMesh(Ogre::uint8 lod=0) const;
+
+      /*! Also cache a coarser level of detail of the model mesh (shared 
+       * as the full one, see MeshCache::acquire), for cheaper queries 
+       * when far away (like broadphase checks or distant AI probes). 
+       * \param lod level of detail to cache (> 0). From the mesh own LOD
+       *        levels or, if it hasn't them, from an auto simplified proxy.
+       * \param compact if should cache it on compact mode
+       * \param async if shouldn't wait for the GPU transfers (see 
+       *        #requestCachedMeshInformation). */
+      void cacheCollisionLod(Ogre::uint8 lod, bool compact=false, 
+            bool async=false);
+
+      /*! Get the nearest model triangle hit by a ray, using the BVH of 
+       * its cached mesh (built on first call, and shared with all models
+       * of the same cached mesh). Will cache the mesh if not yet done.
+       * \param ray the ray to test, in world space
+       * \param hit receive the nearest hit (with triangle index at the
+       *        cached mesh, distance from the ray origin and barycentric
+       *        coordinates).
+       * \param lod level of detail to query. If not cached (with 
+       *        #cacheCollisionLod) or not yet ready, the nearest finer 
+       *        ready one is used. Note that the hit triangle is from the
+       *        used level (see #getCachedMesh).
+       * \return true if hit the model, false if not or if the cached
+       *         mesh isn't yet available. */
+      bool rayIntersect(const Ogre::Ray& ray, MeshRayHit& hit, 
+            Ogre::uint8 lod=0);
+      /*! Batched version of #rayIntersect, to test a lot of rays at once
+       * (see MeshBvh::rayIntersect for details).
+       * \param rays array with the rays to test, in world space
+       * \param count number of rays
+       * \param hits array to receive the nearest hit of each ray, with
+       *        MeshRayHit::NO_TRIANGLE for the ones that didn't hit.
+       * \param lod level of detail to query (as on the single ray one)
+       * \return number of rays that hit the model (0 if the cached mesh
+       *         isn't yet available). */
+      size_t rayIntersect(const Ogre::Ray* rays, size_t count, 
+            MeshRayHit* hits, Ogre::uint8 lod=0);
+
+      /*! Check if this model mesh intersects another one (ie: any of their
+       * cached mesh triangles, with current node transforms), traversing
+       * both BVHs together. Will cache the meshes if not yet done.
+       * \param other the model to test against
+       * \param lod level of detail to query, on both models (as on
+       *        #rayIntersect)
+       * \return true if they intersect, false if not or if any cached
+       *         mesh isn't yet available. */
+      bool intersects(Model3d& other, Ogre::uint8 lod=0);
+      /*! Get the intersecting triangle pairs of this and another model
+       * (see #intersects).
+       * \param other the model to test against
+       * \param contacts vector to receive the pairs (appended to it), with
+       *        triangleA from this model and triangleB from other (at the
+       *        used levels cached meshes).
+       * \param maxContacts stop after finding this many pairs
+       * \param lod level of detail to query, on both models
+       * \return number of pairs found */
+      size_t getContacts(Model3d& other, std::vector<MeshContact>& contacts,
+            size_t maxContacts=MESH_BVH_MAX_CONTACTS, Ogre::uint8 lod=0);
+
+      /*! Split the cached mesh in meshlets (small triangle clusters), to
+       * cull its parts on CPU with #getVisibleMeshlets. Will cache the
+       * mesh if not yet done (and they are built again if the mesh is 
+       * cached again at a new scale).
+       * \note meshlets are shared with all models of the same cached mesh.
+       * \see VertexUtils::buildMeshlets for parameters 
+       * \return false if the cached mesh isn't yet available. */
+      bool buildMeshlets(Ogre::uint32 maxVertices=64, 
+            Ogre::uint32 maxTriangles=124);
+      /*! \return the model meshlets, or NULL if not built. */
+      const MeshletList* getMeshlets() const 
+      { 
+         return (cachedMesh) ? cachedMesh->getMeshlets() : NULL; 
+      };
+      /*! Get the meshlets visible from the current Camera: the ones 
+       * inside its frustum and not back facing it.
+       * \param visible vector to receive the visible meshlets indexes
+       *        (cleared first).
+       * \return number of visible meshlets (0 if not built). */
+      size_t getVisibleMeshlets(std::vector<Ogre::uint32>& visible);
 #endif
 
    protected:
@@ -192,6 +370,47 @@ class Model3d
       /*! \return equivalent angle to target that is nearest cur */
       float getNearestEquivalentAngle(float cur, float target);
 
+      /*! Add the model to the SceneIndex or update its bounds there, 
+       * if the index is enabled. Called when the node changed. */
+      void updateSceneIndex();
+
+      /*! Apply the changed transform (set, or stepped by the 
+       * ModelManager) to the scene node.
+       * \return if anything changed */
+      bool applyTransform();
+      /*! Apply the transform interpolated between its previous and current 
+       * steps to the scene node (see ModelManager::interpolate) */
+      void applyInterpolation(Ogre::Real factor);
+      /*! Set the scene node back to the current transform, after
+       * rendering it interpolated (see ModelManager::restore) */
+      void applyCurrentTransform();
+      /*! Clear flags of our transform at the ModelManager */
+      void clearTransformFlags(Ogre::uint8 f)
+      {
+         ModelManager::clearFlags(transform, f);
+      };
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+      /*! \return the cached mesh to query at a level of detail: the 
+       *          nearest finer ready one (NULL if none) */
+      CachedMesh* getCollisionMesh(Ogre::uint8 lod) const;
+      /*! \return the BVH to query at a level of detail (caching the full
+       *          mesh if not yet done), or NULL if not yet available. */
+      const MeshBvh* getCollisionBvh(Ogre::uint8 lod);
+      /*! Cache the mesh if not yet done, or again (with its levels of 
+       * detail and meshlets) if the node derived scale changed since it 
+       * was cached, as the cached vertices have the scale applied. */
+      void validateCachedMesh();
+      /*! Get the transform from other model space to ours */
+      void getRelativeTransform(Model3d& other, 
+            Ogre::Quaternion& orientation, Ogre::Vector3& position);
+      /*! Transform the cached mesh to world space, if its node transform
+       * (or the cached mesh) changed since last done.
+       * \return false if the cached mesh isn't yet available. */
+      bool updateWorldCachedMesh();
+#endif
+
       Ogre::SceneManager* ogreSceneManager;  /**< Scene manager in use */
 
       Ogre::SceneNode* node;    /**< Scene Node */
@@ -205,26 +424,34 @@ class Model3d
       /* Note: for 2.1 we could keep (when needed) a copy of the model's
        * vertices and indexes, to further allow polygon collision check in
        * them. */
-      size_t vertexCount;      /**< Current vertex count */
-      Ogre::Vector3* vertices; /**< The cached model vertices */
-      size_t indexCount;       /**< Current index count */
-      Ogre::uint32* indices;   /**< The cached model index */
+      CachedMesh* cachedMesh;  /**< The cached model mesh (shared) */
+
+      /*! World space copy of the cached mesh vertices (own) */
+      std::vector<Ogre::Vector3> worldVertices;
+      Ogre::AxisAlignedBox worldBounds; /**< Bounds of worldVertices */
+      /*! Cached mesh transformed to worldVertices (NULL if none) */
+      const CachedMesh* worldMesh;
+      Ogre::Vector3 worldPosition;       /**< Position of worldVertices */
+      Ogre::Quaternion worldOrientation; /**< Orientation of them */
+      /*! Cached coarser levels of detail (index lod - 1), NULL if not */
+      std::vector<CachedMesh*> cachedLods;
+      /*! Parameters of the last #buildMeshlets (0 if never called), to 
+       * build them again when the mesh is cached at other scale. */
+      Ogre::uint32 meshletMaxVertices;
+      Ogre::uint32 meshletMaxTriangles; /**< \see meshletMaxVertices */
 #endif
 
-      Kobold::Target pos[3];    /**< Target position for model */
-      Kobold::Target ori[3];    /**< Orientation angles */
-      Kobold::Target scala[3];  /**< Target scale for model */
-
-      bool dirtyPos;          /**< If should update node position */
-      bool dirtyOri;          /**< If should update orientation */
-      bool dirtyScale;        /**< If should update scale */
-      Ogre::Vector3 prevOri;  /**< Previous orientation */
+      /*! Index of its transform (position, orientation angles and scale,
+       * with their targets) at the ModelManager */
+      Ogre::uint32 transform;
 
 #if OGRE_VERSION_MAJOR != 1
       Ogre::SceneMemoryMgrTypes sceneType;    /**< Model's scene type */
 #endif
 
       bool visible;        /**< If is visible or not */
+
+      Ogre::int32 sceneIndexNode; /**< Leaf at the SceneIndex (or -1) */
 };
 
 /*! A 3d model with animations. This kind must have an Ogre::Skeleton attached
@@ -255,6 +482,21 @@ class AnimatedModel3d : public Model3d
       /*! Update model's position, rotation, scale and animations.
        * \return true if updated its position, scale or rotation. */
       virtual bool update();
+      /*! Update only the model animations (when its transform is updated
+       * by ModelManager::update). It's #prepareAnimations followed by 
+       * #commitAnimations. */
+      void updateAnimations();
+
+      /*! Compute the animations for the current frame (timer, finished
+       * animation and fade weights), without touching any Ogre object, 
+       * thus safe to be called from a worker thread, as done by 
+       * ModelManager::prepare. 
+       * \note must be followed by #commitAnimations on the main thread. */
+      void prepareAnimations();
+      /*! Apply the animations computed by #prepareAnimations to the Ogre
+       * animation states (and finish a non-looping animation, if elapsed).
+       */
+      void commitAnimations();
 
       /*! Set model's base animation
        * \param index index of model's new base animation
@@ -294,8 +536,13 @@ class AnimatedModel3d : public Model3d
 
             /*! \return current global weight of the animation */
             Ogre::Real getWeight();
-            /*! Set current animation global weight */
+            /*! Set current animation global weight.
+             * \note only applied to the animation on #commit */
             void setWeight(Ogre::Real weight);
+            /*! Set to disable the animation on #commit */
+            void setDisable();
+            /*! Apply the weight and disable set to the animation */
+            void commit();
 
             /*! Set current frame/time to 0 */
             void reset();
@@ -318,6 +565,9 @@ class AnimatedModel3d : public Model3d
 #endif
             bool fadingIn;
             bool fadingOut;
+            Ogre::Real weight; /**< Current weight */
+            bool weightChanged; /**< If weight changed since last commit */
+            bool disable; /**< If should disable on next commit */
       };
 
       /*! Update fade-in and fade-out to animation states */
@@ -337,6 +587,8 @@ class AnimatedModel3d : public Model3d
       AnimationInfo* animations; /**< Model animations */
       Ogre::Real timer; /**< Timer reference for our animations */
       bool animationSet; /**< If animation was set at this frame */
+      bool animationFinished; /**< If a non-looping animation finished at
+                                   the frame (by prepareAnimations) */
 };
 
 }
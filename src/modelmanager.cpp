@@ -0,0 +1,505 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modelmanager.h"
+#include "model3d.h"
+#include "simd.h"
+#include "goblinconfig.h"
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+   #include <OGRE/Threading/OgreUniformScalableTask.h>
+#endif
+
+#include <OGRE/OgreMath.h>
+
+#include <assert.h>
+#include <algorithm>
+
+using namespace Goblin;
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+namespace Goblin
+{
+/*! ModelManager::prepare task, for the scene manager worker threads */
+class ModelManagerPrepareTask : public Ogre::UniformScalableTask
+{
+   public:
+      void execute(size_t threadId, size_t numThreads)
+      {
+         ModelManager::prepareSlice(threadId, numThreads);
+      };
+};
+}
+#endif
+
+/*! Shift of the first FLAG_MOVED_* */
+#define MODEL_MANAGER_MOVED_SHIFT   3
+/*! Interpolated bit of a transform channel at its block */
+#define MODEL_MANAGER_INTERPOLATED_BIT(index, channel) \
+   (((Ogre::uint64) 1) << ((index) % 4 + 4 * (channel)))
+
+/***********************************************************************
+ *                                 add                                 *
+ ***********************************************************************/
+Ogre::uint32 ModelManager::add(Model3d* model)
+{
+   Ogre::uint32 index = (Ogre::uint32) models.size();
+   models.push_back(model);
+   flags.push_back(0);
+   activeSlot.push_back(-1);
+
+   /* Grow the channels by 4, keeping the padding at rest */
+   if(current[0].size() <= index)
+   {
+      size_t size = index + 4;
+      moved.push_back(0);
+      interpolated.push_back(0);
+      for(int c = 0; c < TOTAL_CHANNELS; c++)
+      {
+         current[c].resize(size, 0.0f);
+         previous[c].resize(size, 0.0f);
+         target[c].resize(size, 0.0f);
+         delta[c].resize(size, 0.0f);
+      }
+   }
+
+   /* Identity transform */
+   for(int c = 0; c < TOTAL_CHANNELS; c++)
+   {
+      current[c][index] = (c >= CHANNEL_SCALE_X) ? 1.0f : 0.0f;
+      previous[c][index] = current[c][index];
+      target[c][index] = current[c][index];
+      delta[c][index] = 0.0f;
+   }
+
+   return index;
+}
+
+/***********************************************************************
+ *                                remove                               *
+ ***********************************************************************/
+void ModelManager::remove(Ogre::uint32 index)
+{
+   assert(index < models.size());
+   Ogre::uint32 last = (Ogre::uint32) models.size() - 1;
+   deactivate(index);
+   if(index != last)
+   {
+      /* Move the last one to its place */
+      Ogre::uint8 lastFlags = getFlags(last);
+      models[index] = models[last];
+      activeSlot[index] = activeSlot[last];
+      if(activeSlot[index] >= 0)
+      {
+         active[activeSlot[index]] = index;
+      }
+      clearFlags(index, FLAGS_MOVED);
+      flags[index] = lastFlags & ~FLAGS_MOVED;
+      for(int g = 0; g < 3; g++)
+      {
+         if(lastFlags & (1 << (MODEL_MANAGER_MOVED_SHIFT + g)))
+         {
+            moved[index / 4] |= 1 << (index % 4 + 4 * g);
+         }
+      }
+      for(int c = 0; c < TOTAL_CHANNELS; c++)
+      {
+         current[c][index] = current[c][last];
+         previous[c][index] = previous[c][last];
+         target[c][index] = target[c][last];
+         delta[c][index] = delta[c][last];
+         interpolated[index / 4] &= ~MODEL_MANAGER_INTERPOLATED_BIT(index, c);
+         if(interpolated[last / 4] & MODEL_MANAGER_INTERPOLATED_BIT(last, c))
+         {
+            interpolated[index / 4] |= 
+               MODEL_MANAGER_INTERPOLATED_BIT(index, c);
+         }
+      }
+      models[index]->transform = index;
+   }
+
+   /* The last one is now padding: put it at rest */
+   for(int c = 0; c < TOTAL_CHANNELS; c++)
+   {
+      delta[c][last] = 0.0f;
+      interpolated[last / 4] &= ~MODEL_MANAGER_INTERPOLATED_BIT(last, c);
+   }
+   clearFlags(last, FLAGS_MOVED);
+   models.pop_back();
+   flags.pop_back();
+   activeSlot.pop_back();
+}
+
+/***********************************************************************
+ *                              deactivate                             *
+ ***********************************************************************/
+void ModelManager::deactivate(Ogre::uint32 index)
+{
+   Ogre::int32 slot = activeSlot[index];
+   if(slot < 0)
+   {
+      return;
+   }
+
+   /* Put the last active one at its slot */
+   Ogre::uint32 lastActive = active.back();
+   active[slot] = lastActive;
+   activeSlot[lastActive] = slot;
+   active.pop_back();
+   activeSlot[index] = -1;
+}
+
+/***********************************************************************
+ *                              isSettled                              *
+ ***********************************************************************/
+const bool ModelManager::isSettled(Ogre::uint32 index)
+{
+   /* Moved on the last step: still interpolating to it (and next step
+    * will clear it) */
+   if(interpolated[index / 4] & (0x111111111ULL << (index % 4)))
+   {
+      return false;
+   }
+   for(int c = 0; c < TOTAL_CHANNELS; c++)
+   {
+      if(delta[c][index] != 0.0f)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+/***********************************************************************
+ *                              setCurrent                             *
+ ***********************************************************************/
+void ModelManager::setCurrent(Ogre::uint32 index, int channel,
+      Ogre::Real value)
+{
+   current[channel][index] = value;
+   target[channel][index] = value;
+   delta[channel][index] = 0.0f;
+   /* No longer interpolating from its previous value */
+   interpolated[index / 4] &= ~MODEL_MANAGER_INTERPOLATED_BIT(index, channel);
+}
+
+/***********************************************************************
+ *                              setTarget                              *
+ ***********************************************************************/
+void ModelManager::setTarget(Ogre::uint32 index, int channel,
+      Ogre::Real value, int nSteps)
+{
+   target[channel][index] = value;
+   delta[channel][index] = (value - current[channel][index]) /
+      ((nSteps > 0) ? nSteps : 1);
+   activate(index);
+}
+
+/***********************************************************************
+ *                               getSteps                              *
+ ***********************************************************************/
+const int ModelManager::getSteps(Ogre::Real seconds)
+{
+   int nSteps = (int) ((seconds * 1000.0f) / BASE_APP_UPDATE_RATE + 0.5f);
+   return (nSteps > 0) ? nSteps : 1;
+}
+
+/***********************************************************************
+ *                               getFlags                              *
+ ***********************************************************************/
+const Ogre::uint8 ModelManager::getFlags(Ogre::uint32 index)
+{
+   Ogre::uint16 blockMoved = moved[index / 4] >> (index % 4);
+   Ogre::uint8 f = flags[index];
+   for(int g = 0; g < 3; g++)
+   {
+      if(blockMoved & (1 << (4 * g)))
+      {
+         f |= (1 << (MODEL_MANAGER_MOVED_SHIFT + g));
+      }
+   }
+   return f;
+}
+
+/***********************************************************************
+ *                              clearFlags                             *
+ ***********************************************************************/
+void ModelManager::clearFlags(Ogre::uint32 index, Ogre::uint8 f)
+{
+   flags[index] &= ~f;
+   for(int g = 0; g < 3; g++)
+   {
+      if(f & (1 << (MODEL_MANAGER_MOVED_SHIFT + g)))
+      {
+         moved[index / 4] &= ~(1 << (index % 4 + 4 * g));
+      }
+   }
+}
+
+/***********************************************************************
+ *                                 step                                *
+ ***********************************************************************/
+void ModelManager::step(Ogre::uint32 index)
+{
+   for(int c = 0; c < TOTAL_CHANNELS; c++)
+   {
+      Ogre::Real d = delta[c][index];
+      if(d == 0.0f)
+      {
+         interpolated[index / 4] &= ~MODEL_MANAGER_INTERPOLATED_BIT(index, c);
+         continue;
+      }
+
+      /* Go a step to the target, stopping there if reached (or if the 
+       * step is too small to change the value) */
+      Ogre::Real cur = current[c][index];
+      Ogre::Real next = cur + d;
+      Ogre::Real tgt = target[c][index];
+      if(((d > 0.0f) && ((next >= tgt) || (next <= cur))) || 
+         ((d < 0.0f) && ((next <= tgt) || (next >= cur))))
+      {
+         next = tgt;
+         delta[c][index] = 0.0f;
+      }
+      previous[c][index] = cur;
+      current[c][index] = next;
+      interpolated[index / 4] |= MODEL_MANAGER_INTERPOLATED_BIT(index, c);
+      moved[index / 4] |= 1 << (index % 4 + 4 * (c / 3));
+   }
+}
+
+/***********************************************************************
+ *                              stepBlocks                             *
+ ***********************************************************************/
+void ModelManager::stepBlocks(size_t first, size_t end)
+{
+   if(first >= end)
+   {
+      return;
+   }
+   const Simd::Float4 zero = Simd::zero();
+   for(int c = 0; c < TOTAL_CHANNELS; c++)
+   {
+      Ogre::Real* cur = &current[c][0];
+      Ogre::Real* prev = &previous[c][0];
+      Ogre::Real* tgt = &target[c][0];
+      Ogre::Real* dlt = &delta[c][0];
+      const int shift = 4 * (c / 3);
+
+      /* Note: channels are padded to 4, with the padding at rest */
+      for(size_t i = first * 4; i < end * 4; i += 4)
+      {
+         Simd::Float4 d = Simd::load(dlt + i);
+         Simd::Mask4 dPos = Simd::cmpGt(d, zero);
+         Simd::Mask4 dNeg = Simd::cmpLt(d, zero);
+         int active = Simd::moveMask(Simd::maskOr(dPos, dNeg));
+         if(active == 0)
+         {
+            /* All 4 at rest (the usual case) */
+            interpolated[i / 4] &= ~(((Ogre::uint64) 0xF) << (4 * c));
+            continue;
+         }
+
+         Simd::Float4 c0 = Simd::load(cur + i);
+         Simd::Float4 t = Simd::load(tgt + i);
+         Simd::Float4 next = Simd::add(c0, d);
+         /* Reached (or stalled, with a step too small to change it) */
+         Simd::Mask4 reached = Simd::maskOr(
+               Simd::maskAnd(dPos, Simd::maskOr(Simd::cmpGe(next, t), 
+                     Simd::cmpLe(next, c0))),
+               Simd::maskAnd(dNeg, Simd::maskOr(Simd::cmpLe(next, t),
+                     Simd::cmpGe(next, c0))));
+         next = Simd::select(reached, t, next);
+
+         Simd::store(prev + i, c0);
+         Simd::store(cur + i, next);
+         Simd::store(dlt + i, Simd::select(reached, zero, d));
+         /* Mark the moved ones (padding lanes are never active) */
+         moved[i / 4] |= active << shift;
+         interpolated[i / 4] = (interpolated[i / 4] & 
+               ~(((Ogre::uint64) 0xF) << (4 * c))) | 
+            (((Ogre::uint64) active) << (4 * c));
+      }
+   }
+}
+
+/***********************************************************************
+ *                             prepareSlice                            *
+ ***********************************************************************/
+void ModelManager::prepareSlice(size_t threadIdx, size_t numThreads)
+{
+   if(denseStep)
+   {
+      size_t numBlocks = (models.size() + 3) / 4;
+      stepBlocks((numBlocks * threadIdx) / numThreads, 
+            (numBlocks * (threadIdx + 1)) / numThreads);
+   }
+
+   /* And the animations of our slice of the active ones */
+   size_t first = (active.size() * threadIdx) / numThreads;
+   size_t end = (active.size() * (threadIdx + 1)) / numThreads;
+   for(size_t a = first; a < end; a++)
+   {
+      Ogre::uint32 i = active[a];
+      if((flags[i] & FLAG_ANIMATED) && (flags[i] & FLAG_DYNAMIC))
+      {
+         static_cast<AnimatedModel3d*>(models[i])->prepareAnimations();
+      }
+   }
+}
+
+/***********************************************************************
+ *                               prepare                               *
+ ***********************************************************************/
+void ModelManager::prepare(Ogre::SceneManager* sceneManager)
+{
+   /* Step all models, vectorized, only when most blocks have an active 
+    * one. Otherwise, just each active (at the calling thread, as 
+    * neighbours share their block bits). */
+   denseStep = (active.size() >= 
+         MODEL_MANAGER_DENSE_ACTIVE * ((models.size() + 3) / 4));
+   if(!denseStep)
+   {
+      for(size_t a = 0; a < active.size(); a++)
+      {
+         step(active[a]);
+      }
+   }
+
+#if OGRE_VERSION_MAJOR > 2 || \
+    (OGRE_VERSION_MAJOR == 2 && OGRE_VERSION_MINOR > 0)
+   size_t work = (denseStep) ? models.size() : active.size();
+   if((sceneManager) && (sceneManager->getNumWorkerThreads() > 1) &&
+      (work >= 2 * MODEL_MANAGER_MIN_MODELS_PER_THREAD))
+   {
+      ModelManagerPrepareTask task;
+      sceneManager->executeUserScalableTask(&task, true);
+      return;
+   }
+#endif
+
+   prepareSlice(0, 1);
+}
+
+/***********************************************************************
+ *                                commit                               *
+ ***********************************************************************/
+size_t ModelManager::commit()
+{
+   /* Apply to the nodes only the changed ones */
+   size_t updated = 0;
+   size_t a = 0;
+   while(a < active.size())
+   {
+      Ogre::uint32 i = active[a];
+      Ogre::uint8 f = flags[i];
+      if(f & FLAG_DYNAMIC)
+      {
+         if((getFlags(i) & FLAGS_CHANGED) && (models[i]->applyTransform()))
+         {
+            updated++;
+         }
+         if(f & FLAG_ANIMATED)
+         {
+            static_cast<AnimatedModel3d*>(models[i])->commitAnimations();
+         }
+      }
+
+      /* Keep only the ones still to update (the animated always are) */
+      if(((f & FLAG_DYNAMIC) && (f & FLAG_ANIMATED)) || (!isSettled(i)))
+      {
+         a++;
+      }
+      else
+      {
+         /* The last active is now at this slot */
+         deactivate(i);
+      }
+   }
+
+   return updated;
+}
+
+/***********************************************************************
+ *                             interpolate                             *
+ ***********************************************************************/
+void ModelManager::interpolate(Ogre::Real factor)
+{
+   factor = Ogre::Math::Clamp<Ogre::Real>(factor, 0.0f, 1.0f);
+
+   /* Only the ones moved on the last step (all of them active) */
+   for(size_t a = 0; a < active.size(); a++)
+   {
+      Ogre::uint32 i = active[a];
+      if((interpolated[i / 4] & (0x111111111ULL << (i % 4))) &&
+         (flags[i] & FLAG_DYNAMIC))
+      {
+         models[i]->applyInterpolation(factor);
+         /* Its node is no longer at its current transform: the next 
+          * commit must set it back (even if it stops moving, before it 
+          * could be deactivated). */
+         flags[i] |= FLAGS_DIRTY;
+      }
+   }
+}
+
+/***********************************************************************
+ *                               restore                               *
+ ***********************************************************************/
+void ModelManager::restore()
+{
+   /* Same ones as on interpolate (no step was done after it) */
+   for(size_t a = 0; a < active.size(); a++)
+   {
+      Ogre::uint32 i = active[a];
+      if((interpolated[i / 4] & (0x111111111ULL << (i % 4))) &&
+         (flags[i] & FLAG_DYNAMIC))
+      {
+         models[i]->applyCurrentTransform();
+      }
+   }
+}
+
+/***********************************************************************
+ *                                update                               *
+ ***********************************************************************/
+size_t ModelManager::update(Ogre::SceneManager* sceneManager)
+{
+   prepare(sceneManager);
+   return commit();
+}
+
+/***********************************************************************
+ *                            static members                           *
+ ***********************************************************************/
+std::vector<Model3d*> ModelManager::models;
+std::vector<Ogre::uint8> ModelManager::flags;
+std::vector<Ogre::uint32> ModelManager::active;
+std::vector<Ogre::int32> ModelManager::activeSlot;
+bool ModelManager::denseStep = false;
+std::vector<Ogre::uint16> ModelManager::moved;
+std::vector<Ogre::uint64> ModelManager::interpolated;
+std::vector<Ogre::Real> ModelManager::current[TOTAL_CHANNELS];
+std::vector<Ogre::Real> ModelManager::previous[TOTAL_CHANNELS];
+std::vector<Ogre::Real> ModelManager::target[TOTAL_CHANNELS];
+std::vector<Ogre::Real> ModelManager::delta[TOTAL_CHANNELS];
+
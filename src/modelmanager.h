@@ -0,0 +1,253 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_model_manager_h
+#define _goblin_model_manager_h
+
+#include <OGRE/OgrePrerequisites.h>
+#include <OGRE/OgreSceneManager.h>
+
+#include <vector>
+
+/*! Minimum models for each thread of ModelManager::prepare */
+#define MODEL_MANAGER_MIN_MODELS_PER_THREAD   512
+/*! Minimum active models in each 4 models (on average) to step all of
+ * them, in a vectorized pass, instead of each active one. */
+#define MODEL_MANAGER_DENSE_ACTIVE   1
+
+namespace Goblin
+{
+
+class Model3d;
+
+/*! Keeper of the transforms (position, orientation angles and scale) of
+ * all Model3d, with their current and target values (stepped as
+ * Kobold::Target) in structure of arrays, one array per channel. Each
+ * Model3d is just a handle (index) to its transform here.
+ * Instead of calling Model3d::update for each dynamic model, one could
+ * call #update once per frame, to step all interpolations at once, in a
+ * vectorized pass, and then only touch the scene nodes of the models that
+ * changed.
+ * The update is done in two phases: #prepare computes the new transforms
+ * and AnimatedModel3d animation times and weights, in parallel, without
+ * touching any Ogre object; then #commit writes them to the scene nodes 
+ * and animation states, serially. 
+ * Only the active models (the ones with a target, a changed transform or
+ * animations) are updated: a model is activated when its transform is
+ * set and deactivated when settled, thus idle models cost nothing. */
+class ModelManager
+{
+   public:
+      /*! Transform channels, each with its own arrays */
+      enum Channel
+      {
+         CHANNEL_POSITION_X = 0,
+         CHANNEL_POSITION_Y,
+         CHANNEL_POSITION_Z,
+         CHANNEL_PITCH,
+         CHANNEL_YAW,
+         CHANNEL_ROLL,
+         CHANNEL_SCALE_X,
+         CHANNEL_SCALE_Y,
+         CHANNEL_SCALE_Z,
+         TOTAL_CHANNELS
+      };
+
+      /*! Update all models: #prepare and then #commit.
+       * \note don't call Model3d::update for the models too, or they
+       *       will be stepped twice on the frame.
+       * \return number of models whose nodes were changed */
+      static size_t update(Ogre::SceneManager* sceneManager=NULL);
+
+      /*! Compute phase of the update: step the interpolations of all 
+       * models and the animations (see AnimatedModel3d::prepareAnimations)
+       * of the dynamic ones, split over the scene manager worker threads.
+       * No scene node or animation state is changed.
+       * \note must be called from the main thread, out of Ogre's frame 
+       *       rendering (and without changing models on other threads).
+       * \param sceneManager whose worker threads to use. If NULL (or with
+       *        just a few models), done on the calling thread. */
+      static void prepare(Ogre::SceneManager* sceneManager=NULL);
+
+      /*! Commit phase of the update: apply the prepared transforms and 
+       * animations to the scene nodes and animation states of the dynamic
+       * models. Call it, on the main thread, before rendering the frame.
+       * \return number of models whose nodes were changed */
+      static size_t commit();
+
+      /*! Set the scene nodes of the models moved on the last step to
+       * their transforms interpolated between the previous and the current
+       * step, to render between fixed rate updates (see 
+       * BaseApp::shouldInterpolateModels). 
+       * \note only for steps done by #update or #prepare. Call #restore
+       *       just after rendering: everything else reading the nodes
+       *       (ray and collision queries, meshlets culling, etc) expects
+       *       them at the current transforms, as the SceneIndex bounds.
+       *       The models interpolated are also marked dirty, so its next
+       *       #commit sets their nodes at their current transforms.
+       * \param factor interpolation factor: 0 for the previous step, 1 for
+       *        the current one (ie: time since the step, in steps). */
+      static void interpolate(Ogre::Real factor);
+      /*! Set the scene nodes changed by #interpolate back to the current
+       * transforms of their models. */
+      static void restore();
+
+      /*! \return number of steps (at BASE_APP_UPDATE_RATE) to do in 
+       *          a time (rounded, at least 1).
+       * \param seconds time in seconds */
+      static const int getSteps(Ogre::Real seconds);
+
+      /*! \return number of models with a transform here */
+      static const size_t getTotalModels() { return models.size(); };
+      /*! \return number of active models (updated by #update) */
+      static const size_t getTotalActiveModels() { return active.size(); };
+
+   protected:
+      friend class Model3d;
+      friend class AnimatedModel3d;
+      friend class ModelManagerPrepareTask;
+
+      /*! Flags of each transform */
+      enum Flags
+      {
+         /*! Current position changed, but not applied to its node */
+         FLAG_DIRTY_POSITION = 0x01,
+         /*! Current orientation changed, but not applied to its node */
+         FLAG_DIRTY_ORIENTATION = 0x02,
+         /*! Current scale changed, but not applied to its node */
+         FLAG_DIRTY_SCALE = 0x04,
+         /*! Position stepped, but not applied to its node */
+         FLAG_MOVED_POSITION = 0x08,
+         /*! Orientation stepped, but not applied to its node */
+         FLAG_MOVED_ORIENTATION = 0x10,
+         /*! Scale stepped, but not applied to its node */
+         FLAG_MOVED_SCALE = 0x20,
+         /*! If the model is a dynamic one (thus updated by #update) */
+         FLAG_DYNAMIC = 0x40,
+         /*! If the model is an AnimatedModel3d */
+         FLAG_ANIMATED = 0x80,
+
+         FLAGS_DIRTY = 0x07,
+         FLAGS_MOVED = 0x38,
+         FLAGS_CHANGED = 0x3F
+      };
+
+      /*! Add a transform for a model.
+       * \return its index */
+      static Ogre::uint32 add(Model3d* model);
+      /*! Remove a transform. The last one is moved to its place (with
+       * its model index updated). */
+      static void remove(Ogre::uint32 index);
+
+      /*! Set the current value of a channel, stopping its interpolation */
+      static void setCurrent(Ogre::uint32 index, int channel,
+            Ogre::Real value);
+      /*! Set the target of a channel, to interpolate to it
+       * \param nSteps number of steps to get there */
+      static void setTarget(Ogre::uint32 index, int channel,
+            Ogre::Real value, int nSteps);
+      /*! \return current value of a channel */
+      static const Ogre::Real getValue(Ogre::uint32 index, int channel)
+      {
+         return current[channel][index];
+      };
+
+      /*! \return value of a channel interpolated between its previous
+       *          and current step values (or the current, if it didn't
+       *          move on the last step) */
+      static const Ogre::Real getInterpolated(Ogre::uint32 index, 
+            int channel, Ogre::Real factor)
+      {
+         if(interpolated[index / 4] & 
+            (((Ogre::uint64) 1) << (index % 4 + 4 * channel)))
+         {
+            return previous[channel][index] + factor * 
+               (current[channel][index] - previous[channel][index]);
+         }
+         return current[channel][index];
+      };
+
+      /*! Set flags of a transform, activating it */
+      static void setFlags(Ogre::uint32 index, Ogre::uint8 f)
+      {
+         flags[index] |= f;
+         activate(index);
+      };
+      /*! Put a transform at the active set, if not yet there */
+      static void activate(Ogre::uint32 index)
+      {
+         if(activeSlot[index] < 0)
+         {
+            activeSlot[index] = (Ogre::int32) active.size();
+            active.push_back(index);
+         }
+      };
+      /*! Remove a transform from the active set */
+      static void deactivate(Ogre::uint32 index);
+      /*! \return if a transform has no interpolation going on (nor
+       *          moved on the last step) */
+      static const bool isSettled(Ogre::uint32 index);
+
+      /*! \return flags of a transform, with its FLAGS_MOVED */
+      static const Ogre::uint8 getFlags(Ogre::uint32 index);
+      /*! Clear flags of a transform (including FLAGS_MOVED ones) */
+      static void clearFlags(Ogre::uint32 index, Ogre::uint8 f);
+
+      /*! Step the interpolations of a single transform */
+      static void step(Ogre::uint32 index);
+      /*! Step the interpolations of the transforms of some blocks (of 4
+       * transforms), 4 at once.
+       * \param first first block
+       * \param end block after the last one */
+      static void stepBlocks(size_t first, size_t end);
+      /*! Do a thread slice of #prepare: step its blocks (if #denseStep) 
+       * and prepare the animations of its active models */
+      static void prepareSlice(size_t threadIdx, size_t numThreads);
+
+      static std::vector<Model3d*> models; /**< Model of each transform */
+      /*! Active transforms (with interpolations, changes or animations) */
+      static std::vector<Ogre::uint32> active;
+      /*! Position of each transform at #active (-1 if not active) */
+      static std::vector<Ogre::int32> activeSlot;
+      /*! If current #prepare steps all blocks (instead of each active) */
+      static bool denseStep;
+      /*! Flags of each one, but FLAGS_MOVED (see #moved) */
+      static std::vector<Ogre::uint8> flags;
+      /*! Moved channel groups of each 4 transforms (a block): bit
+       * (lane + 4 * group), with groups position, orientation and scale.
+       * Kept by block, so a vectorized step sets them with a single 
+       * write. */
+      static std::vector<Ogre::uint16> moved;
+      /*! Channels moved on the last #stepBlocks of each block: bit 
+       * (lane + 4 * channel) */
+      static std::vector<Ogre::uint64> interpolated;
+      /* Each channel arrays, with their sizes padded to 4 (with delta 0)*/
+      static std::vector<Ogre::Real> current[TOTAL_CHANNELS];
+      /*! Values before the last #stepBlocks (only valid where 
+       * #interpolated) */
+      static std::vector<Ogre::Real> previous[TOTAL_CHANNELS];
+      static std::vector<Ogre::Real> target[TOTAL_CHANNELS];
+      static std::vector<Ogre::Real> delta[TOTAL_CHANNELS];
+};
+
+}
+
+#endif
+
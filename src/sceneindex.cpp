@@ -0,0 +1,664 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sceneindex.h"
+#include "model3d.h"
+
+#include <OGRE/OgrePlane.h>
+
+#include <assert.h>
+#include <algorithm>
+
+using namespace Goblin;
+
+/*! Initial capacity of the query stacks */
+#define SCENE_INDEX_STACK_SIZE   64
+
+/***********************************************************************
+ *                             surfaceArea                             *
+ ***********************************************************************/
+static inline Ogre::Real surfaceArea(const Ogre::Vector3& min,
+      const Ogre::Vector3& max)
+{
+   /* Half of it, as only used for comparisons */
+   Ogre::Vector3 d = max - min;
+   return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+/***********************************************************************
+ *                             unionArea                               *
+ ***********************************************************************/
+static inline Ogre::Real unionArea(const Ogre::Vector3& minA,
+      const Ogre::Vector3& maxA, const Ogre::Vector3& minB,
+      const Ogre::Vector3& maxB)
+{
+   Ogre::Vector3 min = minA;
+   Ogre::Vector3 max = maxA;
+   min.makeFloor(minB);
+   max.makeCeil(maxB);
+   return surfaceArea(min, max);
+}
+
+/*! Box overlap test for SceneIndex::traverse */
+class SceneIndexBoxTest
+{
+   public:
+      SceneIndexBoxTest(const Ogre::AxisAlignedBox& box)
+         : min(box.getMinimum()), max(box.getMaximum()) {};
+
+      bool operator()(const Ogre::Vector3& nMin,
+            const Ogre::Vector3& nMax) const
+      {
+         return (nMin.x <= max.x) && (nMax.x >= min.x) &&
+                (nMin.y <= max.y) && (nMax.y >= min.y) &&
+                (nMin.z <= max.z) && (nMax.z >= min.z);
+      };
+
+      Ogre::Vector3 min;
+      Ogre::Vector3 max;
+};
+
+/*! Sphere overlap test for SceneIndex::traverse */
+class SceneIndexSphereTest
+{
+   public:
+      SceneIndexSphereTest(const Ogre::Sphere& sphere)
+         : center(sphere.getCenter()),
+           sqrRadius(sphere.getRadius() * sphere.getRadius()) {};
+
+      bool operator()(const Ogre::Vector3& nMin,
+            const Ogre::Vector3& nMax) const
+      {
+         /* Distance from the center to its nearest box point */
+         Ogre::Vector3 nearest = center;
+         nearest.makeCeil(nMin);
+         nearest.makeFloor(nMax);
+         return nearest.squaredDistance(center) <= sqrRadius;
+      };
+
+      Ogre::Vector3 center;
+      Ogre::Real sqrRadius;
+};
+
+/*! Ray hit test (slabs) for SceneIndex::traverse */
+class SceneIndexRayTest
+{
+   public:
+      SceneIndexRayTest(const Ogre::Ray& ray, Ogre::Real maxDistance)
+         : origin(ray.getOrigin()), maxDistance(maxDistance)
+      {
+         const Ogre::Vector3& dir = ray.getDirection();
+         invDir = Ogre::Vector3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+      };
+
+      bool operator()(const Ogre::Vector3& nMin,
+            const Ogre::Vector3& nMax) const
+      {
+         Ogre::Real tNear = 0.0f;
+         Ogre::Real tFar = maxDistance;
+         for(int i = 0; i < 3; i++)
+         {
+            Ogre::Real t0 = (nMin[i] - origin[i]) * invDir[i];
+            Ogre::Real t1 = (nMax[i] - origin[i]) * invDir[i];
+            if(t0 > t1)
+            {
+               std::swap(t0, t1);
+            }
+            /* Note: written to keep tNear and tFar when NaN (ray parallel
+             * to the slab and at its border) */
+            tNear = (t0 > tNear) ? t0 : tNear;
+            tFar = (t1 < tFar) ? t1 : tFar;
+            if(tNear > tFar)
+            {
+               return false;
+            }
+         }
+         return true;
+      };
+
+      Ogre::Vector3 origin;
+      Ogre::Vector3 invDir;
+      Ogre::Real maxDistance;
+};
+
+///////////////////////////////////////////////////////////////////////////
+//                                                                       //
+//                              SceneIndex                               //
+//                                                                       //
+///////////////////////////////////////////////////////////////////////////
+
+/***********************************************************************
+ *                                enable                               *
+ ***********************************************************************/
+void SceneIndex::enable(Ogre::Real margin)
+{
+   SceneIndex::margin = margin;
+   enabled = true;
+}
+
+/***********************************************************************
+ *                               disable                               *
+ ***********************************************************************/
+void SceneIndex::disable()
+{
+   /* Unlink the models from the tree */
+   std::vector<Model3d*> models;
+   if(root != NULL_NODE)
+   {
+      collectLeaves(root, models);
+   }
+   for(size_t i = 0; i < models.size(); i++)
+   {
+      models[i]->sceneIndexNode = NULL_NODE;
+   }
+
+   nodes.clear();
+   root = NULL_NODE;
+   freeList = NULL_NODE;
+   totalModels = 0;
+   enabled = false;
+}
+
+/***********************************************************************
+ *                             getHeight                               *
+ ***********************************************************************/
+const int SceneIndex::getHeight()
+{
+   return (root != NULL_NODE) ? nodes[root].height : 0;
+}
+
+/***********************************************************************
+ *                                update                               *
+ ***********************************************************************/
+void SceneIndex::update(Model3d* model, const Ogre::AxisAlignedBox& bounds)
+{
+   if(!enabled)
+   {
+      return;
+   }
+   if(!bounds.isFinite())
+   {
+      /* Without bounds (or infinite ones), it can't be found by regions */
+      remove(model);
+      return;
+   }
+
+   const Ogre::Vector3& bMin = bounds.getMinimum();
+   const Ogre::Vector3& bMax = bounds.getMaximum();
+   Ogre::int32 leaf = model->sceneIndexNode;
+   if(leaf != NULL_NODE)
+   {
+      /* Still inside its fat bounds: nothing to do */
+      const Node& n = nodes[leaf];
+      if((n.min.x <= bMin.x) && (n.min.y <= bMin.y) &&
+         (n.min.z <= bMin.z) && (n.max.x >= bMax.x) &&
+         (n.max.y >= bMax.y) && (n.max.z >= bMax.z))
+      {
+         return;
+      }
+      removeLeaf(leaf);
+   }
+   else
+   {
+      leaf = allocateNode();
+      nodes[leaf].model = model;
+      model->sceneIndexNode = leaf;
+      totalModels++;
+   }
+
+   Ogre::Vector3 fat(margin, margin, margin);
+   nodes[leaf].min = bMin - fat;
+   nodes[leaf].max = bMax + fat;
+   insertLeaf(leaf);
+}
+
+/***********************************************************************
+ *                                remove                               *
+ ***********************************************************************/
+void SceneIndex::remove(Model3d* model)
+{
+   Ogre::int32 leaf = model->sceneIndexNode;
+   if(leaf == NULL_NODE)
+   {
+      return;
+   }
+
+   removeLeaf(leaf);
+   freeNode(leaf);
+   model->sceneIndexNode = NULL_NODE;
+   totalModels--;
+}
+
+/***********************************************************************
+ *                             allocateNode                            *
+ ***********************************************************************/
+Ogre::int32 SceneIndex::allocateNode()
+{
+   Ogre::int32 index;
+   if(freeList != NULL_NODE)
+   {
+      index = freeList;
+      freeList = nodes[index].parent;
+   }
+   else
+   {
+      index = (Ogre::int32) nodes.size();
+      nodes.push_back(Node());
+   }
+
+   Node& n = nodes[index];
+   n.parent = NULL_NODE;
+   n.child[0] = NULL_NODE;
+   n.child[1] = NULL_NODE;
+   n.height = 0;
+   n.model = NULL;
+
+   return index;
+}
+
+/***********************************************************************
+ *                               freeNode                              *
+ ***********************************************************************/
+void SceneIndex::freeNode(Ogre::int32 index)
+{
+   nodes[index].parent = freeList;
+   nodes[index].height = -1;
+   nodes[index].model = NULL;
+   freeList = index;
+}
+
+/***********************************************************************
+ *                              insertLeaf                             *
+ ***********************************************************************/
+void SceneIndex::insertLeaf(Ogre::int32 leaf)
+{
+   if(root == NULL_NODE)
+   {
+      root = leaf;
+      nodes[root].parent = NULL_NODE;
+      return;
+   }
+
+   /* Find the best sibling: descend while creating the new parent lower
+    * is cheaper (its area plus the area increased at its ancestors) */
+   const Ogre::Vector3 lMin = nodes[leaf].min;
+   const Ogre::Vector3 lMax = nodes[leaf].max;
+   Ogre::int32 index = root;
+   while(!nodes[index].isLeaf())
+   {
+      const Node& n = nodes[index];
+      Ogre::Real area = surfaceArea(n.min, n.max);
+      Ogre::Real combined = unionArea(n.min, n.max, lMin, lMax);
+
+      /* Cost of a new parent for this node and the leaf */
+      Ogre::Real cost = 2.0f * combined;
+      /* Minimum cost of pushing the leaf further down */
+      Ogre::Real inheritance = 2.0f * (combined - area);
+
+      Ogre::Real childCost[2];
+      for(int c = 0; c < 2; c++)
+      {
+         const Node& child = nodes[n.child[c]];
+         childCost[c] = unionArea(child.min, child.max, lMin, lMax) +
+            inheritance;
+         if(!child.isLeaf())
+         {
+            childCost[c] -= surfaceArea(child.min, child.max);
+         }
+      }
+
+      if((cost < childCost[0]) && (cost < childCost[1]))
+      {
+         break;
+      }
+      index = (childCost[0] <= childCost[1]) ? n.child[0] : n.child[1];
+   }
+   Ogre::int32 sibling = index;
+
+   /* Create a new parent for the sibling and the leaf */
+   Ogre::int32 oldParent = nodes[sibling].parent;
+   Ogre::int32 newParent = allocateNode();
+   Node& p = nodes[newParent];
+   p.parent = oldParent;
+   p.child[0] = sibling;
+   p.child[1] = leaf;
+   p.min = nodes[sibling].min;
+   p.max = nodes[sibling].max;
+   p.min.makeFloor(lMin);
+   p.max.makeCeil(lMax);
+   p.height = nodes[sibling].height + 1;
+   nodes[sibling].parent = newParent;
+   nodes[leaf].parent = newParent;
+
+   if(oldParent != NULL_NODE)
+   {
+      Node& op = nodes[oldParent];
+      op.child[(op.child[0] == sibling) ? 0 : 1] = newParent;
+   }
+   else
+   {
+      root = newParent;
+   }
+
+   refit(oldParent);
+}
+
+/***********************************************************************
+ *                              removeLeaf                             *
+ ***********************************************************************/
+void SceneIndex::removeLeaf(Ogre::int32 leaf)
+{
+   if(leaf == root)
+   {
+      root = NULL_NODE;
+      return;
+   }
+
+   /* Replace its parent by its sibling */
+   Ogre::int32 parent = nodes[leaf].parent;
+   Ogre::int32 grandParent = nodes[parent].parent;
+   Ogre::int32 sibling = (nodes[parent].child[0] == leaf) ?
+      nodes[parent].child[1] : nodes[parent].child[0];
+
+   nodes[sibling].parent = grandParent;
+   if(grandParent != NULL_NODE)
+   {
+      Node& gp = nodes[grandParent];
+      gp.child[(gp.child[0] == parent) ? 0 : 1] = sibling;
+   }
+   else
+   {
+      root = sibling;
+   }
+   freeNode(parent);
+   nodes[leaf].parent = NULL_NODE;
+
+   refit(grandParent);
+}
+
+/***********************************************************************
+ *                                refit                                *
+ ***********************************************************************/
+void SceneIndex::refit(Ogre::int32 index)
+{
+   while(index != NULL_NODE)
+   {
+      index = balance(index);
+
+      Node& n = nodes[index];
+      const Node& c0 = nodes[n.child[0]];
+      const Node& c1 = nodes[n.child[1]];
+      n.height = 1 + std::max(c0.height, c1.height);
+      n.min = c0.min;
+      n.max = c0.max;
+      n.min.makeFloor(c1.min);
+      n.max.makeCeil(c1.max);
+
+      index = n.parent;
+   }
+}
+
+/***********************************************************************
+ *                               balance                               *
+ ***********************************************************************/
+Ogre::int32 SceneIndex::balance(Ogre::int32 iA)
+{
+   Node& a = nodes[iA];
+   if((a.isLeaf()) || (a.height < 2))
+   {
+      return iA;
+   }
+
+   Ogre::int32 iB = a.child[0];
+   Ogre::int32 iC = a.child[1];
+   Node& b = nodes[iB];
+   Node& c = nodes[iC];
+   int diff = c.height - b.height;
+
+   /* Rotate the highest child up: it takes a place, which takes the
+    * place of the child's lowest child. */
+   int up;
+   if(diff > 1)
+   {
+      up = 1;
+   }
+   else if(diff < -1)
+   {
+      up = 0;
+   }
+   else
+   {
+      return iA;
+   }
+   Ogre::int32 iUp = a.child[up];
+   Ogre::int32 iOther = a.child[1 - up];
+   Node& u = nodes[iUp];
+   Node& other = nodes[iOther];
+   Ogre::int32 iF = u.child[0];
+   Ogre::int32 iG = u.child[1];
+   Node& f = nodes[iF];
+   Node& g = nodes[iG];
+
+   /* The child goes to a's place */
+   u.parent = a.parent;
+   a.parent = iUp;
+   if(u.parent != NULL_NODE)
+   {
+      Node& p = nodes[u.parent];
+      p.child[(p.child[0] == iA) ? 0 : 1] = iUp;
+   }
+   else
+   {
+      root = iUp;
+   }
+
+   /* Its highest child stays with it, the lowest goes to a */
+   Ogre::int32 iKeep = (f.height > g.height) ? iF : iG;
+   Ogre::int32 iGive = (f.height > g.height) ? iG : iF;
+   Node& keep = nodes[iKeep];
+   Node& give = nodes[iGive];
+   u.child[0] = iA;
+   u.child[1] = iKeep;
+   a.child[up] = iGive;
+   give.parent = iA;
+
+   a.min = other.min;
+   a.max = other.max;
+   a.min.makeFloor(give.min);
+   a.max.makeCeil(give.max);
+   a.height = 1 + std::max(other.height, give.height);
+
+   u.min = a.min;
+   u.max = a.max;
+   u.min.makeFloor(keep.min);
+   u.max.makeCeil(keep.max);
+   u.height = 1 + std::max(a.height, keep.height);
+
+   return iUp;
+}
+
+/***********************************************************************
+ *                            collectLeaves                            *
+ ***********************************************************************/
+void SceneIndex::collectLeaves(Ogre::int32 index,
+      std::vector<Model3d*>& result)
+{
+   if(nodes[index].isLeaf())
+   {
+      result.push_back(nodes[index].model);
+      return;
+   }
+   collectLeaves(nodes[index].child[0], result);
+   collectLeaves(nodes[index].child[1], result);
+}
+
+/***********************************************************************
+ *                               traverse                              *
+ ***********************************************************************/
+template<class T> size_t SceneIndex::traverse(const T& test,
+      std::vector<Model3d*>& result)
+{
+   if(root == NULL_NODE)
+   {
+      return 0;
+   }
+
+   size_t prevSize = result.size();
+   std::vector<Ogre::int32> stack;
+   stack.reserve(SCENE_INDEX_STACK_SIZE);
+   stack.push_back(root);
+   while(!stack.empty())
+   {
+      const Node& n = nodes[stack.back()];
+      stack.pop_back();
+      if(!test(n.min, n.max))
+      {
+         continue;
+      }
+      if(n.isLeaf())
+      {
+         result.push_back(n.model);
+      }
+      else
+      {
+         stack.push_back(n.child[0]);
+         stack.push_back(n.child[1]);
+      }
+   }
+
+   return result.size() - prevSize;
+}
+
+/***********************************************************************
+ *                                query                                *
+ ***********************************************************************/
+size_t SceneIndex::query(const Ogre::AxisAlignedBox& box,
+      std::vector<Model3d*>& result)
+{
+   if(box.isNull())
+   {
+      return 0;
+   }
+   if(box.isInfinite())
+   {
+      size_t prevSize = result.size();
+      if(root != NULL_NODE)
+      {
+         collectLeaves(root, result);
+      }
+      return result.size() - prevSize;
+   }
+   return traverse(SceneIndexBoxTest(box), result);
+}
+
+/***********************************************************************
+ *                                query                                *
+ ***********************************************************************/
+size_t SceneIndex::query(const Ogre::Sphere& sphere,
+      std::vector<Model3d*>& result)
+{
+   return traverse(SceneIndexSphereTest(sphere), result);
+}
+
+/***********************************************************************
+ *                                query                                *
+ ***********************************************************************/
+size_t SceneIndex::query(const Ogre::Ray& ray,
+      std::vector<Model3d*>& result, Ogre::Real maxDistance)
+{
+   return traverse(SceneIndexRayTest(ray, maxDistance), result);
+}
+
+/***********************************************************************
+ *                                query                                *
+ ***********************************************************************/
+size_t SceneIndex::query(const Ogre::Frustum& frustum,
+      std::vector<Model3d*>& result)
+{
+   if(root == NULL_NODE)
+   {
+      return 0;
+   }
+
+   const Ogre::Plane* planes = frustum.getFrustumPlanes();
+   /* An infinite far clip distance means no far plane */
+   bool infiniteFar = (frustum.getFarClipDistance() == 0);
+
+   size_t prevSize = result.size();
+   std::vector<Ogre::int32> stack;
+   stack.reserve(SCENE_INDEX_STACK_SIZE);
+   stack.push_back(root);
+   while(!stack.empty())
+   {
+      Ogre::int32 index = stack.back();
+      const Node& n = nodes[index];
+      stack.pop_back();
+
+      Ogre::Vector3 center = (n.min + n.max) * 0.5f;
+      Ogre::Vector3 halfSize = (n.max - n.min) * 0.5f;
+      bool outside = false;
+      bool inside = true;
+      for(int p = 0; p < 6; p++)
+      {
+         if((p == Ogre::FRUSTUM_PLANE_FAR) && (infiniteFar))
+         {
+            continue;
+         }
+         Ogre::Plane::Side side = planes[p].getSide(center, halfSize);
+         if(side == Ogre::Plane::NEGATIVE_SIDE)
+         {
+            outside = true;
+            break;
+         }
+         else if(side == Ogre::Plane::BOTH_SIDE)
+         {
+            inside = false;
+         }
+      }
+
+      if(outside)
+      {
+         continue;
+      }
+      if((inside) || (n.isLeaf()))
+      {
+         /* All of its subtree is visible */
+         collectLeaves(index, result);
+      }
+      else
+      {
+         stack.push_back(n.child[0]);
+         stack.push_back(n.child[1]);
+      }
+   }
+
+   return result.size() - prevSize;
+}
+
+/***********************************************************************
+ *                            static members                           *
+ ***********************************************************************/
+std::vector<SceneIndex::Node> SceneIndex::nodes;
+Ogre::int32 SceneIndex::root = SceneIndex::NULL_NODE;
+Ogre::int32 SceneIndex::freeList = SceneIndex::NULL_NODE;
+size_t SceneIndex::totalModels = 0;
+Ogre::Real SceneIndex::margin = SCENE_INDEX_DEFAULT_MARGIN;
+bool SceneIndex::enabled = false;
+
@@ -0,0 +1,165 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_scene_index_h
+#define _goblin_scene_index_h
+
+#include <OGRE/OgrePrerequisites.h>
+#include <OGRE/OgreVector3.h>
+#include <OGRE/OgreAxisAlignedBox.h>
+#include <OGRE/OgreSphere.h>
+#include <OGRE/OgreRay.h>
+#include <OGRE/OgreFrustum.h>
+#include <OGRE/OgreMath.h>
+
+#include <vector>
+
+/*! Default margin added to each side of the indexed model bounds */
+#define SCENE_INDEX_DEFAULT_MARGIN   0.5f
+
+namespace Goblin
+{
+
+class Model3d;
+
+/*! An index of all Model3d of the scene, to find the ones at a region
+ * without checking each of them. It's a dynamic AABB tree over the models
+ * world bounds, fattened by a margin, so models moving a bit (inside its
+ * fat bounds) don't change the tree.
+ * \note the index is optional: when enabled (with #enable), models are
+ *       registered on load and updated when their nodes change (on
+ *       Model3d::update, the 'Now' setters and Model3d::notifyStaticDirty).
+ *       Models with a parent model aren't updated when just the parent
+ *       moves.
+ * \note not thread safe: only change or query it from the main thread. */
+class SceneIndex
+{
+   public:
+      /*! Enable the index. Models already loaded are added as soon as
+       * they are updated (see Model3d::updateSceneIndex).
+       * \param margin margin added to each side of the model bounds.
+       *        Bigger values means less tree changes for moving models,
+       *        but more false positives to the queries. */
+      static void enable(Ogre::Real margin=SCENE_INDEX_DEFAULT_MARGIN);
+      /*! Disable the index, removing all models from it */
+      static void disable();
+      /*! \return if the index is enabled */
+      static const bool isEnabled() { return enabled; };
+
+      /*! Add a model to the index or, if already there, update its bounds.
+       * \note its tree node is only changed if the bounds got out of its
+       *       fat bounds.
+       * \param model the model
+       * \param bounds its current world bounds */
+      static void update(Model3d* model, const Ogre::AxisAlignedBox& bounds);
+      /*! Remove a model from the index, if there */
+      static void remove(Model3d* model);
+
+      /*! Get the models whose bounds overlap a box.
+       * \param box box to test, in world space
+       * \param result vector to receive the models (appended to it, in no
+       *        particular order).
+       * \note as the tree keeps fat bounds, some models could be just near
+       *       the box. Check their bounds (or meshes) when exact results
+       *       are needed. The same for all queries.
+       * \return number of models found */
+      static size_t query(const Ogre::AxisAlignedBox& box,
+            std::vector<Model3d*>& result);
+      /*! Get the models whose bounds overlap a sphere (see box #query) */
+      static size_t query(const Ogre::Sphere& sphere,
+            std::vector<Model3d*>& result);
+      /*! Get the models whose bounds are hit by a ray (see box #query),
+       * like the candidates for picking (see Model3d::rayIntersect).
+       * \param maxDistance ignore bounds farther than it from the ray
+       *        origin (in ray direction units). */
+      static size_t query(const Ogre::Ray& ray,
+            std::vector<Model3d*>& result,
+            Ogre::Real maxDistance=Ogre::Math::POS_INFINITY);
+      /*! Get the models whose bounds are inside (or partially inside) a
+       * frustum (see box #query). Subtrees fully inside it are got
+       * without further tests.
+       * \param frustum frustum to test (like the Camera::getOgreCamera) */
+      static size_t query(const Ogre::Frustum& frustum,
+            std::vector<Model3d*>& result);
+
+      /*! \return number of models at the index */
+      static const size_t getTotalModels() { return totalModels; };
+      /*! \return current tree height (0 for a single or no model) */
+      static const int getHeight();
+
+   private:
+      /*! A tree node */
+      class Node
+      {
+         public:
+            /*! \return if the node is a leaf (a model) */
+            const bool isLeaf() const { return child[0] == NULL_NODE; };
+
+            Ogre::Vector3 min;    /**< Bounds minimum (fat on leaves) */
+            Ogre::Vector3 max;    /**< Bounds maximum (fat on leaves) */
+            /*! Parent node, or next free node when not used */
+            Ogre::int32 parent;
+            Ogre::int32 child[2]; /**< Children (NULL_NODE on leaves) */
+            Ogre::int32 height;   /**< Height of the subtree (leaf = 0) */
+            Model3d* model;       /**< Model of a leaf */
+      };
+
+      /*! Index of no node */
+      static const Ogre::int32 NULL_NODE = -1;
+
+      /*! Get a free node, growing the pool if needed */
+      static Ogre::int32 allocateNode();
+      /*! Put a node back to the free list */
+      static void freeNode(Ogre::int32 index);
+
+      /*! Insert a leaf, as sibling of the node that less increases the
+       * tree surface area. */
+      static void insertLeaf(Ogre::int32 leaf);
+      /*! Remove a leaf (and its parent) from the tree */
+      static void removeLeaf(Ogre::int32 leaf);
+      /*! Rotate a node with the child of its highest child, if it's
+       * unbalanced.
+       * \return the node now at the index position */
+      static Ogre::int32 balance(Ogre::int32 index);
+      /*! Refit the bounds and heights from a node up to the root,
+       * balancing them */
+      static void refit(Ogre::int32 index);
+
+      /*! Append the models of all leaves of a subtree */
+      static void collectLeaves(Ogre::int32 index,
+            std::vector<Model3d*>& result);
+      /*! Get the models of the leaves that pass a test, not descending
+       * the nodes that fail it.
+       * \param test functor telling if a node bounds (min, max) pass */
+      template<class T> static size_t traverse(const T& test,
+            std::vector<Model3d*>& result);
+
+      static std::vector<Node> nodes; /**< Node pool */
+      static Ogre::int32 root;        /**< Root node */
+      static Ogre::int32 freeList;    /**< First free node */
+      static size_t totalModels;      /**< Models at the tree */
+      static Ogre::Real margin;       /**< Fat bounds margin */
+      static bool enabled;            /**< If the index is enabled */
+};
+
+}
+
+#endif
+
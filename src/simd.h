@@ -0,0 +1,507 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_simd_h
+#define _goblin_simd_h
+
+/* Internal header: thin 4-wide float wrappers over SSE2 or NEON (with a
+ * plain C fallback), used by Goblin's vectorized kernels. The instruction
+ * set is selected at compile time; wider paths (AVX2) live on their own
+ * translation units and are selected at runtime by #Simd::hasAvx2. */
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   #define GOBLIN_SIMD_SSE2 1
+   #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+   #define GOBLIN_SIMD_NEON 1
+   #include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+   #include <intrin.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+namespace Goblin
+{
+namespace Simd
+{
+
+#if defined(GOBLIN_SIMD_SSE2)
+
+   typedef __m128 Float4; /**< 4 floats */
+   typedef __m128 Mask4;  /**< 4 lanes mask (all bits set when true) */
+
+   inline Float4 load(const float* p) { return _mm_loadu_ps(p); }
+   inline void store(float* p, Float4 a) { _mm_storeu_ps(p, a); }
+   inline Float4 set1(float v) { return _mm_set1_ps(v); }
+   inline Float4 set(float a, float b, float c, float d)
+   {
+      return _mm_setr_ps(a, b, c, d);
+   }
+   inline Float4 zero() { return _mm_setzero_ps(); }
+
+   inline Float4 add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+   inline Float4 sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+   inline Float4 mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+   inline Float4 div(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+   inline Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a); }
+   inline Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+   inline Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+   inline Float4 abs(Float4 a)
+   {
+      return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+   }
+
+   inline Mask4 cmpLt(Float4 a, Float4 b) { return _mm_cmplt_ps(a, b); }
+   inline Mask4 cmpLe(Float4 a, Float4 b) { return _mm_cmple_ps(a, b); }
+   inline Mask4 cmpGt(Float4 a, Float4 b) { return _mm_cmpgt_ps(a, b); }
+   inline Mask4 cmpGe(Float4 a, Float4 b) { return _mm_cmpge_ps(a, b); }
+   inline Mask4 maskAnd(Mask4 a, Mask4 b) { return _mm_and_ps(a, b); }
+   inline Mask4 maskOr(Mask4 a, Mask4 b) { return _mm_or_ps(a, b); }
+   inline Mask4 maskAndNot(Mask4 a, Mask4 b) { return _mm_andnot_ps(b, a); }
+
+   /*! \return mask ? a : b, per lane */
+   inline Float4 select(Mask4 mask, Float4 a, Float4 b)
+   {
+      return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+   }
+   /*! \return bit i set if lane i of mask is true */
+   inline int moveMask(Mask4 mask) { return _mm_movemask_ps(mask); }
+
+#elif defined(GOBLIN_SIMD_NEON)
+
+   typedef float32x4_t Float4;
+   typedef uint32x4_t Mask4;
+
+   inline Float4 load(const float* p) { return vld1q_f32(p); }
+   inline void store(float* p, Float4 a) { vst1q_f32(p, a); }
+   inline Float4 set1(float v) { return vdupq_n_f32(v); }
+   inline Float4 set(float a, float b, float c, float d)
+   {
+      const float v[4] = {a, b, c, d};
+      return vld1q_f32(v);
+   }
+   inline Float4 zero() { return vdupq_n_f32(0.0f); }
+
+   inline Float4 add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+   inline Float4 sub(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+   inline Float4 mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+#if defined(__aarch64__)
+   inline Float4 div(Float4 a, Float4 b) { return vdivq_f32(a, b); }
+   inline Float4 sqrt(Float4 a) { return vsqrtq_f32(a); }
+#else
+   inline Float4 div(Float4 a, Float4 b)
+   {
+      /* Reciprocal estimate, with two Newton-Raphson refinements */
+      float32x4_t r = vrecpeq_f32(b);
+      r = vmulq_f32(vrecpsq_f32(b, r), r);
+      r = vmulq_f32(vrecpsq_f32(b, r), r);
+      return vmulq_f32(a, r);
+   }
+   inline Float4 sqrt(Float4 a)
+   {
+      float32x4_t r = vrsqrteq_f32(a);
+      r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+      r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a, r), r), r);
+      /* sqrt(0) = 0 (and not 0 * inf) */
+      uint32x4_t isZero = vceqq_f32(a, vdupq_n_f32(0.0f));
+      return vbslq_f32(isZero, a, vmulq_f32(a, r));
+   }
+#endif
+   inline Float4 min(Float4 a, Float4 b) { return vminq_f32(a, b); }
+   inline Float4 max(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+   inline Float4 abs(Float4 a) { return vabsq_f32(a); }
+
+   inline Mask4 cmpLt(Float4 a, Float4 b) { return vcltq_f32(a, b); }
+   inline Mask4 cmpLe(Float4 a, Float4 b) { return vcleq_f32(a, b); }
+   inline Mask4 cmpGt(Float4 a, Float4 b) { return vcgtq_f32(a, b); }
+   inline Mask4 cmpGe(Float4 a, Float4 b) { return vcgeq_f32(a, b); }
+   inline Mask4 maskAnd(Mask4 a, Mask4 b) { return vandq_u32(a, b); }
+   inline Mask4 maskOr(Mask4 a, Mask4 b) { return vorrq_u32(a, b); }
+   inline Mask4 maskAndNot(Mask4 a, Mask4 b) { return vbicq_u32(a, b); }
+
+   inline Float4 select(Mask4 mask, Float4 a, Float4 b)
+   {
+      return vbslq_f32(mask, a, b);
+   }
+   inline int moveMask(Mask4 mask)
+   {
+      uint32_t m[4];
+      vst1q_u32(m, mask);
+      return (m[0] & 1) | ((m[1] & 1) << 1) | ((m[2] & 1) << 2) |
+             ((m[3] & 1) << 3);
+   }
+
+#else
+
+   /* Plain C fallback: same semantics, one lane at a time. */
+   class Float4
+   {
+      public:
+         float v[4];
+   };
+   typedef Float4 Mask4;
+
+   inline Float4 load(const float* p) { Float4 r; memcpy(r.v, p, 16);
+                                        return r; }
+   inline void store(float* p, Float4 a) { memcpy(p, a.v, 16); }
+   inline Float4 set(float a, float b, float c, float d)
+   {
+      Float4 r;
+      r.v[0] = a; r.v[1] = b; r.v[2] = c; r.v[3] = d;
+      return r;
+   }
+   inline Float4 set1(float v) { return set(v, v, v, v); }
+   inline Float4 zero() { return set1(0.0f); }
+
+   #define GOBLIN_SIMD_LANES(expr) \
+      Float4 r; for(int i = 0; i < 4; i++) { r.v[i] = (expr); } return r;
+   #define GOBLIN_SIMD_MASK(cond) \
+      Float4 r; for(int i = 0; i < 4; i++) \
+      { unsigned int m = (cond) ? 0xFFFFFFFFu : 0u; memcpy(&r.v[i], &m, 4); }\
+      return r;
+   #define GOBLIN_SIMD_BITS(op) \
+      Float4 r; for(int i = 0; i < 4; i++) \
+      { unsigned int x, y; memcpy(&x, &a.v[i], 4); memcpy(&y, &b.v[i], 4); \
+        x = op; memcpy(&r.v[i], &x, 4); } \
+      return r;
+
+   inline Float4 add(Float4 a, Float4 b) { GOBLIN_SIMD_LANES(a.v[i]+b.v[i]) }
+   inline Float4 sub(Float4 a, Float4 b) { GOBLIN_SIMD_LANES(a.v[i]-b.v[i]) }
+   inline Float4 mul(Float4 a, Float4 b) { GOBLIN_SIMD_LANES(a.v[i]*b.v[i]) }
+   inline Float4 div(Float4 a, Float4 b) { GOBLIN_SIMD_LANES(a.v[i]/b.v[i]) }
+   inline Float4 sqrt(Float4 a) { GOBLIN_SIMD_LANES(::sqrtf(a.v[i])) }
+   inline Float4 min(Float4 a, Float4 b)
+   {
+      GOBLIN_SIMD_LANES((a.v[i] < b.v[i]) ? a.v[i] : b.v[i])
+   }
+   inline Float4 max(Float4 a, Float4 b)
+   {
+      GOBLIN_SIMD_LANES((a.v[i] > b.v[i]) ? a.v[i] : b.v[i])
+   }
+   inline Float4 abs(Float4 a) { GOBLIN_SIMD_LANES(::fabsf(a.v[i])) }
+
+   inline Mask4 cmpLt(Float4 a, Float4 b) { GOBLIN_SIMD_MASK(a.v[i]<b.v[i]) }
+   inline Mask4 cmpLe(Float4 a, Float4 b) { GOBLIN_SIMD_MASK(a.v[i]<=b.v[i])}
+   inline Mask4 cmpGt(Float4 a, Float4 b) { GOBLIN_SIMD_MASK(a.v[i]>b.v[i]) }
+   inline Mask4 cmpGe(Float4 a, Float4 b) { GOBLIN_SIMD_MASK(a.v[i]>=b.v[i])}
+   inline Mask4 maskAnd(Mask4 a, Mask4 b) { GOBLIN_SIMD_BITS(x & y) }
+   inline Mask4 maskOr(Mask4 a, Mask4 b) { GOBLIN_SIMD_BITS(x | y) }
+   inline Mask4 maskAndNot(Mask4 a, Mask4 b) { GOBLIN_SIMD_BITS(x & ~y) }
+
+   inline Float4 select(Mask4 mask, Float4 a, Float4 b)
+   {
+      Float4 r;
+      for(int i = 0; i < 4; i++)
+      {
+         unsigned int m;
+         memcpy(&m, &mask.v[i], 4);
+         r.v[i] = (m) ? a.v[i] : b.v[i];
+      }
+      return r;
+   }
+   inline int moveMask(Mask4 mask)
+   {
+      int res = 0;
+      for(int i = 0; i < 4; i++)
+      {
+         unsigned int m;
+         memcpy(&m, &mask.v[i], 4);
+         res |= (m >> 31) << i;
+      }
+      return res;
+   }
+
+   #undef GOBLIN_SIMD_LANES
+   #undef GOBLIN_SIMD_MASK
+   #undef GOBLIN_SIMD_BITS
+
+#endif
+
+   /*! Multiply-add: a * b + c */
+   inline Float4 madd(Float4 a, Float4 b, Float4 c)
+   {
+      return add(mul(a, b), c);
+   }
+
+   /*! 3 component dot product of 4 SoA vectors at once */
+   inline Float4 dot3(Float4 ax, Float4 ay, Float4 az,
+                      Float4 bx, Float4 by, Float4 bz)
+   {
+      return madd(ax, bx, madd(ay, by, mul(az, bz)));
+   }
+
+   /*! 3 component cross product of 4 SoA vectors at once */
+   inline void cross3(Float4 ax, Float4 ay, Float4 az,
+                      Float4 bx, Float4 by, Float4 bz,
+                      Float4& rx, Float4& ry, Float4& rz)
+   {
+      rx = sub(mul(ay, bz), mul(az, by));
+      ry = sub(mul(az, bx), mul(ax, bz));
+      rz = sub(mul(ax, by), mul(ay, bx));
+   }
+
+   /*! Transpose a 4x4 matrix whose rows are r0..r3 */
+   inline void transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+   {
+#if defined(GOBLIN_SIMD_SSE2)
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+#else
+      float m[16];
+      store(m, r0); store(m + 4, r1); store(m + 8, r2); store(m + 12, r3);
+      r0 = set(m[0], m[4], m[8], m[12]);
+      r1 = set(m[1], m[5], m[9], m[13]);
+      r2 = set(m[2], m[6], m[10], m[14]);
+      r3 = set(m[3], m[7], m[11], m[15]);
+#endif
+   }
+
+   /*! Scalar float to half float, rounding to nearest even (the same
+    * results of the vectorized #storeHalf4). */
+   inline unsigned short floatToHalf(float value)
+   {
+      unsigned int f;
+      memcpy(&f, &value, 4);
+      unsigned int sign = (f >> 16) & 0x8000;
+      f &= 0x7FFFFFFF;
+
+      unsigned int h;
+      if(f >= 0x47800000)
+      {
+         /* Overflow to infinity, or NaN (keeping it a quiet one) */
+         h = (f > 0x7F800000) ? 0x7E00 : 0x7C00;
+      }
+      else if(f < 0x38800000)
+      {
+         /* Subnormal (or zero): let the FPU round it for us */
+         float magic;
+         unsigned int m = 0x3F000000; /* 0.5f */
+         memcpy(&magic, &m, 4);
+         float absValue;
+         memcpy(&absValue, &f, 4);
+         absValue += magic;
+         memcpy(&h, &absValue, 4);
+         h -= m;
+      }
+      else
+      {
+         unsigned int mantOdd = (f >> 13) & 1;
+         f += 0xC8000FFF + mantOdd; /* rebias exponent and round */
+         h = f >> 13;
+      }
+      return (unsigned short)(h | sign);
+   }
+
+   /*! Scalar half float to float */
+   inline float halfToFloat(unsigned short value)
+   {
+      unsigned int sign = ((unsigned int)(value & 0x8000)) << 16;
+      unsigned int expMant = value & 0x7FFF;
+      unsigned int f = expMant << 13;
+      float res;
+      if(expMant >= 0x7C00)
+      {
+         /* Inf or NaN */
+         f |= 0x7F800000;
+         memcpy(&res, &f, 4);
+      }
+      else
+      {
+         /* Rebias (and normalise subnormals) with a multiply */
+         float magic;
+         unsigned int m = (254 - 15) << 23;
+         memcpy(&magic, &m, 4);
+         memcpy(&res, &f, 4);
+         res *= magic;
+      }
+      unsigned int r;
+      memcpy(&r, &res, 4);
+      r |= sign;
+      memcpy(&res, &r, 4);
+      return res;
+   }
+
+   /*! Scalar float to signed normalized 16 bits integer */
+   inline short floatToSnorm16(float value)
+   {
+      value = (value > 1.0f) ? 1.0f : ((value < -1.0f) ? -1.0f : value);
+      return (short)lrintf(value * 32767.0f);
+   }
+
+   /*! Scalar signed normalized 16 bits integer to float */
+   inline float snorm16ToFloat(short value)
+   {
+      float res = value / 32767.0f;
+      return (res < -1.0f) ? -1.0f : res;
+   }
+
+   /*! Load 4 half floats */
+   inline Float4 loadHalf4(const unsigned short* p)
+   {
+#if defined(GOBLIN_SIMD_SSE2)
+      __m128i h = _mm_unpacklo_epi16(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), 
+            _mm_setzero_si128());
+      __m128i expMant = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+      __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(
+               _mm_slli_epi32(expMant, 13)), 
+            _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+      __m128i wasInfNan = _mm_cmpgt_epi32(expMant, _mm_set1_epi32(0x7BFF));
+      __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, expMant), 16);
+      __m128 infNanExp = _mm_and_ps(_mm_castsi128_ps(wasInfNan),
+            _mm_castsi128_ps(_mm_set1_epi32(255 << 23)));
+      return _mm_or_ps(scaled, _mm_or_ps(_mm_castsi128_ps(sign), infNanExp));
+#elif defined(GOBLIN_SIMD_NEON) && defined(__aarch64__)
+      return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)));
+#else
+      return set(halfToFloat(p[0]), halfToFloat(p[1]), halfToFloat(p[2]),
+                 halfToFloat(p[3]));
+#endif
+   }
+
+   /*! Store 4 half floats (rounding to nearest even) */
+   inline void storeHalf4(unsigned short* p, Float4 f)
+   {
+#if defined(GOBLIN_SIMD_SSE2)
+      __m128 justSign = _mm_and_ps(f, _mm_castsi128_ps(
+               _mm_set1_epi32(0x80000000)));
+      __m128 absF = _mm_xor_ps(f, justSign);
+      __m128i absI = _mm_castps_si128(absF);
+      __m128 isNan = _mm_cmpunord_ps(absF, absF);
+      __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23),
+            absI);
+      __m128i infOrNan = _mm_or_si128(_mm_and_si128(_mm_castps_si128(isNan),
+               _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+      __m128i isSub = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), absI);
+
+      /* Subnormal results */
+      __m128i subMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+      __m128i sub = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, 
+                  _mm_castsi128_ps(subMagic))), subMagic);
+
+      /* Normal results */
+      __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absI, 31 - 13), 31);
+      __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absI,
+                  _mm_set1_epi32(0xFFF - ((127 - 15) << 23))), mantOdd), 13);
+
+      __m128i nonSpecial = _mm_or_si128(_mm_and_si128(sub, isSub),
+            _mm_andnot_si128(isSub, normal));
+      __m128i joined = _mm_or_si128(_mm_and_si128(nonSpecial, isRegular),
+            _mm_andnot_si128(isRegular, infOrNan));
+      __m128i res = _mm_or_si128(joined, _mm_srai_epi32(
+               _mm_castps_si128(justSign), 16));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(p), 
+            _mm_packs_epi32(res, res));
+#elif defined(GOBLIN_SIMD_NEON) && defined(__aarch64__)
+      vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(f)));
+#else
+      float v[4];
+      store(v, f);
+      for(int i = 0; i < 4; i++)
+      {
+         p[i] = floatToHalf(v[i]);
+      }
+#endif
+   }
+
+   /*! Load 4 signed normalized 16 bits integers */
+   inline Float4 loadSnorm16x4(const short* p)
+   {
+#if defined(GOBLIN_SIMD_SSE2)
+      __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+      v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), 
+               _mm_set1_ps(1.0f / 32767.0f)), _mm_set1_ps(-1.0f));
+#elif defined(GOBLIN_SIMD_NEON)
+      return vmaxq_f32(vmulq_f32(vcvtq_f32_s32(vmovl_s16(vld1_s16(p))),
+               vdupq_n_f32(1.0f / 32767.0f)), vdupq_n_f32(-1.0f));
+#else
+      return set(snorm16ToFloat(p[0]), snorm16ToFloat(p[1]), 
+                 snorm16ToFloat(p[2]), snorm16ToFloat(p[3]));
+#endif
+   }
+
+   /*! Store 4 signed normalized 16 bits integers (clamping to [-1, 1]) */
+   inline void storeSnorm16x4(short* p, Float4 f)
+   {
+      f = mul(min(max(f, set1(-1.0f)), set1(1.0f)), set1(32767.0f));
+#if defined(GOBLIN_SIMD_SSE2)
+      __m128i v = _mm_cvtps_epi32(f);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(v, v));
+#elif defined(GOBLIN_SIMD_NEON)
+   #if defined(__aarch64__)
+      int32x4_t v = vcvtnq_s32_f32(f);
+   #else
+      /* Round half away from zero (no round to nearest on ARMv7) */
+      float32x4_t half = vbslq_f32(vcltq_f32(f, vdupq_n_f32(0.0f)),
+            vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+      int32x4_t v = vcvtq_s32_f32(vaddq_f32(f, half));
+   #endif
+      vst1_s16(p, vqmovn_s32(v));
+#else
+      float v[4];
+      store(v, f);
+      for(int i = 0; i < 4; i++)
+      {
+         p[i] = (short)lrintf(v[i]);
+      }
+#endif
+   }
+
+   /*! \return if the running CPU supports AVX2, FMA and F16C instructions
+    * (always false on non x86 platforms). */
+   inline bool hasAvx2()
+   {
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+             && __builtin_cpu_supports("f16c");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      int info[4];
+      __cpuid(info, 0);
+      if(info[0] < 7)
+      {
+         return false;
+      }
+      __cpuid(info, 1);
+      bool osxsave = (info[2] & (1 << 27)) != 0;
+      bool fma = (info[2] & (1 << 12)) != 0;
+      bool f16c = (info[2] & (1 << 29)) != 0;
+      if((!osxsave) || (!fma) || (!f16c) || ((_xgetbv(0) & 0x6) != 0x6))
+      {
+         return false;
+      }
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+#else
+      return false;
+#endif
+   }
+
+}
+}
+
+#endif
+
@@ -20,9 +20,24 @@
 
 
 #include "vertexutils.h"
+#include "simd.h"
 
 #if OGRE_VERSION_MAJOR >= 2
 
+#include <OGRE/OgrePlatformInformation.h>
+#include <OGRE/OgreQuaternion.h>
+#include <OGRE/OgreMatrix3.h>
+#include <OGRE/Threading/OgreThreads.h>
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(GOBLIN_SIMD_AVX2)
+   #include "vertexutils_avx2.h"
+#endif
+
 using namespace Goblin;
 
 /***********************************************************************
@@ -34,101 +49,73 @@ void VertexUtils::generateTangents(float* vertexData, Ogre::uint16* indexData,
       Ogre::uint32 normalIndex, Ogre::uint32 tangentIndex, 
       Ogre::uint32 uvIndex)
 {
-   /* Create the calculation vector and positionate the second */
-	float* tan1 = new float[vertexCount * 2 * 3];
-	float* tan2 = &tan1[vertexCount * 3];
-
-   /* clear the calculation vector */
-   for(Ogre::uint32 i = 0; i < vertexCount * 2 * 3; i++)
-   {
-      tan1[i] = 0.0f;
-   }
-
-   /* First pass */
-	for(Ogre::uint32 i = 0; i <= indexCount - 3; i += 3)
-	{
-      /* Define vertex index */
-      Ogre::uint32 i1 = indexData[i];
-      Ogre::uint32 i2 = indexData[i + 1];
-      Ogre::uint32 i3 = indexData[i + 2];
-
-      /* Define position indexes */
-      float* pi1 = &vertexData[i1 * floatsPerVertex + posIndex];
-      float* pi2 = &vertexData[i2 * floatsPerVertex + posIndex];
-      float* pi3 = &vertexData[i3 * floatsPerVertex + posIndex];
-
-      /* Define texture indexes */
-      float* ti1 = &vertexData[i1 * floatsPerVertex + uvIndex];
-      float* ti2 = &vertexData[i2 * floatsPerVertex + uvIndex];
-      float* ti3 = &vertexData[i3 * floatsPerVertex + uvIndex];
-	
-      /* Calculate factors */
-		float x1 = pi2[0] - pi1[0];
-		float x2 = pi3[0] - pi1[0];
-		float y1 = pi2[1] - pi1[1];
-		float y2 = pi3[1] - pi1[1];
-		float z1 = pi2[2] - pi1[2];
-		float z2 = pi3[2] - pi1[2];
-		
-		float s1 = ti2[0] - ti1[0];
-		float s2 = ti3[0] - ti1[0];
-		float t1 = ti2[1] - ti1[1];
-		float t2 = ti3[1] - ti1[1];
-		
-		float r = 1.0F / (s1 * t2 - s2 * t1);
-		
-      Ogre::Vector3 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
-            (t2 * z1 - t1 * z2) * r);
-		Ogre::Vector3 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
-            (s1 * z2 - s2 * z1) * r);
-
-		tan1[(i1 * 3)] += sdir[0];
-		tan1[(i1 * 3) + 1] += sdir[1];
-		tan1[(i1 * 3) + 2] += sdir[2];
-
-		tan1[(i2 * 3)] += sdir[0];
-		tan1[(i2 * 3) + 1] += sdir[1];
-		tan1[(i2 * 3) + 2] += sdir[2];
-
-		tan1[(i3 * 3)] += sdir[0];
-		tan1[(i3 * 3) + 1] += sdir[1];
-		tan1[(i3 * 3) + 2] += sdir[2];
-
-		tan2[(i1 * 3)] += tdir[0];
-		tan2[(i1 * 3) + 1] += tdir[1];
-		tan2[(i1 * 3) + 2] += tdir[2];
-
-		tan2[(i2 * 3)] += tdir[0];
-		tan2[(i2 * 3) + 1] += tdir[1];
-		tan2[(i2 * 3) + 2] += tdir[2];
-
-		tan2[(i3 * 3)] += tdir[0];
-		tan2[(i3 * 3) + 1] += tdir[1];
-		tan2[(i3 * 3) + 2] += tdir[2];
-	}
-	
-   /* Second pass */
-	for(Ogre::uint32 i = 0; i < vertexCount; i++)
-	{
-      float* nor = &vertexData[i * floatsPerVertex + normalIndex];
-
-		Ogre::Vector3 n(nor[0], nor[1], nor[2]);
-		Ogre::Vector3 tu(tan1[(i * 3)], tan1[(i * 3) + 1], tan1[(i * 3) + 2]);
-		Ogre::Vector3 tv(tan2[(i * 3)], tan2[(i * 3) + 1], tan2[(i * 3) + 2]);
-
-      float* tan = &vertexData[i * floatsPerVertex + tangentIndex];
-		
-		/* Gram-Schmidt orthogonalize. */
-      Ogre::Vector3 tangent = (tu - n * n.dotProduct(tu)).normalisedCopy();
-      tan[0] = tangent.x; 
-      tan[1] = tangent.y; 
-      tan[2] = tangent.z; 
-		
-		/* Calculate handedness. */
-		tan[3] = n.crossProduct(tu).dotProduct(tv) < 0.0f ? -1.0f : 1.0f;
-	}
-	
-	delete[] tan1;
+   generateTangents<Ogre::uint16, VertexLayout>(vertexData, indexData, 
+         vertexCount, indexCount, VertexLayout(floatsPerVertex, posIndex,
+            normalIndex, tangentIndex, uvIndex));
+}
+
+/***********************************************************************
+ *                          generateTangents                           *
+ ***********************************************************************/
+void VertexUtils::generateTangents(float* vertexData, Ogre::uint32* indexData, 
+      Ogre::uint32 floatsPerVertex, Ogre::uint32 vertexCount, 
+      Ogre::uint32 indexCount, Ogre::uint32 posIndex, 
+      Ogre::uint32 normalIndex, Ogre::uint32 tangentIndex, 
+      Ogre::uint32 uvIndex)
+{
+   generateTangents<Ogre::uint32, VertexLayout>(vertexData, indexData, 
+         vertexCount, indexCount, VertexLayout(floatsPerVertex, posIndex,
+            normalIndex, tangentIndex, uvIndex));
+}
+
+/***********************************************************************
+ *                        calculateTriangleTanUV                       *
+ ***********************************************************************/
+bool VertexUtils::calculateTriangleTanUV(const uint8_t* vertexData, 
+      uint32_t i0, uint32_t i1, uint32_t i2, uint32_t bytesPerVertex, 
+      uint32_t posStride, uint32_t uvStride, Ogre::Vector3& tsU, 
+      Ogre::Vector3& tsV)
+{
+   using namespace Ogre;
+
+   /* Lengyel's Method, it is fast and simple. Also we don't need to 
+    * care about duplicating vertices due to parity discontinuities or 
+    * averaging tangents that are too different since the input assumes 3 
+    * vertices per triangle.*/
+   const uint32_t idx[3] = { i0, i1, i2 };
+   Vector3 const* RESTRICT_ALIAS vPos[3];
+   Vector2 const* RESTRICT_ALIAS uv[3];
+
+   for( int j=0; j<3; ++j )
+   {
+      vPos[j] = reinterpret_cast<Vector3 const* RESTRICT_ALIAS>(
+            vertexData + posStride + idx[j] * bytesPerVertex );
+      uv[j] = reinterpret_cast<Vector2 const* RESTRICT_ALIAS>(
+            vertexData + uvStride + idx[j] * bytesPerVertex );
+   }
+
+   const Vector2 deltaUV1 = *uv[1] - *uv[0];
+   const Vector2 deltaUV2 = *uv[2] - *uv[0];
+
+   const Real uvarea = deltaUV1.crossProduct(deltaUV2);
+   if( Math::RealEqual(uvarea, 0.0f) )
+   {
+      return false;
+   }
+
+   const Vector3 deltaPos1 = *vPos[1] - *vPos[0];
+   const Vector3 deltaPos2 = *vPos[2] - *vPos[0];
+
+   /* Normalise by uvarea */
+   const Real a =  deltaUV2.y / uvarea;
+   const Real b = -deltaUV1.y / uvarea;
+   const Real c = -deltaUV2.x / uvarea;
+   const Real d =  deltaUV1.x / uvarea;
+
+   tsU = (deltaPos1 * a) + (deltaPos2 * b);
+   tsV = (deltaPos1 * c) + (deltaPos2 * d);
+
+   return true;
 }
 
 /***********************************************************************
@@ -146,42 +133,11 @@ void VertexUtils::generateTanUV(const uint8_t* vertexData,
 
    for( ::uint32_t i=0; i<numIndices; i += 3 )
    {
-      /* Lengyel's Method, it is fast and simple. Also we don't need to 
-       * care about duplicating vertices due to parity discontinuities or 
-       * averaging tangents that are too different since the input assumes 3 
-       * vertices per triangle.*/
-      Vector3 const* RESTRICT_ALIAS vPos[3];
-      Vector2 const* RESTRICT_ALIAS uv[3];
-
-      for( int j=0; j<3; ++j )
-      {
-         vPos[j] = reinterpret_cast<Vector3 const* RESTRICT_ALIAS>(
-               vertexData + posStride + indexData[i+j] * bytesPerVertex );
-         uv[j] = reinterpret_cast<Vector2 const* RESTRICT_ALIAS>(
-               vertexData + uvStride + indexData[i+j] * bytesPerVertex );
-      }
-
-      const Vector2 deltaUV1 = *uv[1] - *uv[0];
-      const Vector2 deltaUV2 = *uv[2] - *uv[0];
-      const Vector3 deltaPos1 = *vPos[1] - *vPos[0];
-      const Vector3 deltaPos2 = *vPos[2] - *vPos[0];
-
-      /* face normal */
-      Vector3 tsN = deltaPos1.crossProduct(deltaPos2);
-      tsN.normalise();
-
-      const Real uvarea = deltaUV1.crossProduct(deltaUV2);
-      if( !Math::RealEqual(uvarea, 0.0f) )
+      Vector3 tsU, tsV;
+      if( calculateTriangleTanUV(vertexData, indexData[i], indexData[i+1],
+               indexData[i+2], bytesPerVertex, posStride, uvStride, 
+               tsU, tsV) )
       {
-         /* Normalise by uvarea */
-         const Real a =  deltaUV2.y / uvarea;
-         const Real b = -deltaUV1.y / uvarea;
-         const Real c = -deltaUV2.x / uvarea;
-         const Real d =  deltaUV1.x / uvarea;
-
-         const Vector3 tsU = (deltaPos1 * a) + (deltaPos2 * b);
-         const Vector3 tsV = (deltaPos1 * c) + (deltaPos2 * d);
-
          uint32_t idx = indexData[i+0];
          tsUs[idx] += tsU;
          tsVs[idx] += tsV;
@@ -204,22 +160,232 @@ void VertexUtils::generateTangentsMergeTUV(uint8_t *vertexData,
       uint32_t bytesPerVertex, uint32_t numVertices, uint32_t normalStride,
       uint32_t tangentStride, Ogre::Vector3* RESTRICT_ALIAS inOutUvBuffer, 
       size_t numThreads)
+{
+   generateTangentsMergeTUVRange(vertexData, bytesPerVertex, numVertices,
+         normalStride, tangentStride, inOutUvBuffer, numThreads, 
+         0, numVertices);
+}
+
+/***********************************************************************
+ *                    generateTangentsMergeUVRange                     *
+ ***********************************************************************/
+void VertexUtils::generateTangentsMergeTUVRange(uint8_t *vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, uint32_t normalStride,
+      uint32_t tangentStride, Ogre::Vector3* RESTRICT_ALIAS inOutUvBuffer, 
+      size_t numThreads, uint32_t firstVertex, uint32_t lastVertex)
 {
    using namespace Ogre;
 
    Vector3* RESTRICT_ALIAS tsUs = inOutUvBuffer;
    Vector3* RESTRICT_ALIAS tsVs = inOutUvBuffer + numVertices;
 
-   for( ::uint32_t i=0; i<numVertices; ++i )
+   for( size_t j=1; j<numThreads; ++j )
+   {
+      /* Merge the tsU & tsV vectors calculated by the other threads 
+       * for these same vertices */
+      Vector3 const* RESTRICT_ALIAS otherUs = inOutUvBuffer + 
+         numVertices * 2u * j;
+      Vector3 const* RESTRICT_ALIAS otherVs = otherUs + numVertices;
+      for( ::uint32_t i=firstVertex; i<lastVertex; ++i )
+      {
+         tsUs[i] += otherUs[i];
+         tsVs[i] += otherVs[i];
+      }
+   }
+
+   /* Gram-Schmidt orthogonalize and calculate handedness */
+   orthogonaliseTangents(vertexData, bytesPerVertex, normalStride, 
+         tangentStride, tsUs, tsVs, firstVertex, lastVertex);
+}
+
+/***********************************************************************
+ *                      calculateTriangleNormals                       *
+ ***********************************************************************/
+bool VertexUtils::calculateTriangleNormals(const uint8_t* vertexData,
+      uint32_t i0, uint32_t i1, uint32_t i2, uint32_t bytesPerVertex, 
+      uint32_t posStride, NormalWeighting weighting, Ogre::Vector3* out)
+{
+   using namespace Ogre;
+
+   const Vector3& p0 = *reinterpret_cast<const Vector3*>(
+         vertexData + posStride + i0 * bytesPerVertex);
+   const Vector3& p1 = *reinterpret_cast<const Vector3*>(
+         vertexData + posStride + i1 * bytesPerVertex);
+   const Vector3& p2 = *reinterpret_cast<const Vector3*>(
+         vertexData + posStride + i2 * bytesPerVertex);
+
+   const Vector3 e01 = p1 - p0;
+   const Vector3 e02 = p2 - p0;
+
+   /* Its length is twice the triangle area */
+   Vector3 faceNormal = e01.crossProduct(e02);
+   Real len = faceNormal.length();
+   if(len <= 0.0f)
+   {
+      return false;
+   }
+
+   if(weighting == NORMAL_WEIGHTING_AREA)
    {
-      for( size_t j=1; j<numThreads; ++j )
+      out[0] = faceNormal;
+      out[1] = faceNormal;
+      out[2] = faceNormal;
+   }
+   else
+   {
+      faceNormal /= len;
+      const Vector3 e12 = p2 - p1;
+      Real l01 = e01.length();
+      Real l02 = e02.length();
+      Real l12 = e12.length();
+      Real a0 = Math::ACos(e01.dotProduct(e02) / (l01 * l02)).valueRadians();
+      Real a1 = Math::ACos(-e01.dotProduct(e12) / (l01 * l12)).valueRadians();
+      Real a2 = Math::PI - a0 - a1;
+      out[0] = faceNormal * a0;
+      out[1] = faceNormal * a1;
+      out[2] = faceNormal * ((a2 > 0.0f) ? a2 : 0.0f);
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                         generateNormalSums                          *
+ ***********************************************************************/
+void VertexUtils::generateNormalSums(const uint8_t* vertexData, 
+      const uint32_t* indexData, uint32_t bytesPerVertex, 
+      uint32_t numVertices, uint32_t numIndices, uint32_t posStride, 
+      NormalWeighting weighting, Ogre::Vector3* RESTRICT_ALIAS outData)
+{
+   Ogre::Vector3 normals[3];
+   for( ::uint32_t i=0; i<numIndices; i += 3 )
+   {
+      if( calculateTriangleNormals(vertexData, indexData[i], indexData[i+1],
+               indexData[i+2], bytesPerVertex, posStride, weighting, 
+               normals) )
+      {
+         outData[indexData[i+0]] += normals[0];
+         outData[indexData[i+1]] += normals[1];
+         outData[indexData[i+2]] += normals[2];
+      }
+   }
+}
+
+/***********************************************************************
+ *                        generateNormalsMerge                         *
+ ***********************************************************************/
+void VertexUtils::generateNormalsMerge(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, uint32_t normalStride,
+      Ogre::Vector3* RESTRICT_ALIAS inOutNormalBuffer, size_t numThreads)
+{
+   generateNormalsMergeRange(vertexData, bytesPerVertex, numVertices, 
+         normalStride, inOutNormalBuffer, numThreads, 0, numVertices);
+}
+
+/***********************************************************************
+ *                      generateNormalsMergeRange                      *
+ ***********************************************************************/
+void VertexUtils::generateNormalsMergeRange(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, uint32_t normalStride,
+      Ogre::Vector3* RESTRICT_ALIAS inOutNormalBuffer, size_t numThreads,
+      uint32_t firstVertex, uint32_t lastVertex)
+{
+   using namespace Ogre;
+
+   for( size_t j=1; j<numThreads; ++j )
+   {
+      /* Merge the sums calculated by the other threads */
+      Vector3 const* RESTRICT_ALIAS other = inOutNormalBuffer + 
+         numVertices * j;
+      for( ::uint32_t i=firstVertex; i<lastVertex; ++i )
+      {
+         inOutNormalBuffer[i] += other[i];
+      }
+   }
+
+   for( ::uint32_t i=firstVertex; i<lastVertex; ++i )
+   {
+      Real len = inOutNormalBuffer[i].length();
+      if(len > 0.0f)
       {
-         /* Merge the tsU & tsV vectors calculated by the other threads 
-          * for these same vertices */
-         tsUs[i] += inOutUvBuffer[i + numVertices * 2u * j];
-         tsVs[i] += inOutUvBuffer[i + numVertices * 2u * j + numVertices];
+         *reinterpret_cast<Vector3*>(vertexData + i * bytesPerVertex + 
+               normalStride) = inOutNormalBuffer[i] / len;
       }
+   }
+}
+
+/***********************************************************************
+ *                            setSimdPath                              *
+ ***********************************************************************/
+void VertexUtils::setSimdPath(SimdPath path)
+{
+   SimdPath supported = getSupportedSimdPath();
+   simdPath = (path > supported) ? supported : path;
+}
+
+/***********************************************************************
+ *                        getSupportedSimdPath                         *
+ ***********************************************************************/
+VertexUtils::SimdPath VertexUtils::getSupportedSimdPath()
+{
+#if defined(GOBLIN_SIMD_AVX2)
+   if(Simd::hasAvx2())
+   {
+      return SIMD_PATH_8;
+   }
+#endif
+#if defined(GOBLIN_SIMD_SSE2) || defined(GOBLIN_SIMD_NEON)
+   return SIMD_PATH_4;
+#else
+   return SIMD_PATH_SCALAR;
+#endif
+}
+
+VertexUtils::SimdPath VertexUtils::simdPath = 
+   VertexUtils::getSupportedSimdPath();
+
+/***********************************************************************
+ *                        orthogonaliseTangents                        *
+ ***********************************************************************/
+void VertexUtils::orthogonaliseTangents(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t normalStride, uint32_t tangentStride, 
+      const Ogre::Vector3* tsU, const Ogre::Vector3* tsV, 
+      uint32_t firstVertex, uint32_t lastVertex)
+{
+   switch(simdPath)
+   {
+#if defined(GOBLIN_SIMD_AVX2)
+      case SIMD_PATH_8:
+         orthogonaliseTangentsSimd8(vertexData, bytesPerVertex, normalStride,
+               tangentStride, tsU, tsV, firstVertex, lastVertex);
+      break;
+#endif
+      case SIMD_PATH_4:
+         orthogonaliseTangentsSimd4(vertexData, bytesPerVertex, normalStride,
+               tangentStride, tsU, tsV, firstVertex, lastVertex);
+      break;
+      default:
+         orthogonaliseTangentsScalar(vertexData, bytesPerVertex, 
+               normalStride, tangentStride, tsU, tsV, firstVertex, 
+               lastVertex);
+      break;
+   }
+}
+
+/***********************************************************************
+ *                     orthogonaliseTangentsScalar                     *
+ ***********************************************************************/
+void VertexUtils::orthogonaliseTangentsScalar(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t normalStride, uint32_t tangentStride, 
+      const Ogre::Vector3* tsU, const Ogre::Vector3* tsV, 
+      uint32_t firstVertex, uint32_t lastVertex)
+{
+   using namespace Ogre;
 
+   vertexData += firstVertex * bytesPerVertex;
+
+   for( ::uint32_t i=firstVertex; i<lastVertex; ++i )
+   {
       Vector3 const* RESTRICT_ALIAS vNormal;
       Vector3* RESTRICT_ALIAS vTangent;
       float* RESTRICT_ALIAS fParity;
@@ -232,16 +398,2352 @@ void VertexUtils::generateTangentsMergeTUV(uint8_t *vertexData,
             vertexData + tangentStride + sizeof(Vector3));
 
       /* Gram-Schmidt orthogonalize */
-      *vTangent = (tsUs[i] - (*vNormal) * vNormal->dotProduct( 
-               tsUs[i])).normalisedCopy();
+      *vTangent = (tsU[i] - (*vNormal) * vNormal->dotProduct( 
+               tsU[i])).normalisedCopy();
 
       /* Calculate handedness */
-      *fParity = vNormal->crossProduct(tsUs[i]).dotProduct(tsVs[i]) < 0.0f ? 
+      *fParity = vNormal->crossProduct(tsU[i]).dotProduct(tsV[i]) < 0.0f ? 
          -1.0f : 1.0f;
 
       vertexData += bytesPerVertex;
    }
 }
 
+/***********************************************************************
+ *                     orthogonaliseTangentsSimd4                      *
+ ***********************************************************************/
+void VertexUtils::orthogonaliseTangentsSimd4(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t normalStride, uint32_t tangentStride, 
+      const Ogre::Vector3* tsU, const Ogre::Vector3* tsV, 
+      uint32_t firstVertex, uint32_t lastVertex)
+{
+   using namespace Simd;
+
+   /* Gather buffers, to load 4 vertices as SoA */
+   float n[3][4];
+   float u[3][4];
+   float v[3][4];
+
+   const Float4 fZero = zero();
+   const Float4 fOne = set1(1.0f);
+   const Float4 fMinusOne = set1(-1.0f);
+
+   ::uint32_t i = firstVertex;
+   for( ; i + 4 <= lastVertex; i += 4 )
+   {
+      for(int j = 0; j < 4; j++)
+      {
+         const float* vNormal = reinterpret_cast<const float*>(
+               vertexData + (i + j) * bytesPerVertex + normalStride);
+         for(int k = 0; k < 3; k++)
+         {
+            n[k][j] = vNormal[k];
+            u[k][j] = tsU[i + j][k];
+            v[k][j] = tsV[i + j][k];
+         }
+      }
+      Float4 nx = load(n[0]), ny = load(n[1]), nz = load(n[2]);
+      Float4 ux = load(u[0]), uy = load(u[1]), uz = load(u[2]);
+      Float4 vx = load(v[0]), vy = load(v[1]), vz = load(v[2]);
+
+      /* Gram-Schmidt orthogonalize */
+      Float4 d = dot3(nx, ny, nz, ux, uy, uz);
+      Float4 tx = sub(ux, mul(nx, d));
+      Float4 ty = sub(uy, mul(ny, d));
+      Float4 tz = sub(uz, mul(nz, d));
+
+      /* Normalise (keeping zero length ones as they are) */
+      Float4 len = sqrt(dot3(tx, ty, tz, tx, ty, tz));
+      Mask4 nonZero = cmpGt(len, fZero);
+      Float4 invLen = div(fOne, select(nonZero, len, fOne));
+      tx = mul(tx, invLen);
+      ty = mul(ty, invLen);
+      tz = mul(tz, invLen);
+
+      /* Calculate handedness */
+      Float4 cx, cy, cz;
+      cross3(nx, ny, nz, ux, uy, uz, cx, cy, cz);
+      Float4 parity = select(cmpLt(dot3(cx, cy, cz, vx, vy, vz), fZero),
+            fMinusOne, fOne);
+
+      /* Back to AoS: each row is now a tangent (x, y, z, parity) */
+      transpose(tx, ty, tz, parity);
+      store(reinterpret_cast<float*>(vertexData + i * bytesPerVertex + 
+               tangentStride), tx);
+      store(reinterpret_cast<float*>(vertexData + (i + 1) * bytesPerVertex +
+               tangentStride), ty);
+      store(reinterpret_cast<float*>(vertexData + (i + 2) * bytesPerVertex +
+               tangentStride), tz);
+      store(reinterpret_cast<float*>(vertexData + (i + 3) * bytesPerVertex +
+               tangentStride), parity);
+   }
+
+   /* Remaining ones */
+   orthogonaliseTangentsScalar(vertexData, bytesPerVertex, normalStride,
+         tangentStride, tsU, tsV, i, lastVertex);
+}
+
+#if defined(GOBLIN_SIMD_AVX2)
+/***********************************************************************
+ *                     orthogonaliseTangentsSimd8                      *
+ ***********************************************************************/
+void VertexUtils::orthogonaliseTangentsSimd8(uint8_t* vertexData,
+      uint32_t bytesPerVertex, uint32_t normalStride, uint32_t tangentStride,
+      const Ogre::Vector3* tsU, const Ogre::Vector3* tsV,
+      uint32_t firstVertex, uint32_t lastVertex)
+{
+   assert(sizeof(Ogre::Vector3) == 3 * sizeof(float));
+   uint32_t i = Avx2::orthogonaliseTangents(vertexData, bytesPerVertex, 
+         normalStride, tangentStride, reinterpret_cast<const float*>(tsU),
+         reinterpret_cast<const float*>(tsV), firstVertex, lastVertex);
+
+   /* Remaining ones */
+   orthogonaliseTangentsSimd4(vertexData, bytesPerVertex, normalStride,
+         tangentStride, tsU, tsV, i, lastVertex);
+}
 #endif
 
+namespace Goblin
+{
+
+/*! Minimun number of triangles a worker thread should receive to make 
+ * worth its creation. */
+#define TANGENTS_MIN_TRIANGLES_PER_THREAD  4096
+
+/*! Information shared with each worker of #generateTangentsParallel,
+ * #generateNormals and #generateNormalsAndTangents */
+class TangentsThreadInfo
+{
+   public:
+      /*! Constructor, with no buffers nor attributes defined yet */
+      TangentsThreadInfo(uint8_t* vertexData, const uint32_t* indexData,
+            uint32_t bytesPerVertex, uint32_t numVertices, 
+            uint32_t numIndices, uint32_t posStride, size_t numThreads)
+      {
+         this->vertexData = vertexData;
+         this->indexData = indexData;
+         this->bytesPerVertex = bytesPerVertex;
+         this->numVertices = numVertices;
+         this->numIndices = numIndices;
+         this->posStride = posStride;
+         this->numThreads = numThreads;
+         this->normalStride = 0;
+         this->tangentStride = 0;
+         this->uvStride = 0;
+         this->accumulation = VertexUtils::TANGENT_ACCUMULATION_PER_THREAD;
+         this->weighting = VertexUtils::NORMAL_WEIGHTING_ANGLE;
+         this->merging = false;
+         this->uvBuffer = NULL;
+         this->normalBuffer = NULL;
+         this->triangleUvBuffer = NULL;
+         this->vertexTriangleStart = NULL;
+         this->vertexTriangles = NULL;
+      }
+
+      uint8_t* vertexData;
+      const uint32_t* indexData;
+      uint32_t bytesPerVertex;
+      uint32_t numVertices;
+      uint32_t numIndices;
+      uint32_t posStride;
+      uint32_t normalStride;
+      uint32_t tangentStride;
+      uint32_t uvStride;
+      size_t numThreads;
+      VertexUtils::TangentAccumulation accumulation;
+      VertexUtils::NormalWeighting weighting;
+      bool merging;              /**< If at step 01 (false) or 02 (true) */
+
+      /*! Per vertex tsU and tsV: numThreads copies on 
+       * TANGENT_ACCUMULATION_PER_THREAD, a single one otherwise. 
+       * NULL if not generating tangents. */
+      Ogre::Vector3* uvBuffer;
+      /*! Per vertex normal sums, numThreads copies (always per thread 
+       * accumulation). NULL if not generating normals. */
+      Ogre::Vector3* normalBuffer;
+
+      /* Only used on TANGENT_ACCUMULATION_VERTEX_OWNER */
+      Ogre::Vector3* triangleUvBuffer; /**< tsU, tsV of each triangle */
+      uint32_t* vertexTriangleStart; /**< First of vertex at vertexTriangles*/
+      uint32_t* vertexTriangles; /**< Triangles using each vertex */
+
+      /*! \return first element of slice threadIdx of total elements */
+      uint32_t sliceStart(uint32_t total, size_t threadIdx)
+      {
+         return (uint32_t)((((Ogre::uint64)total) * threadIdx) / numThreads);
+      }
+
+      /*! Run the current step for the slice of thread threadIdx */
+      void run(size_t threadIdx)
+      {
+         if(!merging)
+         {
+            /* Step 01: triangle slice */
+            uint32_t numTriangles = numIndices / 3;
+            uint32_t first = sliceStart(numTriangles, threadIdx);
+            uint32_t last = sliceStart(numTriangles, threadIdx + 1);
+            if(normalBuffer)
+            {
+               Ogre::Vector3* out = normalBuffer + numVertices * threadIdx;
+               for(uint32_t i = 0; i < numVertices; i++)
+               {
+                  out[i] = Ogre::Vector3::ZERO;
+               }
+               if(!uvBuffer)
+               {
+                  VertexUtils::generateNormalSums(vertexData, 
+                        indexData + first * 3, bytesPerVertex, numVertices,
+                        (last - first) * 3, posStride, weighting, out);
+                  return;
+               }
+               /* Normals and tangents, with a single read of each 
+                * triangle */
+               calculateNormalsAndTanUV(first, last, threadIdx);
+            }
+            else if(accumulation == 
+                    VertexUtils::TANGENT_ACCUMULATION_PER_THREAD)
+            {
+               /* Accumulate with its own clean scratch buffer */
+               Ogre::Vector3* out = uvBuffer + numVertices * 2u * threadIdx;
+               for(uint32_t i = 0; i < numVertices * 2u; i++)
+               {
+                  out[i] = Ogre::Vector3::ZERO;
+               }
+
+               VertexUtils::generateTanUV(vertexData, indexData + first * 3,
+                     bytesPerVertex, numVertices, (last - first) * 3, 
+                     posStride, normalStride, tangentStride, uvStride, out);
+            }
+            else
+            {
+               calculateTriangles(first, last);
+            }
+         }
+         else
+         {
+            /* Step 02: vertex slice */
+            uint32_t first = sliceStart(numVertices, threadIdx);
+            uint32_t last = sliceStart(numVertices, threadIdx + 1);
+            if(normalBuffer)
+            {
+               /* Normals first, as the tangents are orthogonalized 
+                * against them. */
+               VertexUtils::generateNormalsMergeRange(vertexData, 
+                     bytesPerVertex, numVertices, normalStride, 
+                     normalBuffer, numThreads, first, last);
+            }
+            if(!uvBuffer)
+            {
+               return;
+            }
+            if(accumulation == VertexUtils::TANGENT_ACCUMULATION_PER_THREAD)
+            {
+               /* Merging all scratch buffers */
+               VertexUtils::generateTangentsMergeTUVRange(vertexData, 
+                     bytesPerVertex, numVertices, normalStride, 
+                     tangentStride, uvBuffer, numThreads, first, last);
+            }
+            else
+            {
+               /* Gathering the triangles of each owned vertex */
+               Ogre::Vector3* tsUs = uvBuffer;
+               Ogre::Vector3* tsVs = uvBuffer + numVertices;
+               for(uint32_t i = first; i < last; i++)
+               {
+                  Ogre::Vector3 tsU = Ogre::Vector3::ZERO;
+                  Ogre::Vector3 tsV = Ogre::Vector3::ZERO;
+                  for(uint32_t t = vertexTriangleStart[i]; 
+                      t < vertexTriangleStart[i + 1]; t++)
+                  {
+                     tsU += triangleUvBuffer[vertexTriangles[t] * 2u];
+                     tsV += triangleUvBuffer[vertexTriangles[t] * 2u + 1u];
+                  }
+                  tsUs[i] = tsU;
+                  tsVs[i] = tsV;
+               }
+               VertexUtils::generateTangentsMergeTUVRange(vertexData, 
+                     bytesPerVertex, numVertices, normalStride, 
+                     tangentStride, uvBuffer, 1, first, last);
+            }
+         }
+      }
+
+      /*! Accumulate both normals and tsU, tsV of triangles 
+       * [first, last) on the (already clean) buffers of threadIdx */
+      void calculateNormalsAndTanUV(uint32_t first, uint32_t last, 
+            size_t threadIdx)
+      {
+         Ogre::Vector3* normals = normalBuffer + numVertices * threadIdx;
+         Ogre::Vector3* tsUs = uvBuffer + numVertices * 2u * threadIdx;
+         Ogre::Vector3* tsVs = tsUs + numVertices;
+         for(uint32_t i = 0; i < numVertices * 2u; i++)
+         {
+            tsUs[i] = Ogre::Vector3::ZERO;
+         }
+
+         Ogre::Vector3 n[3];
+         Ogre::Vector3 tsU, tsV;
+         for(uint32_t t = first; t < last; t++)
+         {
+            const uint32_t* tri = indexData + t * 3;
+            if(VertexUtils::calculateTriangleNormals(vertexData, tri[0],
+                     tri[1], tri[2], bytesPerVertex, posStride, weighting, 
+                     n))
+            {
+               normals[tri[0]] += n[0];
+               normals[tri[1]] += n[1];
+               normals[tri[2]] += n[2];
+            }
+            if(VertexUtils::calculateTriangleTanUV(vertexData, tri[0], 
+                     tri[1], tri[2], bytesPerVertex, posStride, uvStride, 
+                     tsU, tsV))
+            {
+               for(int j = 0; j < 3; j++)
+               {
+                  tsUs[tri[j]] += tsU;
+                  tsVs[tri[j]] += tsV;
+               }
+            }
+         }
+      }
+
+      /*! Calculate and store tsU and tsV of triangles [first, last) */
+      void calculateTriangles(uint32_t first, uint32_t last)
+      {
+         for(uint32_t t = first; t < last; t++)
+         {
+            const uint32_t* tri = indexData + t * 3;
+            Ogre::Vector3* out = triangleUvBuffer + t * 2u;
+            if(!VertexUtils::calculateTriangleTanUV(vertexData, tri[0], 
+                     tri[1], tri[2], bytesPerVertex, posStride, uvStride, 
+                     out[0], out[1]))
+            {
+               out[0] = Ogre::Vector3::ZERO;
+               out[1] = Ogre::Vector3::ZERO;
+            }
+         }
+      }
+
+      /*! Build the vertex to triangle adjacency (in CSR form) */
+      void buildVertexTriangles()
+      {
+         for(uint32_t i = 0; i <= numVertices; i++)
+         {
+            vertexTriangleStart[i] = 0;
+         }
+         /* Count triangles of each vertex */
+         uint32_t numTriIndices = (numIndices / 3) * 3;
+         for(uint32_t i = 0; i < numTriIndices; i++)
+         {
+            vertexTriangleStart[indexData[i] + 1]++;
+         }
+         /* Prefix sum, to define where each vertex list starts */
+         for(uint32_t i = 0; i < numVertices; i++)
+         {
+            vertexTriangleStart[i + 1] += vertexTriangleStart[i];
+         }
+         /* And fill them (using vertexTriangleStart[v] as cursor, thus 
+          * after all, vertexTriangleStart[v] is the start of v + 1) */
+         for(uint32_t i = 0; i < numTriIndices; i++)
+         {
+            vertexTriangles[vertexTriangleStart[indexData[i]]++] = i / 3;
+         }
+         for(uint32_t i = numVertices; i > 0; i--)
+         {
+            vertexTriangleStart[i] = vertexTriangleStart[i - 1];
+         }
+         vertexTriangleStart[0] = 0;
+      }
+};
+
+/***********************************************************************
+ *                        tangentsWorkerThread                         *
+ ***********************************************************************/
+unsigned long tangentsWorkerThread(Ogre::ThreadHandle* threadHandle)
+{
+   TangentsThreadInfo* info = reinterpret_cast<TangentsThreadInfo*>(
+         threadHandle->getUserParam());
+   info->run(threadHandle->getThreadIdx());
+   return 0;
+}
+THREAD_DECLARE(tangentsWorkerThread);
+
+/***********************************************************************
+ *                          runTangentsSteps                           *
+ ***********************************************************************/
+void runTangentsSteps(TangentsThreadInfo& info)
+{
+   Ogre::ThreadHandleVec threads;
+   threads.resize(info.numThreads - 1);
+
+   /* Do both steps, each one split over all threads (the calling thread 
+    * working on the first slice) */
+   for(int step = 0; step < 2; step++)
+   {
+      info.merging = (step == 1);
+
+      for(size_t i = 1; i < info.numThreads; i++)
+      {
+         threads[i - 1] = Ogre::Threads::CreateThread(
+               THREAD_GET(tangentsWorkerThread), i, &info);
+      }
+      info.run(0);
+      if(!threads.empty())
+      {
+         Ogre::Threads::WaitForThreads(threads);
+      }
+   }
+}
+
+}
+
+/***********************************************************************
+ *                        getTangentThreadCount                        *
+ ***********************************************************************/
+size_t VertexUtils::getTangentThreadCount(uint32_t numIndices, 
+      size_t numThreads)
+{
+   if(numThreads == 0)
+   {
+      numThreads = Ogre::PlatformInformation::getNumLogicalCores();
+   }
+
+   /* Avoid creating threads for just a few triangles */
+   size_t maxThreads = (numIndices / 3) / TANGENTS_MIN_TRIANGLES_PER_THREAD;
+   if(numThreads > maxThreads)
+   {
+      numThreads = maxThreads;
+   }
+
+   return (numThreads > 0) ? numThreads : 1;
+}
+
+/***********************************************************************
+ *                        getTangentScratchSize                        *
+ ***********************************************************************/
+size_t VertexUtils::getTangentScratchSize(uint32_t numVertices, 
+      uint32_t numIndices, size_t numThreads, 
+      TangentAccumulation accumulation)
+{
+   numThreads = getTangentThreadCount(numIndices, numThreads);
+
+   if(accumulation == TANGENT_ACCUMULATION_PER_THREAD)
+   {
+      return sizeof(Ogre::Vector3) * numVertices * 2u * numThreads;
+   }
+
+   size_t numTriangles = numIndices / 3;
+   return sizeof(Ogre::Vector3) * numVertices * 2u +
+          sizeof(Ogre::Vector3) * numTriangles * 2u +
+          sizeof(uint32_t) * (numVertices + 1) +
+          sizeof(uint32_t) * numTriangles * 3u;
+}
+
+/***********************************************************************
+ *                      generateTangentsParallel                       *
+ ***********************************************************************/
+void VertexUtils::generateTangentsParallel(uint8_t* vertexData,
+      const uint32_t* indexData, uint32_t bytesPerVertex,
+      uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+      uint32_t normalStride, uint32_t tangentStride, uint32_t uvStride, 
+      size_t numThreads, TangentAccumulation accumulation)
+{
+   numThreads = getTangentThreadCount(numIndices, numThreads);
+
+   TangentsThreadInfo info(vertexData, indexData, bytesPerVertex, 
+         numVertices, numIndices, posStride, numThreads);
+   info.normalStride = normalStride;
+   info.tangentStride = tangentStride;
+   info.uvStride = uvStride;
+   info.accumulation = accumulation;
+
+   if(accumulation == TANGENT_ACCUMULATION_PER_THREAD)
+   {
+      info.uvBuffer = new Ogre::Vector3[numVertices * 2u * numThreads];
+   }
+   else
+   {
+      uint32_t numTriangles = numIndices / 3;
+      info.uvBuffer = new Ogre::Vector3[numVertices * 2u];
+      info.triangleUvBuffer = new Ogre::Vector3[numTriangles * 2u];
+      info.vertexTriangleStart = new uint32_t[numVertices + 1];
+      info.vertexTriangles = new uint32_t[numTriangles * 3u];
+      info.buildVertexTriangles();
+   }
+
+   runTangentsSteps(info);
+
+   delete[] info.uvBuffer;
+   if(info.triangleUvBuffer)
+   {
+      delete[] info.triangleUvBuffer;
+      delete[] info.vertexTriangleStart;
+      delete[] info.vertexTriangles;
+   }
+}
+
+/***********************************************************************
+ *                           generateNormals                           *
+ ***********************************************************************/
+void VertexUtils::generateNormals(uint8_t* vertexData,
+      const uint32_t* indexData, uint32_t bytesPerVertex,
+      uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+      uint32_t normalStride, NormalWeighting weighting, size_t numThreads)
+{
+   numThreads = getTangentThreadCount(numIndices, numThreads);
+
+   TangentsThreadInfo info(vertexData, indexData, bytesPerVertex, 
+         numVertices, numIndices, posStride, numThreads);
+   info.normalStride = normalStride;
+   info.weighting = weighting;
+   info.normalBuffer = new Ogre::Vector3[numVertices * numThreads];
+
+   runTangentsSteps(info);
+
+   delete[] info.normalBuffer;
+}
+
+/***********************************************************************
+ *                     generateNormalsAndTangents                      *
+ ***********************************************************************/
+void VertexUtils::generateNormalsAndTangents(uint8_t* vertexData,
+      const uint32_t* indexData, uint32_t bytesPerVertex,
+      uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+      uint32_t normalStride, uint32_t tangentStride, uint32_t uvStride,
+      NormalWeighting weighting, size_t numThreads)
+{
+   numThreads = getTangentThreadCount(numIndices, numThreads);
+
+   TangentsThreadInfo info(vertexData, indexData, bytesPerVertex, 
+         numVertices, numIndices, posStride, numThreads);
+   info.normalStride = normalStride;
+   info.tangentStride = tangentStride;
+   info.uvStride = uvStride;
+   info.weighting = weighting;
+   info.normalBuffer = new Ogre::Vector3[numVertices * numThreads];
+   info.uvBuffer = new Ogre::Vector3[numVertices * 2u * numThreads];
+
+   runTangentsSteps(info);
+
+   delete[] info.normalBuffer;
+   delete[] info.uvBuffer;
+}
+
+namespace Goblin
+{
+
+/*! Size of the LRU cache simulated by the vertex cache optimizer */
+#define VERTEX_CACHE_OPTIMIZER_SIZE  32
+
+/*! Index buffer optimizers, for both index types. */
+template<typename IndexType> class IndexOptimizer
+{
+   public:
+
+      /*! Forsyth's vertex score */
+      static float vertexScore(int cachePosition, uint32_t remaining)
+      {
+         if(remaining == 0)
+         {
+            /* No more triangles use it: no need to score it */
+            return -1.0f;
+         }
+
+         float score = 0.0f;
+         if(cachePosition >= 0)
+         {
+            if(cachePosition < 3)
+            {
+               /* Used by the last triangle: fixed score, to avoid favoring
+                * the triangle we just emitted. */
+               score = 0.75f;
+            }
+            else
+            {
+               const float scaler = 1.0f / 
+                  (VERTEX_CACHE_OPTIMIZER_SIZE - 3);
+               score = powf(1.0f - (cachePosition - 3) * scaler, 1.5f);
+            }
+         }
+
+         /* Boost vertices with few remaining triangles, to get rid of 
+          * them soon (avoiding lonely triangles at the end). */
+         return score + 2.0f / sqrtf((float)remaining);
+      }
+
+      /*! \see VertexUtils::optimizeVertexCache */
+      static void optimizeVertexCache(IndexType* indexData, 
+            uint32_t numIndices, uint32_t numVertices)
+      {
+         uint32_t numTriangles = numIndices / 3;
+         if(numTriangles == 0)
+         {
+            return;
+         }
+
+         /* Vertex to triangle adjacency, with remaining ones at the
+          * start of each vertex list. */
+         uint32_t* remaining = new uint32_t[numVertices];
+         uint32_t* start = new uint32_t[numVertices + 1];
+         uint32_t* triangles = new uint32_t[numTriangles * 3];
+         memset(remaining, 0, sizeof(uint32_t) * numVertices);
+         for(uint32_t i = 0; i < numTriangles * 3; i++)
+         {
+            remaining[indexData[i]]++;
+         }
+         start[0] = 0;
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            start[v + 1] = start[v] + remaining[v];
+            remaining[v] = 0;
+         }
+         for(uint32_t i = 0; i < numTriangles * 3; i++)
+         {
+            IndexType v = indexData[i];
+            triangles[start[v] + remaining[v]] = i / 3;
+            remaining[v]++;
+         }
+
+         /* Initial scores */
+         int* cachePosition = new int[numVertices];
+         float* vScore = new float[numVertices];
+         float* tScore = new float[numTriangles];
+         bool* emitted = new bool[numTriangles];
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            cachePosition[v] = -1;
+            vScore[v] = vertexScore(-1, remaining[v]);
+         }
+         int bestTriangle = -1;
+         float bestScore = -1.0f;
+         for(uint32_t t = 0; t < numTriangles; t++)
+         {
+            emitted[t] = false;
+            tScore[t] = vScore[indexData[t * 3]] + 
+               vScore[indexData[t * 3 + 1]] + vScore[indexData[t * 3 + 2]];
+            if(tScore[t] > bestScore)
+            {
+               bestScore = tScore[t];
+               bestTriangle = (int)t;
+            }
+         }
+
+         IndexType* output = new IndexType[numTriangles * 3];
+         uint32_t cache[VERTEX_CACHE_OPTIMIZER_SIZE + 3];
+         uint32_t newCache[VERTEX_CACHE_OPTIMIZER_SIZE + 3];
+         int cacheCount = 0;
+         uint32_t nextCandidate = 0;
+
+         for(uint32_t emittedCount = 0; emittedCount < numTriangles; 
+             emittedCount++)
+         {
+            if(bestTriangle < 0)
+            {
+               /* No good candidate on cache: get the next not emitted */
+               while(emitted[nextCandidate])
+               {
+                  nextCandidate++;
+               }
+               bestTriangle = (int)nextCandidate;
+            }
+
+            /* Emit it */
+            uint32_t t = (uint32_t)bestTriangle;
+            emitted[t] = true;
+            const IndexType* tri = &indexData[t * 3];
+            output[emittedCount * 3] = tri[0];
+            output[emittedCount * 3 + 1] = tri[1];
+            output[emittedCount * 3 + 2] = tri[2];
+
+            /* Remove it from its vertices' remaining lists and put them 
+             * at the cache front */
+            int newCount = 0;
+            for(int j = 0; j < 3; j++)
+            {
+               uint32_t v = tri[j];
+               uint32_t* list = &triangles[start[v]];
+               for(uint32_t k = 0; k < remaining[v]; k++)
+               {
+                  if(list[k] == t)
+                  {
+                     list[k] = list[remaining[v] - 1];
+                     list[remaining[v] - 1] = t;
+                     remaining[v]--;
+                     break;
+                  }
+               }
+               newCache[newCount++] = v;
+            }
+            for(int c = 0; c < cacheCount; c++)
+            {
+               uint32_t v = cache[c];
+               if((v != tri[0]) && (v != tri[1]) && (v != tri[2]))
+               {
+                  newCache[newCount++] = v;
+               }
+            }
+
+            /* Update the scores of all vertices at the (new) cache, 
+             * including the ones just evicted from it. */
+            bestTriangle = -1;
+            bestScore = -1.0f;
+            for(int c = 0; c < newCount; c++)
+            {
+               uint32_t v = newCache[c];
+               cachePosition[v] = (c < VERTEX_CACHE_OPTIMIZER_SIZE) ? c : -1;
+               float score = vertexScore(cachePosition[v], remaining[v]);
+               float diff = score - vScore[v];
+               vScore[v] = score;
+
+               for(uint32_t k = 0; k < remaining[v]; k++)
+               {
+                  uint32_t tri = triangles[start[v] + k];
+                  tScore[tri] += diff;
+                  if((cachePosition[v] >= 0) && (tScore[tri] > bestScore))
+                  {
+                     bestScore = tScore[tri];
+                     bestTriangle = (int)tri;
+                  }
+               }
+            }
+            cacheCount = (newCount > VERTEX_CACHE_OPTIMIZER_SIZE) ? 
+               VERTEX_CACHE_OPTIMIZER_SIZE : newCount;
+            memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+         }
+
+         memcpy(indexData, output, sizeof(IndexType) * numTriangles * 3);
+
+         delete[] output;
+         delete[] emitted;
+         delete[] tScore;
+         delete[] vScore;
+         delete[] cachePosition;
+         delete[] triangles;
+         delete[] start;
+         delete[] remaining;
+      }
+
+      /*! Simulate a FIFO cache of cacheSize over the index buffer.
+       * \param misses if not NULL, receive the misses of each triangle. */
+      static VertexCacheStatistics simulateCache(const IndexType* indexData,
+            uint32_t numIndices, uint32_t numVertices, uint32_t cacheSize,
+            Ogre::uint8* misses)
+      {
+         VertexCacheStatistics stats;
+         stats.transformedVertices = 0;
+
+         /* A vertex is at cache if it was inserted on the last cacheSize 
+          * insertions. */
+         uint32_t* insertedAt = new uint32_t[numVertices];
+         memset(insertedAt, 0, sizeof(uint32_t) * numVertices);
+         uint32_t timestamp = cacheSize + 1;
+         uint32_t referenced = 0;
+
+         uint32_t numTriangles = numIndices / 3;
+         for(uint32_t t = 0; t < numTriangles; t++)
+         {
+            Ogre::uint8 triMisses = 0;
+            for(int j = 0; j < 3; j++)
+            {
+               IndexType v = indexData[t * 3 + j];
+               if(insertedAt[v] == 0)
+               {
+                  referenced++;
+               }
+               if(timestamp - insertedAt[v] > cacheSize)
+               {
+                  insertedAt[v] = timestamp++;
+                  triMisses++;
+               }
+            }
+            stats.transformedVertices += triMisses;
+            if(misses)
+            {
+               misses[t] = triMisses;
+            }
+         }
+         delete[] insertedAt;
+
+         stats.acmr = (numTriangles > 0) ? 
+            stats.transformedVertices / (Ogre::Real)numTriangles : 0.0f;
+         stats.atvr = (referenced > 0) ? 
+            stats.transformedVertices / (Ogre::Real)referenced : 0.0f;
+         return stats;
+      }
+
+      /*! A cluster of triangles for overdraw sorting */
+      class Cluster
+      {
+         public:
+            uint32_t first;  /**< First triangle */
+            uint32_t count;  /**< Number of triangles */
+            Ogre::Real sortKey;   /**< How much it faces outwards */
+
+            bool operator<(const Cluster& other) const 
+            { 
+               /* Greater key first */
+               return sortKey > other.sortKey; 
+            };
+      };
+
+      /*! \see VertexUtils::optimizeOverdraw */
+      static void optimizeOverdraw(IndexType* indexData, uint32_t numIndices,
+            const uint8_t* vertexData, uint32_t bytesPerVertex, 
+            uint32_t numVertices, uint32_t posStride, Ogre::Real threshold)
+      {
+         uint32_t numTriangles = numIndices / 3;
+         if(numTriangles < 2)
+         {
+            return;
+         }
+
+         const uint32_t cacheSize = 16;
+         Ogre::uint8* misses = new Ogre::uint8[numTriangles];
+         simulateCache(indexData, numIndices, numVertices, cacheSize, misses);
+
+         uint32_t* insertedAt = new uint32_t[numVertices];
+         memset(insertedAt, 0, sizeof(uint32_t) * numVertices);
+         uint32_t timestamp = 0;
+
+         /* Split at hard boundaries (where the cache is fully missed), and
+          * then split those at soft boundaries (where the ACMR until there
+          * is near enough of the hard cluster one). */
+         Cluster* clusters = new Cluster[numTriangles];
+         uint32_t numClusters = 0;
+         uint32_t hardStart = 0;
+         for(uint32_t t = 1; t <= numTriangles; t++)
+         {
+            if((t < numTriangles) && (misses[t] != 3))
+            {
+               continue;
+            }
+            /* [hardStart, t) is a hard cluster */
+            uint32_t hardMisses = 0;
+            for(uint32_t i = hardStart; i < t; i++)
+            {
+               hardMisses += misses[i];
+            }
+            Ogre::Real maxAcmr = threshold * hardMisses / 
+               (Ogre::Real)(t - hardStart);
+
+            /* Simulate a cold cache from each soft cluster start, as 
+             * that is the situation it will be after sorting. */
+            uint32_t softStart = hardStart;
+            uint32_t softMisses = 0;
+            timestamp += cacheSize + 1;
+            for(uint32_t i = hardStart; i < t; i++)
+            {
+               for(int j = 0; j < 3; j++)
+               {
+                  IndexType v = indexData[i * 3 + j];
+                  if(timestamp - insertedAt[v] > cacheSize)
+                  {
+                     insertedAt[v] = timestamp++;
+                     softMisses++;
+                  }
+               }
+               if((i + 1 == t) || 
+                  (softMisses / (Ogre::Real)(i + 1 - softStart) <= maxAcmr))
+               {
+                  clusters[numClusters].first = softStart;
+                  clusters[numClusters].count = i + 1 - softStart;
+                  numClusters++;
+                  softStart = i + 1;
+                  softMisses = 0;
+                  timestamp += cacheSize + 1;
+               }
+            }
+            hardStart = t;
+         }
+         delete[] misses;
+         delete[] insertedAt;
+
+         /* Mesh centroid */
+         Ogre::Vector3 meshCentroid = Ogre::Vector3::ZERO;
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            meshCentroid += *reinterpret_cast<const Ogre::Vector3*>(
+                  vertexData + v * bytesPerVertex + posStride);
+         }
+         meshCentroid = meshCentroid / (Ogre::Real)numVertices;
+
+         /* Define each cluster sort key: its (area weighted) centroid 
+          * distance to the mesh centroid along its (average) normal */
+         for(uint32_t c = 0; c < numClusters; c++)
+         {
+            Ogre::Vector3 centroid = Ogre::Vector3::ZERO;
+            Ogre::Vector3 normal = Ogre::Vector3::ZERO;
+            Ogre::Real area = 0.0f;
+            for(uint32_t t = clusters[c].first; 
+                t < clusters[c].first + clusters[c].count; t++)
+            {
+               const Ogre::Vector3* p[3];
+               for(int j = 0; j < 3; j++)
+               {
+                  p[j] = reinterpret_cast<const Ogre::Vector3*>(vertexData +
+                        indexData[t * 3 + j] * bytesPerVertex + posStride);
+               }
+               Ogre::Vector3 n = (*p[1] - *p[0]).crossProduct(*p[2] - *p[0]);
+               Ogre::Real triArea = n.length();
+               centroid += (*p[0] + *p[1] + *p[2]) * (triArea / 3.0f);
+               normal += n;
+               area += triArea;
+            }
+            if(area > 0.0f)
+            {
+               centroid = centroid / area;
+            }
+            normal.normalise();
+            clusters[c].sortKey = (centroid - meshCentroid).dotProduct(
+                  normal);
+         }
+
+         std::stable_sort(clusters, clusters + numClusters);
+
+         /* Rewrite the index buffer at the clusters order */
+         IndexType* output = new IndexType[numTriangles * 3];
+         uint32_t cur = 0;
+         for(uint32_t c = 0; c < numClusters; c++)
+         {
+            memcpy(&output[cur], &indexData[clusters[c].first * 3], 
+                  sizeof(IndexType) * clusters[c].count * 3);
+            cur += clusters[c].count * 3;
+         }
+         memcpy(indexData, output, sizeof(IndexType) * numTriangles * 3);
+
+         delete[] output;
+         delete[] clusters;
+      }
+
+      /*! \see VertexUtils::optimizeVertexFetch */
+      static void optimizeVertexFetch(uint8_t* vertexData, 
+            uint32_t bytesPerVertex, uint32_t numVertices, 
+            IndexType* indexData, uint32_t numIndices, uint32_t* remap)
+      {
+         bool ownRemap = (remap == NULL);
+         if(ownRemap)
+         {
+            remap = new uint32_t[numVertices];
+         }
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            remap[v] = 0xFFFFFFFF;
+         }
+
+         /* Order of first use */
+         uint32_t next = 0;
+         for(uint32_t i = 0; i < numIndices; i++)
+         {
+            IndexType v = indexData[i];
+            if(remap[v] == 0xFFFFFFFF)
+            {
+               remap[v] = next++;
+            }
+            indexData[i] = (IndexType)remap[v];
+         }
+         /* Not used ones, at the end */
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            if(remap[v] == 0xFFFFFFFF)
+            {
+               remap[v] = next++;
+            }
+         }
+
+         /* Reorder the vertex buffer */
+         uint8_t* reordered = new uint8_t[numVertices * bytesPerVertex];
+         for(uint32_t v = 0; v < numVertices; v++)
+         {
+            memcpy(reordered + remap[v] * bytesPerVertex, 
+                   vertexData + v * bytesPerVertex, bytesPerVertex);
+         }
+         memcpy(vertexData, reordered, numVertices * bytesPerVertex);
+         delete[] reordered;
+
+         if(ownRemap)
+         {
+            delete[] remap;
+         }
+      }
+};
+
+}
+
+/***********************************************************************
+ *                         optimizeVertexCache                         *
+ ***********************************************************************/
+void VertexUtils::optimizeVertexCache(Ogre::uint16* indexData, 
+      uint32_t numIndices, uint32_t numVertices)
+{
+   IndexOptimizer<Ogre::uint16>::optimizeVertexCache(indexData, numIndices,
+         numVertices);
+}
+
+/***********************************************************************
+ *                         optimizeVertexCache                         *
+ ***********************************************************************/
+void VertexUtils::optimizeVertexCache(Ogre::uint32* indexData, 
+      uint32_t numIndices, uint32_t numVertices)
+{
+   IndexOptimizer<Ogre::uint32>::optimizeVertexCache(indexData, numIndices,
+         numVertices);
+}
+
+/***********************************************************************
+ *                          optimizeOverdraw                           *
+ ***********************************************************************/
+void VertexUtils::optimizeOverdraw(Ogre::uint16* indexData, 
+      uint32_t numIndices, const uint8_t* vertexData, uint32_t bytesPerVertex,
+      uint32_t numVertices, uint32_t posStride, Ogre::Real threshold)
+{
+   IndexOptimizer<Ogre::uint16>::optimizeOverdraw(indexData, numIndices,
+         vertexData, bytesPerVertex, numVertices, posStride, threshold);
+}
+
+/***********************************************************************
+ *                          optimizeOverdraw                           *
+ ***********************************************************************/
+void VertexUtils::optimizeOverdraw(Ogre::uint32* indexData, 
+      uint32_t numIndices, const uint8_t* vertexData, uint32_t bytesPerVertex,
+      uint32_t numVertices, uint32_t posStride, Ogre::Real threshold)
+{
+   IndexOptimizer<Ogre::uint32>::optimizeOverdraw(indexData, numIndices,
+         vertexData, bytesPerVertex, numVertices, posStride, threshold);
+}
+
+/***********************************************************************
+ *                         optimizeVertexFetch                         *
+ ***********************************************************************/
+void VertexUtils::optimizeVertexFetch(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, Ogre::uint16* indexData,
+      uint32_t numIndices, uint32_t* remap)
+{
+   IndexOptimizer<Ogre::uint16>::optimizeVertexFetch(vertexData, 
+         bytesPerVertex, numVertices, indexData, numIndices, remap);
+}
+
+/***********************************************************************
+ *                         optimizeVertexFetch                         *
+ ***********************************************************************/
+void VertexUtils::optimizeVertexFetch(uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, Ogre::uint32* indexData,
+      uint32_t numIndices, uint32_t* remap)
+{
+   IndexOptimizer<Ogre::uint32>::optimizeVertexFetch(vertexData, 
+         bytesPerVertex, numVertices, indexData, numIndices, remap);
+}
+
+/***********************************************************************
+ *                         analyzeVertexCache                          *
+ ***********************************************************************/
+VertexCacheStatistics VertexUtils::analyzeVertexCache(
+      const Ogre::uint16* indexData, uint32_t numIndices, 
+      uint32_t numVertices, uint32_t cacheSize)
+{
+   return IndexOptimizer<Ogre::uint16>::simulateCache(indexData, numIndices,
+         numVertices, cacheSize, NULL);
+}
+
+/***********************************************************************
+ *                         analyzeVertexCache                          *
+ ***********************************************************************/
+VertexCacheStatistics VertexUtils::analyzeVertexCache(
+      const Ogre::uint32* indexData, uint32_t numIndices, 
+      uint32_t numVertices, uint32_t cacheSize)
+{
+   return IndexOptimizer<Ogre::uint32>::simulateCache(indexData, numIndices,
+         numVertices, cacheSize, NULL);
+}
+
+namespace Goblin
+{
+
+/*! Minimum dot product between the normal cone axis and each meshlet 
+ * triangle normal to have a usable cone (about 84 degrees of spread). */
+#define MESHLET_MIN_CONE_DOT  0.1f
+
+/*! Greedy meshlet builder, for both index types */
+template<typename IndexType> class MeshletBuilder
+{
+   public:
+      MeshletBuilder(const uint8_t* vertexData, uint32_t bytesPerVertex, 
+            uint32_t numVertices, uint32_t posStride, 
+            const IndexType* indexData, uint32_t numIndices,
+            uint32_t maxVertices, uint32_t maxTriangles, MeshletList& out)
+         : vertexData(vertexData), bytesPerVertex(bytesPerVertex),
+           numVertices(numVertices), posStride(posStride),
+           indexData(indexData), numTriangles(numIndices / 3),
+           maxVertices(maxVertices), maxTriangles(maxTriangles), out(out)
+      {
+      };
+
+      /*! Build all meshlets */
+      void build()
+      {
+         out.clear();
+         if((numTriangles == 0) || (maxVertices < 3) || (maxTriangles == 0))
+         {
+            return;
+         }
+
+         buildAdjacency();
+         std::vector<bool> used(numTriangles, false);
+         localIndex.assign(numVertices, -1);
+
+         Meshlet cur;
+         startMeshlet(cur);
+         uint32_t seed = 0; /* First maybe not used triangle */
+
+         for(uint32_t added = 0; added < numTriangles; added++)
+         {
+            /* Best neighbour of the meshlet triangles */
+            uint32_t newVertices = 0;
+            uint32_t next = numTriangles;
+            if(cur.vertexCount > 0)
+            {
+               next = bestNeighbour(&out.vertices[cur.vertexOffset], 
+                     cur.vertexCount, used, newVertices);
+            }
+
+            if((next == numTriangles) || 
+               (cur.vertexCount + newVertices > maxVertices) ||
+               (cur.triangleCount == maxTriangles))
+            {
+               /* Can't grow: close it and start the next one from the
+                * first free triangle. */
+               if(cur.triangleCount > 0)
+               {
+                  finishMeshlet(cur);
+                  startMeshlet(cur);
+               }
+               while(used[seed])
+               {
+                  seed++;
+               }
+               next = seed;
+            }
+
+            addTriangle(cur, next);
+            used[next] = true;
+         }
+         finishMeshlet(cur);
+      }
+
+   private:
+      /*! \return position of vertex v */
+      const Ogre::Vector3& position(uint32_t v) const
+      {
+         return *reinterpret_cast<const Ogre::Vector3*>(vertexData + 
+               v * bytesPerVertex + posStride);
+      }
+
+      /*! Build the vertex to triangles adjacency (as CSR) */
+      void buildAdjacency()
+      {
+         triangleStart.assign(numVertices + 1, 0);
+         for(uint32_t i = 0; i < numTriangles * 3; i++)
+         {
+            triangleStart[indexData[i] + 1]++;
+         }
+         for(uint32_t i = 0; i < numVertices; i++)
+         {
+            triangleStart[i + 1] += triangleStart[i];
+         }
+         triangles.resize(numTriangles * 3);
+         std::vector<uint32_t> cursor(triangleStart.begin(), 
+               triangleStart.end() - 1);
+         for(uint32_t i = 0; i < numTriangles * 3; i++)
+         {
+            triangles[cursor[indexData[i]]++] = i / 3;
+         }
+      }
+
+      /*! \return free triangle, using any of the vertices, which adds 
+       * less new vertices to the current meshlet (numTriangles if none).
+       * \param newVertices number of new vertices it adds. */
+      template<typename VertexIndex>
+      uint32_t bestNeighbour(const VertexIndex* vertices, uint32_t count,
+            const std::vector<bool>& used, uint32_t& newVertices)
+      {
+         uint32_t best = numTriangles;
+         newVertices = 4;
+         for(uint32_t i = 0; i < count; i++)
+         {
+            uint32_t v = vertices[i];
+            for(uint32_t t = triangleStart[v]; t < triangleStart[v + 1]; t++)
+            {
+               uint32_t tri = triangles[t];
+               if(used[tri])
+               {
+                  continue;
+               }
+               const IndexType* idx = indexData + tri * 3;
+               uint32_t extra = (localIndex[idx[0]] < 0) + 
+                  (localIndex[idx[1]] < 0) + (localIndex[idx[2]] < 0);
+               if(extra < newVertices)
+               {
+                  best = tri;
+                  newVertices = extra;
+                  if(extra == 0)
+                  {
+                     return best;
+                  }
+               }
+            }
+         }
+         return best;
+      }
+
+      /*! Start a new, empty, meshlet */
+      void startMeshlet(Meshlet& m)
+      {
+         m.vertexOffset = (uint32_t)out.vertices.size();
+         m.vertexCount = 0;
+         m.triangleOffset = (uint32_t)out.triangles.size();
+         m.triangleCount = 0;
+      }
+
+      /*! Add triangle tri to meshlet m */
+      void addTriangle(Meshlet& m, uint32_t tri)
+      {
+         const IndexType* idx = indexData + tri * 3;
+         for(int j = 0; j < 3; j++)
+         {
+            if(localIndex[idx[j]] < 0)
+            {
+               localIndex[idx[j]] = m.vertexCount++;
+               out.vertices.push_back(idx[j]);
+            }
+            out.triangles.push_back((uint8_t)localIndex[idx[j]]);
+         }
+         m.triangleCount++;
+      }
+
+      /*! Calculate the bounds of meshlet m and add it to the list */
+      void finishMeshlet(Meshlet& m)
+      {
+         const uint32_t* verts = &out.vertices[m.vertexOffset];
+         const uint8_t* tris = &out.triangles[m.triangleOffset];
+
+         /* Bounding sphere (Ritter's): start with the sphere of the most
+          * distant pair found by two sweeps, then grow it to include any
+          * point outside. */
+         const Ogre::Vector3& p0 = position(verts[0]);
+         uint32_t a = 0;
+         Ogre::Real maxDist = -1.0f;
+         for(uint32_t i = 0; i < m.vertexCount; i++)
+         {
+            Ogre::Real d = p0.squaredDistance(position(verts[i]));
+            if(d > maxDist)
+            {
+               maxDist = d;
+               a = i;
+            }
+         }
+         const Ogre::Vector3& pa = position(verts[a]);
+         uint32_t b = a;
+         maxDist = -1.0f;
+         for(uint32_t i = 0; i < m.vertexCount; i++)
+         {
+            Ogre::Real d = pa.squaredDistance(position(verts[i]));
+            if(d > maxDist)
+            {
+               maxDist = d;
+               b = i;
+            }
+         }
+         m.center = (pa + position(verts[b])) * 0.5f;
+         m.radius = Ogre::Math::Sqrt(maxDist) * 0.5f;
+         for(uint32_t i = 0; i < m.vertexCount; i++)
+         {
+            const Ogre::Vector3& p = position(verts[i]);
+            Ogre::Real d = m.center.distance(p);
+            if(d > m.radius)
+            {
+               Ogre::Real newRadius = (m.radius + d) * 0.5f;
+               m.center += (p - m.center) * ((newRadius - m.radius) / d);
+               m.radius = newRadius;
+            }
+         }
+
+         /* Normal cone: the average normal as axis, and the most 
+          * divergent normal as its spread. */
+         normals.resize(m.triangleCount);
+         Ogre::Vector3 axis = Ogre::Vector3::ZERO;
+         for(uint32_t t = 0; t < m.triangleCount; t++)
+         {
+            const Ogre::Vector3& t0 = position(verts[tris[t * 3]]);
+            Ogre::Vector3 n = (position(verts[tris[t * 3 + 1]]) - t0).
+               crossProduct(position(verts[tris[t * 3 + 2]]) - t0);
+            Ogre::Real len = n.length();
+            normals[t] = (len > 0.0f) ? n / len : Ogre::Vector3::ZERO;
+            axis += normals[t];
+         }
+         Ogre::Real minDot = -1.0f;
+         Ogre::Real axisLen = axis.length();
+         if(axisLen > 0.0f)
+         {
+            axis /= axisLen;
+            minDot = 1.0f;
+            for(uint32_t t = 0; t < m.triangleCount; t++)
+            {
+               if(normals[t] != Ogre::Vector3::ZERO)
+               {
+                  minDot = std::min(minDot, axis.dotProduct(normals[t]));
+               }
+            }
+         }
+
+         if(minDot < MESHLET_MIN_CONE_DOT)
+         {
+            /* Never back face culled */
+            m.coneApex = m.center;
+            m.coneAxis = Ogre::Vector3::ZERO;
+            m.coneCutoff = 1.0f;
+         }
+         else
+         {
+            /* Apex: the point, along -axis from the center, behind all 
+             * triangles planes. */
+            Ogre::Real maxT = 0.0f;
+            for(uint32_t t = 0; t < m.triangleCount; t++)
+            {
+               if(normals[t] == Ogre::Vector3::ZERO)
+               {
+                  continue;
+               }
+               const Ogre::Vector3& t0 = position(verts[tris[t * 3]]);
+               Ogre::Real dc = (m.center - t0).dotProduct(normals[t]);
+               Ogre::Real dn = axis.dotProduct(normals[t]);
+               maxT = std::max(maxT, dc / dn);
+            }
+            m.coneApex = m.center - axis * maxT;
+            m.coneAxis = axis;
+            m.coneCutoff = Ogre::Math::Sqrt(1.0f - minDot * minDot);
+         }
+
+         /* Done with its vertices */
+         for(uint32_t i = 0; i < m.vertexCount; i++)
+         {
+            localIndex[verts[i]] = -1;
+         }
+         out.meshlets.push_back(m);
+      }
+
+      const uint8_t* vertexData;
+      uint32_t bytesPerVertex;
+      uint32_t numVertices;
+      uint32_t posStride;
+      const IndexType* indexData;
+      uint32_t numTriangles;
+      uint32_t maxVertices;
+      uint32_t maxTriangles;
+      MeshletList& out;
+
+      std::vector<uint32_t> triangleStart; /**< Per vertex at triangles */
+      std::vector<uint32_t> triangles; /**< Triangles of each vertex */
+      std::vector<int> localIndex; /**< Index on current meshlet, or -1 */
+      std::vector<Ogre::Vector3> normals; /**< Current meshlet normals */
+};
+
+}
+
+/***********************************************************************
+ *                            buildMeshlets                            *
+ ***********************************************************************/
+void VertexUtils::buildMeshlets(const uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, uint32_t posStride,
+      const Ogre::uint16* indexData, uint32_t numIndices, MeshletList& out,
+      uint32_t maxVertices, uint32_t maxTriangles)
+{
+   MeshletBuilder<Ogre::uint16> builder(vertexData, bytesPerVertex, 
+         numVertices, posStride, indexData, numIndices, 
+         std::min(maxVertices, 256u), maxTriangles, out);
+   builder.build();
+}
+
+/***********************************************************************
+ *                            buildMeshlets                            *
+ ***********************************************************************/
+void VertexUtils::buildMeshlets(const uint8_t* vertexData, 
+      uint32_t bytesPerVertex, uint32_t numVertices, uint32_t posStride,
+      const Ogre::uint32* indexData, uint32_t numIndices, MeshletList& out,
+      uint32_t maxVertices, uint32_t maxTriangles)
+{
+   MeshletBuilder<Ogre::uint32> builder(vertexData, bytesPerVertex, 
+         numVertices, posStride, indexData, numIndices, 
+         std::min(maxVertices, 256u), maxTriangles, out);
+   builder.build();
+}
+
+/***********************************************************************
+ *                        simplifyByClustering                         *
+ ***********************************************************************/
+void VertexUtils::simplifyByClustering(const Ogre::Vector3* vertices,
+      uint32_t numVertices, const Ogre::uint32* indexData,
+      uint32_t numIndices, uint32_t gridSize,
+      std::vector<Ogre::Vector3>& outVertices,
+      std::vector<Ogre::uint32>& outIndices)
+{
+   outVertices.clear();
+   outIndices.clear();
+   if((numVertices == 0) || (gridSize == 0))
+   {
+      return;
+   }
+
+   /* Define the grid over the bounds */
+   Ogre::Vector3 vMin = vertices[0];
+   Ogre::Vector3 vMax = vertices[0];
+   for(uint32_t i = 1; i < numVertices; i++)
+   {
+      vMin.makeFloor(vertices[i]);
+      vMax.makeCeil(vertices[i]);
+   }
+   gridSize = std::min(gridSize, 0x1FFFFFu);
+   Ogre::Vector3 extent = vMax - vMin;
+   Ogre::Real longest = std::max(extent.x, std::max(extent.y, extent.z));
+   Ogre::Real invCellSize = (longest > 0.0f) ? gridSize / longest : 0.0f;
+
+   /* Sort the vertices by cell (with 21 bits per axis at the key) */
+   std::vector< std::pair<Ogre::uint64, uint32_t> > cells(numVertices);
+   for(uint32_t i = 0; i < numVertices; i++)
+   {
+      Ogre::uint64 key = 0;
+      for(int axis = 0; axis < 3; axis++)
+      {
+         Ogre::uint64 c = static_cast<Ogre::uint64>(
+               (vertices[i][axis] - vMin[axis]) * invCellSize);
+         key = (key << 21) | std::min(c, (Ogre::uint64) gridSize - 1);
+      }
+      cells[i] = std::make_pair(key, i);
+   }
+   std::sort(cells.begin(), cells.end());
+
+   /* Merge each cell vertices on their average */
+   std::vector<Ogre::uint32> remap(numVertices);
+   for(uint32_t i = 0; i < numVertices; )
+   {
+      uint32_t end = i + 1;
+      while((end < numVertices) && (cells[end].first == cells[i].first))
+      {
+         end++;
+      }
+      Ogre::Vector3 sum = Ogre::Vector3::ZERO;
+      for(uint32_t k = i; k < end; k++)
+      {
+         sum += vertices[cells[k].second];
+         remap[cells[k].second] = (Ogre::uint32) outVertices.size();
+      }
+      outVertices.push_back(sum / (Ogre::Real)(end - i));
+      i = end;
+   }
+
+   /* Keep only the non collapsed triangles */
+   outIndices.reserve(numIndices);
+   for(uint32_t i = 0; i + 2 < numIndices; i += 3)
+   {
+      Ogre::uint32 a = remap[indexData[i]];
+      Ogre::uint32 b = remap[indexData[i + 1]];
+      Ogre::uint32 c = remap[indexData[i + 2]];
+      if((a != b) && (b != c) && (a != c))
+      {
+         outIndices.push_back(a);
+         outIndices.push_back(b);
+         outIndices.push_back(c);
+      }
+   }
+}
+
+/***********************************************************************
+ *                         transformPositions                          *
+ ***********************************************************************/
+void VertexUtils::transformPositions(const Ogre::Vector3* src, 
+      Ogre::Vector3* dst, uint32_t count, const Ogre::Quaternion& orientation,
+      const Ogre::Vector3& position, Ogre::Vector3& outMin, 
+      Ogre::Vector3& outMax)
+{
+   if(count == 0)
+   {
+      return;
+   }
+
+   Ogre::Matrix3 rot;
+   orientation.ToRotationMatrix(rot);
+   float m[9];
+   for(int row = 0; row < 3; row++)
+   {
+      for(int col = 0; col < 3; col++)
+      {
+         m[row * 3 + col] = rot[row][col];
+      }
+   }
+
+   if(simdPath != SIMD_PATH_SCALAR)
+   {
+      transformPositionsSimd4(src, dst, count, m, position, outMin, outMax);
+      return;
+   }
+
+   Ogre::Vector3 vMin(Ogre::Math::POS_INFINITY);
+   Ogre::Vector3 vMax(Ogre::Math::NEG_INFINITY);
+   for(uint32_t i = 0; i < count; i++)
+   {
+      const Ogre::Vector3 p = src[i];
+      dst[i] = Ogre::Vector3(
+            m[0] * p.x + m[1] * p.y + m[2] * p.z + position.x,
+            m[3] * p.x + m[4] * p.y + m[5] * p.z + position.y,
+            m[6] * p.x + m[7] * p.y + m[8] * p.z + position.z);
+      vMin.makeFloor(dst[i]);
+      vMax.makeCeil(dst[i]);
+   }
+   outMin = vMin;
+   outMax = vMax;
+}
+
+/***********************************************************************
+ *                       transformPositionsSimd4                       *
+ ***********************************************************************/
+void VertexUtils::transformPositionsSimd4(const Ogre::Vector3* src, 
+      Ogre::Vector3* dst, uint32_t count, const float* m, 
+      const Ogre::Vector3& position, Ogre::Vector3& outMin, 
+      Ogre::Vector3& outMax)
+{
+   using namespace Simd;
+
+   /* Each position is transformed as a whole (x, y, z, unused) by the
+    * matrix columns, thus with no need to gather them. */
+   const Float4 col0 = set(m[0], m[3], m[6], 0.0f);
+   const Float4 col1 = set(m[1], m[4], m[7], 0.0f);
+   const Float4 col2 = set(m[2], m[5], m[8], 0.0f);
+   const Float4 trans = set(position.x, position.y, position.z, 0.0f);
+
+   Float4 bMin = set1(Ogre::Math::POS_INFINITY);
+   Float4 bMax = set1(Ogre::Math::NEG_INFINITY);
+
+   /* Note: 4 floats are stored for each position, so its last one 
+    * overwrites the next position x, which must be already read (as src
+    * could be dst) and is rewritten on the next iteration. */
+   float* out = reinterpret_cast<float*>(dst);
+   Float4 next = madd(col0, set1(src[0].x), madd(col1, set1(src[0].y), 
+            madd(col2, set1(src[0].z), trans)));
+   uint32_t i = 0;
+   for( ; i + 1 < count; i++)
+   {
+      Float4 cur = next;
+      const Ogre::Vector3& p = src[i + 1];
+      next = madd(col0, set1(p.x), madd(col1, set1(p.y), 
+               madd(col2, set1(p.z), trans)));
+      bMin = min(bMin, cur);
+      bMax = max(bMax, cur);
+      store(out + i * 3, cur);
+   }
+
+   /* Last one, without overflowing dst */
+   bMin = min(bMin, next);
+   bMax = max(bMax, next);
+   float last[4];
+   store(last, next);
+   dst[i] = Ogre::Vector3(last[0], last[1], last[2]);
+
+   float lanes[4];
+   store(lanes, bMin);
+   Ogre::Vector3 vMin(lanes[0], lanes[1], lanes[2]);
+   store(lanes, bMax);
+   Ogre::Vector3 vMax(lanes[0], lanes[1], lanes[2]);
+   outMin = vMin;
+   outMax = vMax;
+}
+
+namespace Goblin
+{
+
+/*! Element-wise conversion between two strided vertex streams, 
+ * seen as a flat sequence of components * count values. The Kernel 
+ * defines SrcType, DstType, and convert1 / convert4 functions. */
+template<class Kernel> class StreamConverter
+{
+   public:
+      typedef typename Kernel::SrcType SrcType;
+      typedef typename Kernel::DstType DstType;
+
+      static void convert(const uint8_t* src, uint32_t srcBytesPerVertex,
+            uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+            uint32_t count, bool vectorized)
+      {
+         uint32_t total = components * count;
+         uint32_t k = 0;
+         if(vectorized)
+         {
+            if((srcBytesPerVertex == components * sizeof(SrcType)) &&
+               (dstBytesPerVertex == components * sizeof(DstType)))
+            {
+               /* Contiguous streams: no need to gather */
+               const SrcType* s = reinterpret_cast<const SrcType*>(src);
+               DstType* d = reinterpret_cast<DstType*>(dst);
+               for( ; k + 4 <= total; k += 4)
+               {
+                  Kernel::convert4(s + k, d + k);
+               }
+            }
+            else
+            {
+               SrcType in[4];
+               DstType out[4];
+               for( ; k + 4 <= total; k += 4)
+               {
+                  uint32_t e = k / components;
+                  uint32_t c = k - e * components;
+                  uint32_t ce = e, cc = c;
+                  for(int j = 0; j < 4; j++)
+                  {
+                     in[j] = *(reinterpret_cast<const SrcType*>(
+                              src + ce * srcBytesPerVertex) + cc);
+                     if(++cc == components)
+                     {
+                        cc = 0;
+                        ce++;
+                     }
+                  }
+                  Kernel::convert4(in, out);
+                  for(int j = 0; j < 4; j++)
+                  {
+                     *(reinterpret_cast<DstType*>(
+                              dst + e * dstBytesPerVertex) + c) = out[j];
+                     if(++c == components)
+                     {
+                        c = 0;
+                        e++;
+                     }
+                  }
+               }
+            }
+         }
+
+         /* Remaining (or all, if scalar) values */
+         for( ; k < total; k++)
+         {
+            uint32_t e = k / components;
+            uint32_t c = k - e * components;
+            *(reinterpret_cast<DstType*>(dst + e * dstBytesPerVertex) + c) =
+               Kernel::convert1(*(reinterpret_cast<const SrcType*>(
+                        src + e * srcBytesPerVertex) + c));
+         }
+      }
+};
+
+/*! float -> half */
+class HalfPacker
+{
+   public:
+      typedef float SrcType;
+      typedef Ogre::uint16 DstType;
+      static DstType convert1(SrcType v) { return Simd::floatToHalf(v); }
+      static void convert4(const SrcType* s, DstType* d)
+      {
+         Simd::storeHalf4(d, Simd::load(s));
+      }
+};
+
+/*! half -> float */
+class HalfUnpacker
+{
+   public:
+      typedef Ogre::uint16 SrcType;
+      typedef float DstType;
+      static DstType convert1(SrcType v) { return Simd::halfToFloat(v); }
+      static void convert4(const SrcType* s, DstType* d)
+      {
+         Simd::store(d, Simd::loadHalf4(s));
+      }
+};
+
+/*! float -> snorm16 */
+class Snorm16Packer
+{
+   public:
+      typedef float SrcType;
+      typedef Ogre::int16 DstType;
+      static DstType convert1(SrcType v) { return Simd::floatToSnorm16(v); }
+      static void convert4(const SrcType* s, DstType* d)
+      {
+         Simd::storeSnorm16x4(d, Simd::load(s));
+      }
+};
+
+/*! snorm16 -> float */
+class Snorm16Unpacker
+{
+   public:
+      typedef Ogre::int16 SrcType;
+      typedef float DstType;
+      static DstType convert1(SrcType v) { return Simd::snorm16ToFloat(v); }
+      static void convert4(const SrcType* s, DstType* d)
+      {
+         Simd::store(d, Simd::loadSnorm16x4(s));
+      }
+};
+
+/*! Minimum absolute w of a QTangent, so its sign (the handedness) 
+ * survives the snorm16 quantization. */
+#define QTANGENT_BIAS  (1.0f / 32767.0f)
+
+}
+
+/***********************************************************************
+ *                              packHalf                               *
+ ***********************************************************************/
+void VertexUtils::packHalf(const uint8_t* src, uint32_t srcBytesPerVertex,
+      uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+      uint32_t count)
+{
+#if defined(GOBLIN_SIMD_AVX2)
+   if((simdPath == SIMD_PATH_8) && 
+      (srcBytesPerVertex == components * sizeof(float)) &&
+      (dstBytesPerVertex == components * sizeof(Ogre::uint16)))
+   {
+      packHalfSimd8(reinterpret_cast<const float*>(src), 
+            reinterpret_cast<Ogre::uint16*>(dst), components * count);
+      return;
+   }
+#endif
+   StreamConverter<HalfPacker>::convert(src, srcBytesPerVertex, dst, 
+         dstBytesPerVertex, components, count, simdPath != SIMD_PATH_SCALAR);
+}
+
+/***********************************************************************
+ *                             unpackHalf                              *
+ ***********************************************************************/
+void VertexUtils::unpackHalf(const uint8_t* src, uint32_t srcBytesPerVertex,
+      uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+      uint32_t count)
+{
+#if defined(GOBLIN_SIMD_AVX2)
+   if((simdPath == SIMD_PATH_8) && 
+      (srcBytesPerVertex == components * sizeof(Ogre::uint16)) &&
+      (dstBytesPerVertex == components * sizeof(float)))
+   {
+      unpackHalfSimd8(reinterpret_cast<const Ogre::uint16*>(src), 
+            reinterpret_cast<float*>(dst), components * count);
+      return;
+   }
+#endif
+   StreamConverter<HalfUnpacker>::convert(src, srcBytesPerVertex, dst, 
+         dstBytesPerVertex, components, count, simdPath != SIMD_PATH_SCALAR);
+}
+
+/***********************************************************************
+ *                            packSnorm16                              *
+ ***********************************************************************/
+void VertexUtils::packSnorm16(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* dst, uint32_t dstBytesPerVertex,
+      uint32_t components, uint32_t count)
+{
+   StreamConverter<Snorm16Packer>::convert(src, srcBytesPerVertex, dst, 
+         dstBytesPerVertex, components, count, simdPath != SIMD_PATH_SCALAR);
+}
+
+/***********************************************************************
+ *                           unpackSnorm16                             *
+ ***********************************************************************/
+void VertexUtils::unpackSnorm16(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* dst, uint32_t dstBytesPerVertex,
+      uint32_t components, uint32_t count)
+{
+   StreamConverter<Snorm16Unpacker>::convert(src, srcBytesPerVertex, dst, 
+         dstBytesPerVertex, components, count, simdPath != SIMD_PATH_SCALAR);
+}
+
+namespace Goblin
+{
+
+/*! Normalized integer to float, for the types without vectorized path */
+template<typename IntType, int Divisor, bool Signed> class NormDecoder
+{
+   public:
+      static void decode(const uint8_t* src, uint32_t srcBytesPerVertex,
+            uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+            uint32_t count)
+      {
+         const float scale = 1.0f / Divisor;
+         for(uint32_t i = 0; i < count; i++)
+         {
+            const IntType* in = reinterpret_cast<const IntType*>(
+                  src + i * srcBytesPerVertex);
+            float* out = reinterpret_cast<float*>(dst + 
+                  i * dstBytesPerVertex);
+            for(uint32_t c = 0; c < components; c++)
+            {
+               float v = in[c] * scale;
+               out[c] = (Signed && v < -1.0f) ? -1.0f : v;
+            }
+         }
+      }
+};
+
+}
+
+/***********************************************************************
+ *                         decodeVertexStream                          *
+ ***********************************************************************/
+bool VertexUtils::decodeVertexStream(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, Ogre::VertexElementType type, 
+      uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components, 
+      uint32_t count)
+{
+   switch(type)
+   {
+      case Ogre::VET_FLOAT1:
+      case Ogre::VET_FLOAT2:
+      case Ogre::VET_FLOAT3:
+      case Ogre::VET_FLOAT4:
+      {
+         if(components > (uint32_t)(type - Ogre::VET_FLOAT1) + 1)
+         {
+            return false;
+         }
+         size_t bytes = components * sizeof(float);
+         if((srcBytesPerVertex == bytes) && (dstBytesPerVertex == bytes))
+         {
+            memcpy(dst, src, bytes * count);
+         }
+         else
+         {
+            for(uint32_t i = 0; i < count; i++)
+            {
+               memcpy(dst + i * dstBytesPerVertex, 
+                     src + i * srcBytesPerVertex, bytes);
+            }
+         }
+      }
+      break;
+      case Ogre::VET_HALF2:
+      {
+         if(components > 2)
+         {
+            return false;
+         }
+         unpackHalf(src, srcBytesPerVertex, dst, dstBytesPerVertex, 
+               components, count);
+      }
+      break;
+      case Ogre::VET_HALF4:
+      {
+         if(components > 4)
+         {
+            return false;
+         }
+#if defined(GOBLIN_SIMD_AVX2)
+         if(simdPath == SIMD_PATH_8)
+         {
+            decodeHalf4Simd8(src, srcBytesPerVertex, dst, dstBytesPerVertex,
+                  components, count);
+            break;
+         }
+#endif
+         decodeHalf4(src, srcBytesPerVertex, dst, dstBytesPerVertex, 
+               components, count);
+      }
+      break;
+      case Ogre::VET_SHORT2_SNORM:
+      case Ogre::VET_SHORT4_SNORM:
+      {
+         if(components > ((type == Ogre::VET_SHORT2_SNORM) ? 2u : 4u))
+         {
+            return false;
+         }
+         unpackSnorm16(src, srcBytesPerVertex, dst, dstBytesPerVertex, 
+               components, count);
+      }
+      break;
+      case Ogre::VET_USHORT2_NORM:
+      case Ogre::VET_USHORT4_NORM:
+      {
+         if(components > ((type == Ogre::VET_USHORT2_NORM) ? 2u : 4u))
+         {
+            return false;
+         }
+         NormDecoder<Ogre::uint16, 65535, false>::decode(src, 
+               srcBytesPerVertex, dst, dstBytesPerVertex, components, count);
+      }
+      break;
+      case Ogre::VET_BYTE4_SNORM:
+      {
+         if(components > 4)
+         {
+            return false;
+         }
+         NormDecoder<Ogre::int8, 127, true>::decode(src, srcBytesPerVertex,
+               dst, dstBytesPerVertex, components, count);
+      }
+      break;
+      case Ogre::VET_UBYTE4_NORM:
+      {
+         if(components > 4)
+         {
+            return false;
+         }
+         NormDecoder<Ogre::uint8, 255, false>::decode(src, 
+               srcBytesPerVertex, dst, dstBytesPerVertex, components, count);
+      }
+      break;
+      default:
+      {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+/***********************************************************************
+ *                             decodeHalf4                             *
+ ***********************************************************************/
+void VertexUtils::decodeHalf4(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* dst, uint32_t dstBytesPerVertex,
+      uint32_t components, uint32_t count)
+{
+   if(simdPath == SIMD_PATH_SCALAR)
+   {
+      unpackHalf(src, srcBytesPerVertex, dst, dstBytesPerVertex, 
+            components, count);
+      return;
+   }
+
+   /* One 4-wide conversion per element, storing all its lanes when that
+    * is safe: if decoding all components, or if the destination is packed 
+    * (where the extra lanes are overwritten by the next elements). The 
+    * others go through a temporary. */
+   uint32_t fullStores = 0;
+   if(components == 4)
+   {
+      fullStores = count;
+   }
+   else if(dstBytesPerVertex == components * sizeof(float))
+   {
+      /* Last elements whose 4 lanes would pass the end of dst */
+      uint32_t tail = (4 * sizeof(float) + dstBytesPerVertex - 1) / 
+         dstBytesPerVertex - 1;
+      fullStores = (count > tail) ? count - tail : 0;
+   }
+
+   uint32_t i = 0;
+   for( ; i < fullStores; i++)
+   {
+      Simd::store(reinterpret_cast<float*>(dst + i * dstBytesPerVertex), 
+            Simd::loadHalf4(reinterpret_cast<const Ogre::uint16*>(
+                  src + i * srcBytesPerVertex)));
+   }
+   for( ; i < count; i++)
+   {
+      float tmp[4];
+      Simd::store(tmp, Simd::loadHalf4(reinterpret_cast<
+               const Ogre::uint16*>(src + i * srcBytesPerVertex)));
+      memcpy(dst + i * dstBytesPerVertex, tmp, components * sizeof(float));
+   }
+}
+
+#if defined(GOBLIN_SIMD_AVX2)
+/***********************************************************************
+ *                           decodeHalf4Simd8                          *
+ ***********************************************************************/
+void VertexUtils::decodeHalf4Simd8(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* dst, uint32_t dstBytesPerVertex,
+      uint32_t components, uint32_t count)
+{
+   uint32_t done = Avx2::decodeHalf4(src, srcBytesPerVertex, dst, 
+         dstBytesPerVertex, components, count);
+
+   /* Remaining ones */
+   decodeHalf4(src + done * srcBytesPerVertex, srcBytesPerVertex, 
+         dst + done * dstBytesPerVertex, dstBytesPerVertex, components, 
+         count - done);
+}
+
+/***********************************************************************
+ *                            packHalfSimd8                            *
+ ***********************************************************************/
+void VertexUtils::packHalfSimd8(const float* src, Ogre::uint16* dst,
+      uint32_t total)
+{
+   for(uint32_t i = Avx2::packHalf(src, dst, total); i < total; i++)
+   {
+      dst[i] = Simd::floatToHalf(src[i]);
+   }
+}
+
+/***********************************************************************
+ *                           unpackHalfSimd8                           *
+ ***********************************************************************/
+void VertexUtils::unpackHalfSimd8(const Ogre::uint16* src, float* dst,
+      uint32_t total)
+{
+   for(uint32_t i = Avx2::unpackHalf(src, dst, total); i < total; i++)
+   {
+      dst[i] = Simd::halfToFloat(src[i]);
+   }
+}
+#endif
+
+/***********************************************************************
+ *                          calculateQTangent                          *
+ ***********************************************************************/
+void VertexUtils::calculateQTangent(const float* n, const float* t, 
+      float* q)
+{
+   /* Orthonormal right handed frame: tangent, bitangent, normal */
+   Ogre::Vector3 vN(n[0], n[1], n[2]);
+   vN.normalise();
+   Ogre::Vector3 vT(t[0], t[1], t[2]);
+   vT = vT - vN * vN.dotProduct(vT);
+   vT.normalise();
+   Ogre::Vector3 vB = vN.crossProduct(vT);
+
+   /* Quaternion from the rotation matrix with columns T, B, N,
+    * derived from its largest component (for precision). */
+   float w2 = 1.0f + vT.x + vB.y + vN.z;
+   float x2 = 1.0f + vT.x - vB.y - vN.z;
+   float y2 = 1.0f - vT.x + vB.y - vN.z;
+   float z2 = 1.0f - vT.x - vB.y + vN.z;
+   float a = vB.z - vN.y; /* 4wx */
+   float b = vN.x - vT.z; /* 4wy */
+   float c = vT.y - vB.x; /* 4wz */
+   float d = vB.x + vT.y; /* 4xy */
+   float e = vN.x + vT.z; /* 4xz */
+   float f = vN.y + vB.z; /* 4yz */
+   if((w2 >= x2) && (w2 >= y2) && (w2 >= z2))
+   {
+      float big = 0.5f * sqrtf(w2);
+      float inv = 0.25f / big;
+      q[0] = a * inv; q[1] = b * inv; q[2] = c * inv; q[3] = big;
+   }
+   else if((x2 >= y2) && (x2 >= z2))
+   {
+      float big = 0.5f * sqrtf(x2);
+      float inv = 0.25f / big;
+      q[0] = big; q[1] = d * inv; q[2] = e * inv; q[3] = a * inv;
+   }
+   else if(y2 >= z2)
+   {
+      float big = 0.5f * sqrtf(y2);
+      float inv = 0.25f / big;
+      q[0] = d * inv; q[1] = big; q[2] = f * inv; q[3] = b * inv;
+   }
+   else
+   {
+      float big = 0.5f * sqrtf(z2);
+      float inv = 0.25f / big;
+      q[0] = e * inv; q[1] = f * inv; q[2] = big; q[3] = c * inv;
+   }
+
+   /* Positive w, never zero, so its sign could hold the handedness */
+   if(q[3] < 0.0f)
+   {
+      q[0] = -q[0]; q[1] = -q[1]; q[2] = -q[2]; q[3] = -q[3];
+   }
+   if(q[3] < QTANGENT_BIAS)
+   {
+      float scale = sqrtf(1.0f - QTANGENT_BIAS * QTANGENT_BIAS);
+      q[0] *= scale; q[1] *= scale; q[2] *= scale; 
+      q[3] = QTANGENT_BIAS;
+   }
+   if(t[3] < 0.0f)
+   {
+      q[0] = -q[0]; q[1] = -q[1]; q[2] = -q[2]; q[3] = -q[3];
+   }
+}
+
+/***********************************************************************
+ *                           packQTangents                             *
+ ***********************************************************************/
+void VertexUtils::packQTangents(const uint8_t* normals, 
+      uint32_t normalBytesPerVertex, const uint8_t* tangents, 
+      uint32_t tangentBytesPerVertex, uint8_t* dst, 
+      uint32_t dstBytesPerVertex, uint32_t count)
+{
+   if(simdPath != SIMD_PATH_SCALAR)
+   {
+      packQTangentsSimd4(normals, normalBytesPerVertex, tangents, 
+            tangentBytesPerVertex, dst, dstBytesPerVertex, count);
+      return;
+   }
+
+   float q[4];
+   for(uint32_t i = 0; i < count; i++)
+   {
+      calculateQTangent(
+            reinterpret_cast<const float*>(normals + i * normalBytesPerVertex),
+            reinterpret_cast<const float*>(tangents + 
+               i * tangentBytesPerVertex), q);
+      Ogre::int16* res = reinterpret_cast<Ogre::int16*>(dst + 
+            i * dstBytesPerVertex);
+      for(int j = 0; j < 4; j++)
+      {
+         res[j] = Simd::floatToSnorm16(q[j]);
+      }
+   }
+}
+
+/***********************************************************************
+ *                         packQTangentsSimd4                          *
+ ***********************************************************************/
+void VertexUtils::packQTangentsSimd4(const uint8_t* normals, 
+      uint32_t normalBytesPerVertex, const uint8_t* tangents, 
+      uint32_t tangentBytesPerVertex, uint8_t* dst, 
+      uint32_t dstBytesPerVertex, uint32_t count)
+{
+   const Simd::Float4 zero = Simd::zero();
+   const Simd::Float4 one = Simd::set1(1.0f);
+   const Simd::Float4 minusOne = Simd::set1(-1.0f);
+   const Simd::Float4 half = Simd::set1(0.5f);
+   const Simd::Float4 quarter = Simd::set1(0.25f);
+   const Simd::Float4 bias = Simd::set1(QTANGENT_BIAS);
+   const Simd::Float4 biasScale = Simd::set1(sqrtf(1.0f - 
+            QTANGENT_BIAS * QTANGENT_BIAS));
+
+   uint32_t i = 0;
+   for( ; i + 4 <= count; i += 4)
+   {
+      /* Load as SoA */
+      Simd::Float4 nx, ny, nz, p;
+      Simd::Float4 tx = Simd::load(reinterpret_cast<const float*>(
+               tangents + i * tangentBytesPerVertex));
+      Simd::Float4 ty = Simd::load(reinterpret_cast<const float*>(
+               tangents + (i + 1) * tangentBytesPerVertex));
+      Simd::Float4 tz = Simd::load(reinterpret_cast<const float*>(
+               tangents + (i + 2) * tangentBytesPerVertex));
+      p = Simd::load(reinterpret_cast<const float*>(
+               tangents + (i + 3) * tangentBytesPerVertex));
+      Simd::transpose(tx, ty, tz, p);
+      {
+         float n[3][4];
+         for(int j = 0; j < 4; j++)
+         {
+            const float* vN = reinterpret_cast<const float*>(
+                  normals + (i + j) * normalBytesPerVertex);
+            n[0][j] = vN[0];
+            n[1][j] = vN[1];
+            n[2][j] = vN[2];
+         }
+         nx = Simd::load(n[0]);
+         ny = Simd::load(n[1]);
+         nz = Simd::load(n[2]);
+      }
+
+      /* Orthonormal frame */
+      Simd::Float4 len = Simd::sqrt(Simd::dot3(nx, ny, nz, nx, ny, nz));
+      Simd::Float4 inv = Simd::div(one, Simd::select(
+               Simd::cmpGt(len, zero), len, one));
+      nx = Simd::mul(nx, inv);
+      ny = Simd::mul(ny, inv);
+      nz = Simd::mul(nz, inv);
+      Simd::Float4 d = Simd::dot3(nx, ny, nz, tx, ty, tz);
+      tx = Simd::sub(tx, Simd::mul(nx, d));
+      ty = Simd::sub(ty, Simd::mul(ny, d));
+      tz = Simd::sub(tz, Simd::mul(nz, d));
+      len = Simd::sqrt(Simd::dot3(tx, ty, tz, tx, ty, tz));
+      inv = Simd::div(one, Simd::select(Simd::cmpGt(len, zero), len, one));
+      tx = Simd::mul(tx, inv);
+      ty = Simd::mul(ty, inv);
+      tz = Simd::mul(tz, inv);
+      Simd::Float4 bx, by, bz;
+      Simd::cross3(nx, ny, nz, tx, ty, tz, bx, by, bz);
+
+      /* Quaternion, from its largest component */
+      Simd::Float4 w2 = Simd::add(one, Simd::add(tx, Simd::add(by, nz)));
+      Simd::Float4 x2 = Simd::add(one, Simd::sub(tx, Simd::add(by, nz)));
+      Simd::Float4 y2 = Simd::add(Simd::sub(one, tx), Simd::sub(by, nz));
+      Simd::Float4 z2 = Simd::sub(Simd::sub(one, tx), Simd::sub(by, nz));
+      Simd::Float4 a = Simd::sub(bz, ny);
+      Simd::Float4 b = Simd::sub(nx, tz);
+      Simd::Float4 c = Simd::sub(ty, bx);
+      Simd::Float4 e = Simd::add(nx, tz);
+      Simd::Float4 f = Simd::add(ny, bz);
+      d = Simd::add(bx, ty);
+
+      Simd::Mask4 isW = Simd::maskAnd(Simd::cmpGe(w2, x2), 
+            Simd::maskAnd(Simd::cmpGe(w2, y2), Simd::cmpGe(w2, z2)));
+      Simd::Mask4 isX = Simd::maskAndNot(Simd::maskAnd(Simd::cmpGe(x2, y2),
+               Simd::cmpGe(x2, z2)), isW);
+      Simd::Mask4 isY = Simd::maskAndNot(Simd::maskAndNot(
+               Simd::cmpGe(y2, z2), isW), isX);
+      Simd::Float4 big2 = Simd::select(isW, w2, Simd::select(isX, x2, 
+               Simd::select(isY, y2, z2)));
+      Simd::Float4 big = Simd::mul(half, Simd::sqrt(big2));
+      inv = Simd::div(quarter, big);
+      a = Simd::mul(a, inv);
+      b = Simd::mul(b, inv);
+      c = Simd::mul(c, inv);
+      d = Simd::mul(d, inv);
+      e = Simd::mul(e, inv);
+      f = Simd::mul(f, inv);
+      Simd::Float4 qx = Simd::select(isW, a, Simd::select(isX, big,
+               Simd::select(isY, d, e)));
+      Simd::Float4 qy = Simd::select(isW, b, Simd::select(isX, d,
+               Simd::select(isY, big, f)));
+      Simd::Float4 qz = Simd::select(isW, c, Simd::select(isX, e,
+               Simd::select(isY, f, big)));
+      Simd::Float4 qw = Simd::select(isW, big, Simd::select(isX, a,
+               Simd::select(isY, b, c)));
+
+      /* Positive non zero w, then its sign as the handedness */
+      Simd::Float4 sign = Simd::select(Simd::cmpLt(qw, zero), minusOne, one);
+      qx = Simd::mul(qx, sign);
+      qy = Simd::mul(qy, sign);
+      qz = Simd::mul(qz, sign);
+      qw = Simd::mul(qw, sign);
+      Simd::Mask4 small = Simd::cmpLt(qw, bias);
+      Simd::Float4 scale = Simd::select(small, biasScale, one);
+      qx = Simd::mul(qx, scale);
+      qy = Simd::mul(qy, scale);
+      qz = Simd::mul(qz, scale);
+      qw = Simd::select(small, bias, qw);
+      sign = Simd::select(Simd::cmpLt(p, zero), minusOne, one);
+      qx = Simd::mul(qx, sign);
+      qy = Simd::mul(qy, sign);
+      qz = Simd::mul(qz, sign);
+      qw = Simd::mul(qw, sign);
+
+      /* Back to AoS */
+      Simd::transpose(qx, qy, qz, qw);
+      Simd::storeSnorm16x4(reinterpret_cast<Ogre::int16*>(
+               dst + i * dstBytesPerVertex), qx);
+      Simd::storeSnorm16x4(reinterpret_cast<Ogre::int16*>(
+               dst + (i + 1) * dstBytesPerVertex), qy);
+      Simd::storeSnorm16x4(reinterpret_cast<Ogre::int16*>(
+               dst + (i + 2) * dstBytesPerVertex), qz);
+      Simd::storeSnorm16x4(reinterpret_cast<Ogre::int16*>(
+               dst + (i + 3) * dstBytesPerVertex), qw);
+   }
+
+   /* Remaining ones */
+   float q[4];
+   for( ; i < count; i++)
+   {
+      calculateQTangent(
+            reinterpret_cast<const float*>(normals + i * normalBytesPerVertex),
+            reinterpret_cast<const float*>(tangents + 
+               i * tangentBytesPerVertex), q);
+      Ogre::int16* res = reinterpret_cast<Ogre::int16*>(dst + 
+            i * dstBytesPerVertex);
+      for(int j = 0; j < 4; j++)
+      {
+         res[j] = Simd::floatToSnorm16(q[j]);
+      }
+   }
+}
+
+/***********************************************************************
+ *                          unpackQTangents                            *
+ ***********************************************************************/
+void VertexUtils::unpackQTangents(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* normals, 
+      uint32_t normalBytesPerVertex, uint8_t* tangents, 
+      uint32_t tangentBytesPerVertex, uint32_t count)
+{
+   uint32_t i = 0;
+   if(simdPath != SIMD_PATH_SCALAR)
+   {
+      /* Only the remaining ones left to us */
+      i = count & ~3u;
+      unpackQTangentsSimd4(src, srcBytesPerVertex, normals, 
+            normalBytesPerVertex, tangents, tangentBytesPerVertex, i);
+   }
+
+   for( ; i < count; i++)
+   {
+      const Ogre::int16* in = reinterpret_cast<const Ogre::int16*>(
+            src + i * srcBytesPerVertex);
+      float q[4];
+      float len = 0.0f;
+      for(int j = 0; j < 4; j++)
+      {
+         q[j] = Simd::snorm16ToFloat(in[j]);
+         len += q[j] * q[j];
+      }
+      len = 1.0f / sqrtf(len);
+      float x = q[0] * len, y = q[1] * len, z = q[2] * len, w = q[3] * len;
+
+      float* vT = reinterpret_cast<float*>(tangents + 
+            i * tangentBytesPerVertex);
+      vT[0] = 1.0f - 2.0f * (y * y + z * z);
+      vT[1] = 2.0f * (x * y + w * z);
+      vT[2] = 2.0f * (x * z - w * y);
+      vT[3] = (w < 0.0f) ? -1.0f : 1.0f;
+
+      float* vN = reinterpret_cast<float*>(normals + 
+            i * normalBytesPerVertex);
+      vN[0] = 2.0f * (x * z + w * y);
+      vN[1] = 2.0f * (y * z - w * x);
+      vN[2] = 1.0f - 2.0f * (x * x + y * y);
+   }
+}
+
+/***********************************************************************
+ *                        unpackQTangentsSimd4                         *
+ ***********************************************************************/
+void VertexUtils::unpackQTangentsSimd4(const uint8_t* src, 
+      uint32_t srcBytesPerVertex, uint8_t* normals, 
+      uint32_t normalBytesPerVertex, uint8_t* tangents, 
+      uint32_t tangentBytesPerVertex, uint32_t count)
+{
+   const Simd::Float4 one = Simd::set1(1.0f);
+   const Simd::Float4 two = Simd::set1(2.0f);
+
+   for(uint32_t i = 0; i + 4 <= count; i += 4)
+   {
+      Simd::Float4 x = Simd::loadSnorm16x4(reinterpret_cast<
+            const Ogre::int16*>(src + i * srcBytesPerVertex));
+      Simd::Float4 y = Simd::loadSnorm16x4(reinterpret_cast<
+            const Ogre::int16*>(src + (i + 1) * srcBytesPerVertex));
+      Simd::Float4 z = Simd::loadSnorm16x4(reinterpret_cast<
+            const Ogre::int16*>(src + (i + 2) * srcBytesPerVertex));
+      Simd::Float4 w = Simd::loadSnorm16x4(reinterpret_cast<
+            const Ogre::int16*>(src + (i + 3) * srcBytesPerVertex));
+      Simd::transpose(x, y, z, w);
+
+      Simd::Float4 inv = Simd::div(one, Simd::sqrt(Simd::add(
+                  Simd::dot3(x, y, z, x, y, z), Simd::mul(w, w))));
+      x = Simd::mul(x, inv);
+      y = Simd::mul(y, inv);
+      z = Simd::mul(z, inv);
+      w = Simd::mul(w, inv);
+
+      /* Tangent (first column) and handedness */
+      Simd::Float4 tx = Simd::sub(one, Simd::mul(two, 
+               Simd::add(Simd::mul(y, y), Simd::mul(z, z))));
+      Simd::Float4 ty = Simd::mul(two, Simd::madd(w, z, Simd::mul(x, y)));
+      Simd::Float4 tz = Simd::mul(two, Simd::sub(Simd::mul(x, z), 
+               Simd::mul(w, y)));
+      Simd::Float4 p = Simd::select(Simd::cmpLt(w, Simd::zero()), 
+            Simd::set1(-1.0f), one);
+
+      /* Normal (third column) */
+      float n[3][4];
+      Simd::store(n[0], Simd::mul(two, Simd::madd(w, y, Simd::mul(x, z))));
+      Simd::store(n[1], Simd::mul(two, Simd::sub(Simd::mul(y, z), 
+                  Simd::mul(w, x))));
+      Simd::store(n[2], Simd::sub(one, Simd::mul(two, 
+                  Simd::add(Simd::mul(x, x), Simd::mul(y, y)))));
+
+      Simd::transpose(tx, ty, tz, p);
+      Simd::store(reinterpret_cast<float*>(tangents + 
+               i * tangentBytesPerVertex), tx);
+      Simd::store(reinterpret_cast<float*>(tangents + 
+               (i + 1) * tangentBytesPerVertex), ty);
+      Simd::store(reinterpret_cast<float*>(tangents + 
+               (i + 2) * tangentBytesPerVertex), tz);
+      Simd::store(reinterpret_cast<float*>(tangents + 
+               (i + 3) * tangentBytesPerVertex), p);
+      for(int j = 0; j < 4; j++)
+      {
+         float* vN = reinterpret_cast<float*>(normals + 
+               (i + j) * normalBytesPerVertex);
+         vN[0] = n[0][j];
+         vN[1] = n[1][j];
+         vN[2] = n[2][j];
+      }
+   }
+}
+
+#endif
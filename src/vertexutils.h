@@ -30,13 +30,174 @@
 #include <OGRE/OgreVector3.h>
 #include <OGRE/Vao/OgreVertexBufferPacked.h>
 
+#include <vector>
+
 namespace Goblin
 {
+   /*! Layout of an interleaved float vertex known only at runtime. 
+    * All values are in floats (not bytes). 
+    * \see StaticVertexLayout */
+   class VertexLayout
+   {
+      public:
+         /*! Constructor
+          * \param floatsPerVertex number of floats on each vertex
+          * \param posIndex index of the position on a vertex
+          * \param normalIndex index of the normal on a vertex
+          * \param tangentIndex index of the tangent (float4) on a vertex
+          * \param uvIndex index of the texture coordinate on a vertex */
+         VertexLayout(Ogre::uint32 floatsPerVertex, Ogre::uint32 posIndex,
+               Ogre::uint32 normalIndex, Ogre::uint32 tangentIndex,
+               Ogre::uint32 uvIndex)
+            : floatsPerVertex(floatsPerVertex), posIndex(posIndex),
+              normalIndex(normalIndex), tangentIndex(tangentIndex),
+              uvIndex(uvIndex) {};
+
+         const Ogre::uint32 floatsPerVertex;
+         const Ogre::uint32 posIndex;
+         const Ogre::uint32 normalIndex;
+         const Ogre::uint32 tangentIndex;
+         const Ogre::uint32 uvIndex;
+   };
+
+   /*! Layout of an interleaved float vertex known at compile time. Using
+    * it, strides and offsets are constants for the kernels, letting the 
+    * compiler unroll and vectorize their gathers. For example, a 
+    * position, normal, tangent, uv vertex would be:
+    * StaticVertexLayout<12, 0, 3, 6, 10> */
+   template<Ogre::uint32 FloatsPerVertex, Ogre::uint32 PosIndex, 
+            Ogre::uint32 NormalIndex, Ogre::uint32 TangentIndex,
+            Ogre::uint32 UvIndex>
+   class StaticVertexLayout
+   {
+      public:
+         enum
+         {
+            floatsPerVertex = FloatsPerVertex,
+            posIndex = PosIndex,
+            normalIndex = NormalIndex,
+            tangentIndex = TangentIndex,
+            uvIndex = UvIndex
+         };
+   };
+
+   /*! Post-transform vertex cache statistics of an index buffer */
+   class VertexCacheStatistics
+   {
+      public:
+         /*! Average cache miss ratio: transformed vertices per triangle. 
+          * Goes from 3.0 (worst) to ~0.5 (best, on regular grids). */
+         Ogre::Real acmr;
+         /*! Average transformed vertex ratio: transformed vertices per 
+          * referenced vertex. 1.0 is the optimal. */
+         Ogre::Real atvr;
+         /*! Total vertices transformed (ie: cache misses) */
+         uint32_t transformedVertices;
+   };
+
+   /*! A cluster of up to a few dozens of neighbour triangles of a mesh
+    * (see #VertexUtils::buildMeshlets), with bounds to cull it on CPU. */
+   class Meshlet
+   {
+      public:
+         /*! \return if all triangles of the meshlet are back facing to
+          * a viewer at viewPos (in the mesh space), and thus could be
+          * culled. Conservative: false when unsure. */
+         bool isBackFacing(const Ogre::Vector3& viewPos) const
+         {
+            Ogre::Vector3 dir = coneApex - viewPos;
+            return dir.dotProduct(coneAxis) > coneCutoff * dir.length();
+         };
+
+         uint32_t vertexOffset;   /**< First one at MeshletList::vertices */
+         uint32_t vertexCount;    /**< Number of vertices */
+         /*! First local index at MeshletList::triangles */
+         uint32_t triangleOffset;
+         uint32_t triangleCount;  /**< Number of triangles */
+
+         Ogre::Vector3 center;    /**< Bounding sphere center */
+         Ogre::Real radius;       /**< Bounding sphere radius */
+
+         /*! Normal cone apex. All triangles are back facing to viewers 
+          * inside the cone with this apex, -coneAxis as axis and 
+          * acos(coneCutoff) as half angle. */
+         Ogre::Vector3 coneApex;
+         /*! Normal cone axis (zero when the triangles normals are too 
+          * spread to be ever culled together). */
+         Ogre::Vector3 coneAxis;
+         /*! Sine of the normal cone spread angle (1 if degenerated) */
+         Ogre::Real coneCutoff;
+   };
+
+   /*! The meshlets of a mesh */
+   class MeshletList
+   {
+      public:
+         /*! Clear all meshlets */
+         void clear()
+         {
+            meshlets.clear();
+            vertices.clear();
+            triangles.clear();
+         };
+
+         std::vector<Meshlet> meshlets; /**< The meshlets */
+         /*! Mesh vertex index of each meshlet vertex */
+         std::vector<uint32_t> vertices;
+         /*! Triangles of each meshlet, 3 indices on its own vertices list 
+          * (thus Meshlet::vertexOffset + index at #vertices). */
+         std::vector<uint8_t> triangles;
+   };
+
    /*! A vertex utils class, with some functions to work on vertices. */
    class VertexUtils
    {
       public:
 
+         /*! Instruction paths usable by the vectorized kernels */
+         enum SimdPath
+         {
+            /*! Plain scalar code (the reference implementation) */
+            SIMD_PATH_SCALAR = 0,
+            /*! 4 vertices per iteration (SSE2 or NEON) */
+            SIMD_PATH_4,
+            /*! 8 vertices per iteration (AVX2, if the CPU supports it) */
+            SIMD_PATH_8
+         };
+
+         /*! How #generateTangentsParallel accumulates the per triangle 
+          * tangents on its vertices. */
+         enum TangentAccumulation
+         {
+            /*! Each thread accumulates its triangles on its own copy of 
+             * the per vertex buffers, merged at the end. Fastest, but 
+             * needs numVertices*2*numThreads Vector3 of scratch memory. */
+            TANGENT_ACCUMULATION_PER_THREAD = 0,
+            /*! Tangents are stored per triangle and each thread owns a 
+             * vertex range, gathering the triangles of its vertices 
+             * through a vertex to triangle adjacency. Scratch memory 
+             * doesn't grow with the number of threads. */
+            TANGENT_ACCUMULATION_VERTEX_OWNER
+         };
+
+         /*! How each triangle normal is weighted when accumulated on its
+          * vertices by #generateNormals */
+         enum NormalWeighting
+         {
+            /*! By the triangle area: big triangles dominate. Cheaper. */
+            NORMAL_WEIGHTING_AREA,
+            /*! By the triangle angle at the vertex: independent of how 
+             * the surface around it was tessellated. */
+            NORMAL_WEIGHTING_ANGLE
+         };
+
+         /*! Define the widest path the vectorized kernels could use. 
+          * By default the widest one supported by the running CPU is used.
+          * \note path is clamped to the ones available. */
+         static void setSimdPath(SimdPath path);
+         /*! \return current path used by the vectorized kernels */
+         static SimdPath getSimdPath() { return simdPath; };
+
          /*! Generate tangents for the vertexData.
           * \param vertexData pointer to the vector of vertex data
           * \param indexData pointer to the index vector (usually triangles)
@@ -53,6 +214,28 @@ namespace Goblin
                Ogre::uint32 vertexCount, Ogre::uint32 indexCount, 
                Ogre::uint32 posIndex, Ogre::uint32 normalIndex,
                Ogre::uint32 tangentIndex, Ogre::uint32 uvIndex);
+         /*! Same as above, for 32 bits index buffers. */
+         static void generateTangents(float* vertexData, 
+               Ogre::uint32* indexData, Ogre::uint32 floatsPerVertex, 
+               Ogre::uint32 vertexCount, Ogre::uint32 indexCount, 
+               Ogre::uint32 posIndex, Ogre::uint32 normalIndex,
+               Ogre::uint32 tangentIndex, Ogre::uint32 uvIndex);
+
+         /*! Generate tangents for the vertexData, specialized for an index
+          * type and a vertex layout.
+          * \param vertexData pointer to the vector of vertex data
+          * \param indexData pointer to the index vector (triangles)
+          * \param vertexCount number of vertices
+          * \param indexCount number of indexes
+          * \param layout the vertex layout. Usually a StaticVertexLayout,
+          *        for which the default constructed one is enough, or a 
+          *        VertexLayout when only known at runtime.
+          * \tparam IndexType Ogre::uint16 or Ogre::uint32 
+          * \tparam Layout StaticVertexLayout or VertexLayout */
+         template<typename IndexType, typename Layout>
+         static void generateTangents(float* vertexData, 
+               const IndexType* indexData, Ogre::uint32 vertexCount, 
+               Ogre::uint32 indexCount, const Layout& layout = Layout());
 
          /** Generates tangents for normal mapping for indexed lists version. 
           * Step 01. The data will be stored into outData.
@@ -100,8 +283,564 @@ namespace Goblin
                uint32_t bytesPerVertex, uint32_t numVertices, 
                uint32_t normalStride, uint32_t tangentStride, 
                Ogre::Vector3* RESTRICT_ALIAS inOutUvBuffer, size_t numThreads);
+
+         /*! Generate tangents for indexed lists using a pool of worker 
+          * threads. The triangle range is split in numThreads consecutive
+          * slices, each one processed by #generateTanUV on its own thread
+          * (with its own scratch buffer), and then the results are merged
+          * and orthogonalized, also in parallel, over vertex ranges.
+          * \param vertexData pointer to the interleaved vertex buffer
+          * \param indexData pointer to the triangle list index buffer
+          * \param bytesPerVertex size of a single vertex, in bytes
+          * \param numVertices number of vertices on vertexData
+          * \param numIndices number of indices on indexData
+          * \param posStride offset (in bytes) of the position on a vertex
+          * \param normalStride offset (in bytes) of the normal on a vertex
+          * \param tangentStride offset (in bytes) of the tangent (float4)
+          * \param uvStride offset (in bytes) of the texture coordinate
+          * \param numThreads number of threads to use. 0 to use the number
+          *        of logical cores. Small meshes will use less threads than
+          *        requested, as it isn't worth spliting them.
+          * \param accumulation how to accumulate the tangents on the 
+          *        vertices. Use TANGENT_ACCUMULATION_VERTEX_OWNER for huge
+          *        meshes on machines with lots of cores.
+          * \note see #getTangentScratchSize for memory used. */
+         static void generateTangentsParallel(uint8_t* vertexData,
+               const uint32_t* indexData, uint32_t bytesPerVertex,
+               uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+               uint32_t normalStride, uint32_t tangentStride, 
+               uint32_t uvStride, size_t numThreads=0,
+               TangentAccumulation accumulation = 
+                  TANGENT_ACCUMULATION_PER_THREAD);
+
+         /*! \return number of threads #generateTangentsParallel will 
+          * really use for a mesh with numIndices when asked for numThreads.*/
+         static size_t getTangentThreadCount(uint32_t numIndices, 
+               size_t numThreads);
+
+         /*! \return scratch memory (in bytes) #generateTangentsParallel 
+          * allocates for a mesh, when asked for numThreads with an 
+          * accumulation mode. */
+         static size_t getTangentScratchSize(uint32_t numVertices, 
+               uint32_t numIndices, size_t numThreads, 
+               TangentAccumulation accumulation);
+
+         /*! Generate smooth normals for indexed lists.
+          * Step 01. Accumulate the weighted normal of each triangle on its
+          * vertices (the #generateTanUV equivalent for normals).
+          * \param weighting how to weight each triangle normal
+          * \param outData buffer to accumulate the results: one vector 
+          *        per vertex, so at least new Vector3[numVertices]. Must be
+          *        zeroed before the call. 
+          * \see generateTanUV for other parameters */
+         static void generateNormalSums(const uint8_t* vertexData, 
+               const uint32_t* indexData, uint32_t bytesPerVertex,
+               uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+               NormalWeighting weighting, 
+               Ogre::Vector3* RESTRICT_ALIAS outData);
+
+         /*! Generate smooth normals for indexed lists.
+          * Step 02 and final step. Merge the sums of all threads, writing
+          * the normalized results to vertexData. Vertices without any 
+          * (non degenerated) triangle keep their current normal.
+          * \param inOutNormalBuffer the buffer filled by 
+          *        #generateNormalSums. With all threads consecutive, thus 
+          *        at least new Vector3[numVertices*numThreads]
+          * \param numThreads number of threads that processed 
+          *        #generateNormalSums */
+         static void generateNormalsMerge(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t normalStride,
+               Ogre::Vector3* RESTRICT_ALIAS inOutNormalBuffer, 
+               size_t numThreads);
+
+         /*! Same as #generateNormalsMerge, only for vertices 
+          * [firstVertex, lastVertex), which could be processed 
+          * concurrently with other ranges. */
+         static void generateNormalsMergeRange(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t normalStride,
+               Ogre::Vector3* RESTRICT_ALIAS inOutNormalBuffer, 
+               size_t numThreads, uint32_t firstVertex, uint32_t lastVertex);
+
+         /*! Generate smooth normals for indexed lists using a pool of 
+          * worker threads, with the same split / merge scheme of 
+          * #generateTangentsParallel (scratch of numVertices vectors per
+          * thread).
+          * \param weighting how to weight each triangle normal
+          * \see generateTangentsParallel for other parameters */
+         static void generateNormals(uint8_t* vertexData,
+               const uint32_t* indexData, uint32_t bytesPerVertex,
+               uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+               uint32_t normalStride, 
+               NormalWeighting weighting = NORMAL_WEIGHTING_ANGLE,
+               size_t numThreads=0);
+
+         /*! Generate both smooth normals and tangents for indexed lists on
+          * a single parallel pass over the index buffer: each triangle is 
+          * read once for both of its contributions, and the tangents are
+          * then orthogonalized against the new normals as soon as they are
+          * merged. Per thread accumulation only (scratch of 
+          * numVertices * 3 vectors per thread).
+          * \see generateNormals
+          * \see generateTangentsParallel */
+         static void generateNormalsAndTangents(uint8_t* vertexData,
+               const uint32_t* indexData, uint32_t bytesPerVertex,
+               uint32_t numVertices, uint32_t numIndices, uint32_t posStride,
+               uint32_t normalStride, uint32_t tangentStride, 
+               uint32_t uvStride,
+               NormalWeighting weighting = NORMAL_WEIGHTING_ANGLE,
+               size_t numThreads=0);
+
+         /*! Reorder the triangles of an index buffer to improve the 
+          * post-transform vertex cache usage, using Tom Forsyth's linear-
+          * speed vertex cache optimisation algorithm.
+          * \param indexData triangle list index buffer to reorder in place
+          * \param numIndices number of indices on indexData
+          * \param numVertices number of vertices referenced by indexData */
+         static void optimizeVertexCache(Ogre::uint16* indexData, 
+               uint32_t numIndices, uint32_t numVertices);
+         static void optimizeVertexCache(Ogre::uint32* indexData, 
+               uint32_t numIndices, uint32_t numVertices);
+
+         /*! Reorder the triangles of an index buffer (already optimized by
+          * #optimizeVertexCache) to reduce overdraw, without losing much of
+          * its vertex cache efficiency: the buffer is split into clusters
+          * that are then sorted to draw the outward facing ones first.
+          * \param vertexData interleaved vertex buffer
+          * \param bytesPerVertex size of a vertex, in bytes
+          * \param posStride offset (in bytes) of the position (float3)
+          * \param threshold how much the ACMR could get worse (1.05 means
+          *        5%). Bigger values mean more clusters to sort. */
+         static void optimizeOverdraw(Ogre::uint16* indexData, 
+               uint32_t numIndices, const uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t posStride, Ogre::Real threshold=1.05f);
+         static void optimizeOverdraw(Ogre::uint32* indexData, 
+               uint32_t numIndices, const uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t posStride, Ogre::Real threshold=1.05f);
+
+         /*! Reorder the vertices on the order they are first used by the 
+          * index buffer, improving the pre-transform (fetch) cache. Index
+          * buffer is remapped to the new order. Not referenced vertices are
+          * kept, after all used ones.
+          * \note should be called after the index buffer optimizations.
+          * \param remap if not NULL, receives the new position of each old
+          *        vertex (must have numVertices elements), to allow 
+          *        reordering other vertex streams of the same mesh. */
+         static void optimizeVertexFetch(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               Ogre::uint16* indexData, uint32_t numIndices, 
+               uint32_t* remap=NULL);
+         static void optimizeVertexFetch(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               Ogre::uint32* indexData, uint32_t numIndices, 
+               uint32_t* remap=NULL);
+
+         /*! Simulate a FIFO post-transform cache to get the ACMR and ATVR 
+          * of an index buffer.
+          * \param cacheSize size of the simulated cache, in vertices. */
+         static VertexCacheStatistics analyzeVertexCache(
+               const Ogre::uint16* indexData, uint32_t numIndices, 
+               uint32_t numVertices, uint32_t cacheSize=16);
+         static VertexCacheStatistics analyzeVertexCache(
+               const Ogre::uint32* indexData, uint32_t numIndices, 
+               uint32_t numVertices, uint32_t cacheSize=16);
+
+         /*! Convert a float vertex stream (usually positions or uvs) to 
+          * half floats, rounding to nearest even.
+          * \param src pointer to the first float of the first element
+          * \param srcBytesPerVertex bytes between two consecutive source
+          *        elements
+          * \param dst pointer to the first half of the first element
+          * \param dstBytesPerVertex bytes between two consecutive 
+          *        destination elements
+          * \param components number of floats per element 
+          * \param count number of elements to convert */
+         static void packHalf(const uint8_t* src, uint32_t srcBytesPerVertex,
+               uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+               uint32_t count);
+         /*! Convert a half float stream back to floats.
+          * \see packHalf */
+         static void unpackHalf(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t components, 
+               uint32_t count);
+
+         /*! Convert a float vertex stream with values in [-1, 1] (usually 
+          * normals) to signed normalized 16 bits integers. Values outside
+          * the range are clamped.
+          * \see packHalf for parameters */
+         static void packSnorm16(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t components, 
+               uint32_t count);
+         /*! Convert a signed normalized 16 bits stream back to floats.
+          * \see packHalf */
+         static void unpackSnorm16(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t components, 
+               uint32_t count);
+
+         /*! Decode a vertex element stream (for example, read back from a 
+          * vertex buffer) to floats, vectorized where possible.
+          * Supported types are VET_FLOAT1 to 4, VET_HALF2 and 4, 
+          * VET_SHORT2_SNORM and 4, VET_USHORT2_NORM and 4, VET_BYTE4_SNORM
+          * and VET_UBYTE4_NORM.
+          * \param src pointer to the element on the first vertex
+          * \param srcBytesPerVertex bytes between two source elements
+          * \param type type of the source elements
+          * \param dst pointer to the first float of the first element
+          * \param dstBytesPerVertex bytes between two decoded elements
+          * \param components number of components to decode from each
+          *        element (up to the ones the type has)
+          * \param count number of elements
+          * \return false if the type isn't supported (or has less 
+          *         components than asked), with nothing decoded. */
+         static bool decodeVertexStream(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, Ogre::VertexElementType type,
+               uint8_t* dst, uint32_t dstBytesPerVertex, 
+               uint32_t components, uint32_t count);
+
+         /*! Encode normals and tangents (with handedness at w, as written by
+          * #generateTangents) as QTangents: the tangent frame rotation as a
+          * quaternion of 4 signed normalized 16 bits, whose w sign is the
+          * handedness (thus 8 bytes per vertex, instead of 28).
+          * Frames aren't required to be orthonormal: the normal is
+          * normalized and the tangent orthogonalized against it first.
+          * \param normals pointer to the first normal (3 floats)
+          * \param normalBytesPerVertex bytes between two normals
+          * \param tangents pointer to the first tangent (4 floats)
+          * \param tangentBytesPerVertex bytes between two tangents
+          * \param dst pointer to the first QTangent (4 Ogre::int16)
+          * \param dstBytesPerVertex bytes between two QTangents
+          * \param count number of vertices */
+         static void packQTangents(const uint8_t* normals, 
+               uint32_t normalBytesPerVertex, const uint8_t* tangents,
+               uint32_t tangentBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t count);
+         /*! Decode QTangents to normals (3 floats) and tangents (4 floats,
+          * with handedness at w).
+          * \see packQTangents */
+         static void unpackQTangents(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* normals, 
+               uint32_t normalBytesPerVertex, uint8_t* tangents,
+               uint32_t tangentBytesPerVertex, uint32_t count);
+
+         /*! Split an indexed triangle list in meshlets: clusters of up 
+          * to maxVertices vertices and maxTriangles triangles, grown 
+          * greedily over neighbour triangles, each one with a bounding 
+          * sphere and a normal cone for CPU frustum and back face culling.
+          * \note better results if the index buffer is already optimized
+          *       by #optimizeVertexCache.
+          * \param vertexData pointer to the vertex buffer
+          * \param bytesPerVertex size of a single vertex, in bytes
+          * \param numVertices number of vertices on vertexData
+          * \param posStride offset (in bytes) of the position on a vertex
+          * \param indexData pointer to the triangle list index buffer
+          * \param numIndices number of indices on indexData
+          * \param out where to put the meshlets (cleared first)
+          * \param maxVertices maximum vertices per meshlet (up to 256)
+          * \param maxTriangles maximum triangles per meshlet */
+         static void buildMeshlets(const uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t posStride, const Ogre::uint16* indexData, 
+               uint32_t numIndices, MeshletList& out, 
+               uint32_t maxVertices=64, uint32_t maxTriangles=124);
+         static void buildMeshlets(const uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t posStride, const Ogre::uint32* indexData, 
+               uint32_t numIndices, MeshletList& out, 
+               uint32_t maxVertices=64, uint32_t maxTriangles=124);
+
+         /*! Simplify an indexed triangle list by vertex clustering: all
+          * vertices inside the same cell of a uniform grid over the mesh
+          * bounds are merged on their average, and triangles collapsed
+          * by it are removed. Fast and robust (any input works), but 
+          * doesn't keep small features, thus best suited for coarse 
+          * proxies (like collision ones), not for rendering.
+          * \param vertices the mesh vertices
+          * \param numVertices number of vertices
+          * \param indexData the triangle list indices
+          * \param numIndices number of indices
+          * \param gridSize number of cells along the longest bounds axis
+          *        (cells are cubes).
+          * \param outVertices receive the simplified vertices
+          * \param outIndices receive the simplified triangle list */
+         static void simplifyByClustering(const Ogre::Vector3* vertices,
+               uint32_t numVertices, const Ogre::uint32* indexData,
+               uint32_t numIndices, uint32_t gridSize,
+               std::vector<Ogre::Vector3>& outVertices,
+               std::vector<Ogre::uint32>& outIndices);
+
+         /*! Rotate and translate positions (usually from model to world 
+          * space), also calculating their bounds. 
+          * \param src positions to transform
+          * \param dst where to write the transformed ones (could be src)
+          * \param count number of positions
+          * \param orientation rotation to apply
+          * \param position translation to apply (after the rotation)
+          * \param outMin receive the minimum of the transformed positions
+          * \param outMax receive the maximum of the transformed positions
+          * \note both are unchanged if count is 0. */
+         static void transformPositions(const Ogre::Vector3* src, 
+               Ogre::Vector3* dst, uint32_t count, 
+               const Ogre::Quaternion& orientation, 
+               const Ogre::Vector3& position, Ogre::Vector3& outMin,
+               Ogre::Vector3& outMax);
+
+         /*! Same as #generateTangentsMergeTUV, but only merging and 
+          * orthogonalizing the vertices [firstVertex, lastVertex). As each
+          * vertex is independent at this step, distinct ranges could be
+          * processed concurrently.
+          * \param vertexData pointer to the first vertex of the buffer 
+          *        (not to firstVertex).
+          * \see generateTangentsMergeTUV */
+         static void generateTangentsMergeTUVRange(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t numVertices, 
+               uint32_t normalStride, uint32_t tangentStride, 
+               Ogre::Vector3* RESTRICT_ALIAS inOutUvBuffer, size_t numThreads,
+               uint32_t firstVertex, uint32_t lastVertex);
+
+      protected:
+         friend class TangentsThreadInfo;
+
+         /*! Calculate tsU and tsV of a single triangle.
+          * \return false if the triangle has no uv area (and thus 
+          *         shouldn't contribute to its vertices tangents). */
+         static bool calculateTriangleTanUV(
+               const uint8_t* vertexData, uint32_t i0, uint32_t i1,
+               uint32_t i2, uint32_t bytesPerVertex, uint32_t posStride,
+               uint32_t uvStride, Ogre::Vector3& tsU, Ogre::Vector3& tsV);
+
+         /*! Calculate the weighted normal of a triangle at each of its
+          * corners.
+          * \param out normals at i0, i1 and i2 corners.
+          * \return false if the triangle is degenerated. */
+         static bool calculateTriangleNormals(const uint8_t* vertexData,
+               uint32_t i0, uint32_t i1, uint32_t i2, 
+               uint32_t bytesPerVertex, uint32_t posStride,
+               NormalWeighting weighting, Ogre::Vector3* out);
+
+         /*! Gram-Schmidt orthogonalize the accumulated tsU against each 
+          * vertex normal, writing the normalized tangent and its handedness 
+          * (calculated with tsV) for vertices [firstVertex, lastVertex).
+          * Dispatch to the kernel of current #SimdPath. 
+          * \param tsU accumulated U vectors, indexed by vertex 
+          * \param tsV accumulated V vectors, indexed by vertex */
+         static void orthogonaliseTangents(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t normalStride,
+               uint32_t tangentStride, const Ogre::Vector3* tsU,
+               const Ogre::Vector3* tsV, uint32_t firstVertex, 
+               uint32_t lastVertex);
+         /*! Scalar (reference) version of #orthogonaliseTangents */
+         static void orthogonaliseTangentsScalar(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t normalStride,
+               uint32_t tangentStride, const Ogre::Vector3* tsU,
+               const Ogre::Vector3* tsV, uint32_t firstVertex, 
+               uint32_t lastVertex);
+         /*! 4-wide version of #orthogonaliseTangents */
+         static void orthogonaliseTangentsSimd4(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t normalStride,
+               uint32_t tangentStride, const Ogre::Vector3* tsU,
+               const Ogre::Vector3* tsV, uint32_t firstVertex, 
+               uint32_t lastVertex);
+         /*! 8-wide version of #orthogonaliseTangents. 
+          * \note only defined when built with AVX2 support 
+          *       (see vertexutils_avx2.h) */
+         static void orthogonaliseTangentsSimd8(uint8_t* vertexData, 
+               uint32_t bytesPerVertex, uint32_t normalStride,
+               uint32_t tangentStride, const Ogre::Vector3* tsU,
+               const Ogre::Vector3* tsV, uint32_t firstVertex, 
+               uint32_t lastVertex);
+         /*! #orthogonaliseTangents for a vertex layout known at compile 
+          * time (see #generateTangents). The scalar path is done here, with
+          * the layout constants. The vectorized kernels are compiled 
+          * within vertexutils.cpp (with its private SIMD wrappers), thus 
+          * still receive the layout strides at runtime.
+          * \param layout the vertex layout
+          * \tparam Layout StaticVertexLayout or VertexLayout */
+         template<typename Layout> 
+         static void orthogonaliseTangents(float* vertexData, 
+               const Ogre::Vector3* tsU, const Ogre::Vector3* tsV, 
+               Ogre::uint32 firstVertex, Ogre::uint32 lastVertex, 
+               const Layout& layout);
+
+         /*! 4 positions per iteration version of #transformPositions.
+          * \param m the rotation matrix, row major */
+         static void transformPositionsSimd4(const Ogre::Vector3* src, 
+               Ogre::Vector3* dst, uint32_t count, const float* m, 
+               const Ogre::Vector3& position, Ogre::Vector3& outMin,
+               Ogre::Vector3& outMax);
+
+         /*! QTangent of a single vertex (the scalar reference).
+          * \param n normal \param t tangent, with handedness at t[3] 
+          * \param q resulting quaternion, as x, y, z, w */
+         static void calculateQTangent(const float* n, const float* t,
+               float* q);
+         /*! 4 vertices version of #packQTangents */
+         static void packQTangentsSimd4(const uint8_t* normals, 
+               uint32_t normalBytesPerVertex, const uint8_t* tangents,
+               uint32_t tangentBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t count);
+         /*! 4 vertices version of #unpackQTangents */
+         static void unpackQTangentsSimd4(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* normals, 
+               uint32_t normalBytesPerVertex, uint8_t* tangents,
+               uint32_t tangentBytesPerVertex, uint32_t count);
+         /*! Float to half conversion of a contiguous array, 8 at a time 
+          * with F16C. 
+          * \note only defined when built with AVX2 support */
+         static void packHalfSimd8(const float* src, Ogre::uint16* dst,
+               uint32_t total);
+         /*! Half to float conversion of a contiguous array, 8 at a time
+          * with F16C. 
+          * \note only defined when built with AVX2 support */
+         static void unpackHalfSimd8(const Ogre::uint16* src, float* dst,
+               uint32_t total);
+
+         /*! Decode the first components of count VET_HALF4 elements,
+          * with a single conversion per element. */
+         static void decodeHalf4(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t components, 
+               uint32_t count);
+         /*! #decodeHalf4 with F16C, two elements per conversion.
+          * \note only defined when built with AVX2 support */
+         static void decodeHalf4Simd8(const uint8_t* src, 
+               uint32_t srcBytesPerVertex, uint8_t* dst, 
+               uint32_t dstBytesPerVertex, uint32_t components, 
+               uint32_t count);
+
+         /*! \return widest #SimdPath supported by this build and CPU */
+         static SimdPath getSupportedSimdPath();
+
+         static SimdPath simdPath; /**< Current path for vector kernels */
 };
 
+/***********************************************************************
+ *                          generateTangents                           *
+ ***********************************************************************/
+template<typename IndexType, typename Layout>
+void VertexUtils::generateTangents(float* vertexData, 
+      const IndexType* indexData, Ogre::uint32 vertexCount, 
+      Ogre::uint32 indexCount, const Layout& layout)
+{
+   /* Create the calculation vector and positionate the second */
+   float* tan1 = new float[vertexCount * 2 * 3];
+   float* tan2 = &tan1[vertexCount * 3];
+
+   /* clear the calculation vector */
+   for(Ogre::uint32 i = 0; i < vertexCount * 2 * 3; i++)
+   {
+      tan1[i] = 0.0f;
+   }
+
+   /* First pass */
+   for(Ogre::uint32 i = 0; i + 3 <= indexCount; i += 3)
+   {
+      /* Define vertex index */
+      Ogre::uint32 i1 = indexData[i];
+      Ogre::uint32 i2 = indexData[i + 1];
+      Ogre::uint32 i3 = indexData[i + 2];
+
+      /* Define position indexes */
+      const float* pi1 = &vertexData[i1 * layout.floatsPerVertex + 
+         layout.posIndex];
+      const float* pi2 = &vertexData[i2 * layout.floatsPerVertex + 
+         layout.posIndex];
+      const float* pi3 = &vertexData[i3 * layout.floatsPerVertex + 
+         layout.posIndex];
+
+      /* Define texture indexes */
+      const float* ti1 = &vertexData[i1 * layout.floatsPerVertex + 
+         layout.uvIndex];
+      const float* ti2 = &vertexData[i2 * layout.floatsPerVertex + 
+         layout.uvIndex];
+      const float* ti3 = &vertexData[i3 * layout.floatsPerVertex + 
+         layout.uvIndex];
+
+      /* Calculate factors */
+      float x1 = pi2[0] - pi1[0];
+      float x2 = pi3[0] - pi1[0];
+      float y1 = pi2[1] - pi1[1];
+      float y2 = pi3[1] - pi1[1];
+      float z1 = pi2[2] - pi1[2];
+      float z2 = pi3[2] - pi1[2];
+
+      float s1 = ti2[0] - ti1[0];
+      float s2 = ti3[0] - ti1[0];
+      float t1 = ti2[1] - ti1[1];
+      float t2 = ti3[1] - ti1[1];
+
+      float r = 1.0F / (s1 * t2 - s2 * t1);
+
+      float sdir[3] = { (t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r,
+                        (t2 * z1 - t1 * z2) * r };
+      float tdir[3] = { (s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r,
+                        (s1 * z2 - s2 * z1) * r };
+
+      for(int k = 0; k < 3; k++)
+      {
+         tan1[(i1 * 3) + k] += sdir[k];
+         tan1[(i2 * 3) + k] += sdir[k];
+         tan1[(i3 * 3) + k] += sdir[k];
+
+         tan2[(i1 * 3) + k] += tdir[k];
+         tan2[(i2 * 3) + k] += tdir[k];
+         tan2[(i3 * 3) + k] += tdir[k];
+      }
+   }
+
+   /* Second pass: Gram-Schmidt orthogonalize and calculate handedness */
+   orthogonaliseTangents(vertexData, 
+         reinterpret_cast<const Ogre::Vector3*>(tan1),
+         reinterpret_cast<const Ogre::Vector3*>(tan2), 0, vertexCount, 
+         layout);
+
+   delete[] tan1;
+}
+
+/***********************************************************************
+ *                        orthogonaliseTangents                        *
+ ***********************************************************************/
+template<typename Layout>
+void VertexUtils::orthogonaliseTangents(float* vertexData, 
+      const Ogre::Vector3* tsU, const Ogre::Vector3* tsV, 
+      Ogre::uint32 firstVertex, Ogre::uint32 lastVertex, 
+      const Layout& layout)
+{
+   if(simdPath != SIMD_PATH_SCALAR)
+   {
+      orthogonaliseTangents(reinterpret_cast<uint8_t*>(vertexData), 
+            layout.floatsPerVertex * sizeof(float), 
+            layout.normalIndex * sizeof(float),
+            layout.tangentIndex * sizeof(float), tsU, tsV, firstVertex,
+            lastVertex);
+      return;
+   }
+
+   for(Ogre::uint32 i = firstVertex; i < lastVertex; i++)
+   {
+      float* vertex = &vertexData[i * layout.floatsPerVertex];
+      const float* n = &vertex[layout.normalIndex];
+      float* t = &vertex[layout.tangentIndex];
+      Ogre::Vector3 normal(n[0], n[1], n[2]);
+
+      /* Gram-Schmidt orthogonalize */
+      Ogre::Vector3 tangent = (tsU[i] - normal * normal.dotProduct(
+               tsU[i])).normalisedCopy();
+      t[0] = tangent.x;
+      t[1] = tangent.y;
+      t[2] = tangent.z;
+
+      /* Calculate handedness */
+      t[3] = normal.crossProduct(tsU[i]).dotProduct(tsV[i]) < 0.0f ? 
+         -1.0f : 1.0f;
+   }
+}
+
 }
 
 #endif
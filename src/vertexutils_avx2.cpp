@@ -0,0 +1,196 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* VertexUtils kernels using AVX2 and F16C (8 vertices per iteration). This
+ * file is the only one built with AVX2 enabled, and its functions are only called
+ * after checking the CPU supports it (see VertexUtils::setSimdPath). 
+ * Keep it to raw intrinsics and its own static helpers: see the note at
+ * vertexutils_avx2.h. */
+
+#include "vertexutils_avx2.h"
+
+#if defined(GOBLIN_SIMD_AVX2)
+
+#include <immintrin.h>
+#include <string.h>
+
+using namespace Goblin;
+
+/***********************************************************************
+ *                        orthogonaliseTangents                        *
+ ***********************************************************************/
+uint32_t Avx2::orthogonaliseTangents(uint8_t* vertexData,
+      uint32_t bytesPerVertex, uint32_t normalStride, uint32_t tangentStride,
+      const float* tsU, const float* tsV, uint32_t firstVertex, 
+      uint32_t lastVertex)
+{
+   /* Gather buffers, to load 8 vertices as SoA */
+   float n[3][8];
+   float u[3][8];
+   float v[3][8];
+
+   const __m256 fZero = _mm256_setzero_ps();
+   const __m256 fOne = _mm256_set1_ps(1.0f);
+   const __m256 fMinusOne = _mm256_set1_ps(-1.0f);
+
+   uint32_t i = firstVertex;
+   for( ; i + 8 <= lastVertex; i += 8 )
+   {
+      for(int j = 0; j < 8; j++)
+      {
+         const float* vNormal = reinterpret_cast<const float*>(
+               vertexData + (i + j) * bytesPerVertex + normalStride);
+         for(int k = 0; k < 3; k++)
+         {
+            n[k][j] = vNormal[k];
+            u[k][j] = tsU[(i + j) * 3 + k];
+            v[k][j] = tsV[(i + j) * 3 + k];
+         }
+      }
+      __m256 nx = _mm256_loadu_ps(n[0]);
+      __m256 ny = _mm256_loadu_ps(n[1]);
+      __m256 nz = _mm256_loadu_ps(n[2]);
+      __m256 ux = _mm256_loadu_ps(u[0]);
+      __m256 uy = _mm256_loadu_ps(u[1]);
+      __m256 uz = _mm256_loadu_ps(u[2]);
+      __m256 vx = _mm256_loadu_ps(v[0]);
+      __m256 vy = _mm256_loadu_ps(v[1]);
+      __m256 vz = _mm256_loadu_ps(v[2]);
+
+      /* Gram-Schmidt orthogonalize */
+      __m256 d = _mm256_fmadd_ps(nx, ux, _mm256_fmadd_ps(ny, uy,
+               _mm256_mul_ps(nz, uz)));
+      __m256 tx = _mm256_fnmadd_ps(nx, d, ux);
+      __m256 ty = _mm256_fnmadd_ps(ny, d, uy);
+      __m256 tz = _mm256_fnmadd_ps(nz, d, uz);
+
+      /* Normalise (keeping zero length ones as they are) */
+      __m256 len = _mm256_sqrt_ps(_mm256_fmadd_ps(tx, tx,
+               _mm256_fmadd_ps(ty, ty, _mm256_mul_ps(tz, tz))));
+      __m256 nonZero = _mm256_cmp_ps(len, fZero, _CMP_GT_OQ);
+      __m256 invLen = _mm256_div_ps(fOne,
+            _mm256_blendv_ps(fOne, len, nonZero));
+      tx = _mm256_mul_ps(tx, invLen);
+      ty = _mm256_mul_ps(ty, invLen);
+      tz = _mm256_mul_ps(tz, invLen);
+
+      /* Calculate handedness */
+      __m256 cx = _mm256_fmsub_ps(ny, uz, _mm256_mul_ps(nz, uy));
+      __m256 cy = _mm256_fmsub_ps(nz, ux, _mm256_mul_ps(nx, uz));
+      __m256 cz = _mm256_fmsub_ps(nx, uy, _mm256_mul_ps(ny, ux));
+      __m256 h = _mm256_fmadd_ps(cx, vx, _mm256_fmadd_ps(cy, vy,
+               _mm256_mul_ps(cz, vz)));
+      __m256 parity = _mm256_blendv_ps(fOne, fMinusOne,
+            _mm256_cmp_ps(h, fZero, _CMP_LT_OQ));
+
+      /* Back to AoS, four vertices at a time */
+      for(int half = 0; half < 2; half++)
+      {
+         __m128 r0 = (half == 0) ? _mm256_castps256_ps128(tx) :
+                                   _mm256_extractf128_ps(tx, 1);
+         __m128 r1 = (half == 0) ? _mm256_castps256_ps128(ty) :
+                                   _mm256_extractf128_ps(ty, 1);
+         __m128 r2 = (half == 0) ? _mm256_castps256_ps128(tz) :
+                                   _mm256_extractf128_ps(tz, 1);
+         __m128 r3 = (half == 0) ? _mm256_castps256_ps128(parity) :
+                                   _mm256_extractf128_ps(parity, 1);
+         _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+         uint8_t* base = vertexData + (i + half * 4) * bytesPerVertex +
+            tangentStride;
+         _mm_storeu_ps(reinterpret_cast<float*>(base), r0);
+         _mm_storeu_ps(reinterpret_cast<float*>(base + bytesPerVertex), r1);
+         _mm_storeu_ps(reinterpret_cast<float*>(base + bytesPerVertex * 2),
+               r2);
+         _mm_storeu_ps(reinterpret_cast<float*>(base + bytesPerVertex * 3),
+               r3);
+      }
+   }
+
+   return i;
+}
+
+/***********************************************************************
+ *                               packHalf                              *
+ ***********************************************************************/
+uint32_t Avx2::packHalf(const float* src, uint16_t* dst, uint32_t total)
+{
+   uint32_t i = 0;
+   for( ; i + 8 <= total; i += 8)
+   {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), 
+            _mm256_cvtps_ph(_mm256_loadu_ps(src + i), 
+               _MM_FROUND_TO_NEAREST_INT));
+   }
+   return i;
+}
+
+/***********************************************************************
+ *                              unpackHalf                             *
+ ***********************************************************************/
+uint32_t Avx2::unpackHalf(const uint16_t* src, float* dst, uint32_t total)
+{
+   uint32_t i = 0;
+   for( ; i + 8 <= total; i += 8)
+   {
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(
+                  reinterpret_cast<const __m128i*>(src + i))));
+   }
+   return i;
+}
+
+/***********************************************************************
+ *                             decodeHalf4                             *
+ ***********************************************************************/
+uint32_t Avx2::decodeHalf4(const uint8_t* src, uint32_t srcBytesPerVertex,
+      uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components, 
+      uint32_t count)
+{
+   /* Elements whose 4 lanes could be stored (as on decodeHalf4) */
+   uint32_t fullStores = 0;
+   if(components == 4)
+   {
+      fullStores = count;
+   }
+   else if(dstBytesPerVertex == components * sizeof(float))
+   {
+      uint32_t tail = (4 * sizeof(float) + dstBytesPerVertex - 1) / 
+         dstBytesPerVertex - 1;
+      fullStores = (count > tail) ? count - tail : 0;
+   }
+
+   uint32_t i = 0;
+   for( ; i + 2 <= fullStores; i += 2)
+   {
+      long long e0, e1;
+      memcpy(&e0, src + i * srcBytesPerVertex, 8);
+      memcpy(&e1, src + (i + 1) * srcBytesPerVertex, 8);
+      __m256 v = _mm256_cvtph_ps(_mm_set_epi64x(e1, e0));
+      _mm_storeu_ps(reinterpret_cast<float*>(dst + i * dstBytesPerVertex),
+            _mm256_castps256_ps128(v));
+      _mm_storeu_ps(reinterpret_cast<float*>(dst + 
+               (i + 1) * dstBytesPerVertex), _mm256_extractf128_ps(v, 1));
+   }
+
+   return i;
+}
+
+#endif
+
@@ -0,0 +1,67 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _goblin_vertex_utils_avx2_h
+#define _goblin_vertex_utils_avx2_h
+
+#include <stdint.h>
+
+namespace Goblin
+{
+
+/*! AVX2, FMA and F16C kernels of VertexUtils (8 vertices per iteration).
+ * They're defined on the only file built with these instructions enabled,
+ * thus must only be called after checking the CPU supports them (see 
+ * VertexUtils::setSimdPath), and only do the full 8 element iterations,
+ * leaving the remaining ones to the caller.
+ * \note as the compiler could emit, with AVX2 instructions, its own
+ *       copies of any inline function it uses (which the linker could 
+ *       pick for the other files too), this interface and its file 
+ *       use no Ogre or Simd types or functions. */
+namespace Avx2
+{
+   /*! VertexUtils::orthogonaliseTangents kernel
+    * \param tsU accumulated U vectors, as 3 floats per vertex
+    * \param tsV accumulated V vectors, as 3 floats per vertex
+    * \return first vertex not done */
+   uint32_t orthogonaliseTangents(uint8_t* vertexData, 
+         uint32_t bytesPerVertex, uint32_t normalStride, 
+         uint32_t tangentStride, const float* tsU, const float* tsV,
+         uint32_t firstVertex, uint32_t lastVertex);
+
+   /*! Float to half conversion of a contiguous array
+    * \return number of values converted */
+   uint32_t packHalf(const float* src, uint16_t* dst, uint32_t total);
+
+   /*! Half to float conversion of a contiguous array
+    * \return number of values converted */
+   uint32_t unpackHalf(const uint16_t* src, float* dst, uint32_t total);
+
+   /*! VertexUtils::decodeHalf4 kernel, two elements per conversion.
+    * \return number of elements decoded */
+   uint32_t decodeHalf4(const uint8_t* src, uint32_t srcBytesPerVertex,
+         uint8_t* dst, uint32_t dstBytesPerVertex, uint32_t components,
+         uint32_t count);
+}
+
+}
+
+#endif
+
@@ -0,0 +1,673 @@
+/*
+ Goblin - An Ogre3D Utility Library
+ Copyright (C) DNTeam <goblin@dnteam.org>
+
+ This file is part of Goblin.
+
+ Goblin is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ Goblin is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with Goblin.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Headless tests of VertexUtils vectorized kernels, checking that each
+ * SIMD path agrees with the scalar (reference) one, and that the vertex
+ * stream compressions round trip within their error bounds. No render
+ * system (nor Ogre::Root) is needed.
+ *
+ * Usage: goblin_test_vertexutils
+ *    Returns 0 if all checks passed, 1 otherwise (printing the failed
+ *    ones to stderr). */
+
+#include "vertexutils.h"
+
+#if OGRE_VERSION_MAJOR >= 2
+
+#include "simd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+using namespace Goblin;
+
+#define TEST_FLOATS_PER_VERTEX   12
+#define TEST_BYTES_PER_VERTEX    (TEST_FLOATS_PER_VERTEX * sizeof(float))
+#define TEST_NORMAL_STRIDE       (3 * sizeof(float))
+#define TEST_TANGENT_STRIDE      (6 * sizeof(float))
+
+/*! Maximum difference allowed between the tangents of two kernels */
+#define TEST_TANGENT_TOLERANCE   1e-4f
+
+/*! A failed checks counter, with its report */
+class TestResult
+{
+   public:
+      TestResult()
+      {
+         failures = 0;
+         checks = 0;
+      }
+
+      /*! Count a check, reporting it if failed.
+       * \return ok */
+      bool check(bool ok, const char* test, const char* what, uint32_t i)
+      {
+         checks++;
+         if(!ok)
+         {
+            failures++;
+            if(failures <= 20)
+            {
+               fprintf(stderr, "FAILED %s: %s (element %u)\n", test, what,
+                     i);
+            }
+         }
+         return ok;
+      }
+
+      uint32_t failures;
+      uint32_t checks;
+};
+
+/*! A set of per vertex tangent space inputs for the orthogonalise pass */
+class TestTangentSpace
+{
+   public:
+      /*! Create count vertices, with a case of degenerated inputs each
+       * few ones (mixed with random ones, so the SIMD kernels see them
+       * in different lanes). */
+      TestTangentSpace(const char* meshName, uint32_t count,
+            bool degenerated)
+      {
+         name = meshName;
+         vertices.resize(count * TEST_FLOATS_PER_VERTEX, 0.0f);
+         tsU.resize(count);
+         tsV.resize(count);
+         for(uint32_t i = 0; i < count; i++)
+         {
+            Ogre::Vector3 n = randomUnit();
+            Ogre::Vector3 u = randomVector() * 10.0f;
+            Ogre::Vector3 v = randomVector() * 10.0f;
+            if(degenerated)
+            {
+               switch(i % 7)
+               {
+                  case 0:
+                     /* Zero area triangles only: nothing accumulated */
+                     u = Ogre::Vector3::ZERO;
+                     v = Ogre::Vector3::ZERO;
+                  break;
+                  case 2:
+                     /* U parallel to the normal: nothing left after
+                      * orthogonalising (axis aligned, to be exactly
+                      * zero in all kernels). */
+                     n = Ogre::Vector3(0.0f, 0.0f, (i & 8) ? -1.0f : 1.0f);
+                     u = Ogre::Vector3(0.0f, 0.0f, 3.0f);
+                  break;
+                  case 4:
+                     /* No V direction */
+                     v = Ogre::Vector3::ZERO;
+                  break;
+                  case 5:
+                     /* Not yet calculated normal */
+                     n = Ogre::Vector3::ZERO;
+                  break;
+                  default:
+                  break;
+               }
+            }
+            float* f = &vertices[i * TEST_FLOATS_PER_VERTEX];
+            f[3] = n.x; f[4] = n.y; f[5] = n.z;
+            tsU[i] = u;
+            tsV[i] = v;
+         }
+      }
+
+      /*! \return a random float in [-1, 1] */
+      static float random()
+      {
+         return (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+      }
+      /*! \return a random vector with coordinates in [-1, 1] */
+      static Ogre::Vector3 randomVector()
+      {
+         return Ogre::Vector3(random(), random(), random());
+      }
+      /*! \return a random unit vector */
+      static Ogre::Vector3 randomUnit()
+      {
+         Ogre::Vector3 v;
+         do
+         {
+            v = randomVector();
+         } while(v.squaredLength() < 0.01f);
+         v.normalise();
+         return v;
+      }
+
+      const char* name;
+      std::vector<float> vertices;
+      std::vector<Ogre::Vector3> tsU;
+      std::vector<Ogre::Vector3> tsV;
+};
+
+/*! The tests, deriving from VertexUtils to reach each kernel directly */
+class VertexUtilsTest : public VertexUtils
+{
+   public:
+      /*! Signature of the orthogonalise kernels */
+      typedef void (*OrthogonaliseFunction)(uint8_t* vertexData,
+            uint32_t bytesPerVertex, uint32_t normalStride,
+            uint32_t tangentStride, const Ogre::Vector3* tsU,
+            const Ogre::Vector3* tsV, uint32_t firstVertex,
+            uint32_t lastVertex);
+
+      /*! Check that the kernel agrees with the scalar one on the
+       * mesh, on [first, last) vertices. */
+      static void testOrthogonalise(TestResult& result,
+            const char* kernelName, OrthogonaliseFunction kernel,
+            const TestTangentSpace& mesh, uint32_t first, uint32_t last)
+      {
+         char test[128];
+         snprintf(test, sizeof(test), "orthogonaliseTangents%s %s [%u, %u)",
+               kernelName, mesh.name, first, last);
+
+         /* Mark the tangents, to check the vertices out of range are
+          * left untouched. */
+         std::vector<float> expected = mesh.vertices;
+         std::vector<float> got = mesh.vertices;
+         for(size_t i = 6; i < got.size(); i += TEST_FLOATS_PER_VERTEX)
+         {
+            expected[i] = got[i] = 123.0f;
+         }
+
+         orthogonaliseTangentsScalar((uint8_t*)&expected[0],
+               TEST_BYTES_PER_VERTEX, TEST_NORMAL_STRIDE,
+               TEST_TANGENT_STRIDE, &mesh.tsU[0], &mesh.tsV[0], first, last);
+         kernel((uint8_t*)&got[0], TEST_BYTES_PER_VERTEX,
+               TEST_NORMAL_STRIDE, TEST_TANGENT_STRIDE, &mesh.tsU[0],
+               &mesh.tsV[0], first, last);
+
+         uint32_t count = (uint32_t)mesh.tsU.size();
+         for(uint32_t i = 0; i < count; i++)
+         {
+            const float* e = &expected[i * TEST_FLOATS_PER_VERTEX + 6];
+            const float* g = &got[i * TEST_FLOATS_PER_VERTEX + 6];
+            if(i < first || i >= last)
+            {
+               result.check(g[0] == 123.0f, test, "vertex out of range "
+                     "was written", i);
+               continue;
+            }
+            bool ok = true;
+            for(int c = 0; c < 3; c++)
+            {
+               ok &= (fabsf(e[c] - g[c]) <= TEST_TANGENT_TOLERANCE);
+            }
+            if(!result.check(ok, test, "tangent differs", i))
+            {
+               continue;
+            }
+
+            /* Handedness is only meaningful when its triple product
+             * isn't about zero (where rounding could flip it). */
+            const Ogre::Vector3* n = reinterpret_cast<const Ogre::Vector3*>(
+                  &mesh.vertices[i * TEST_FLOATS_PER_VERTEX + 3]);
+            float h = n->crossProduct(mesh.tsU[i]).dotProduct(mesh.tsV[i]);
+            float scale = mesh.tsU[i].length() * mesh.tsV[i].length();
+            if(fabsf(h) > 1e-4f * scale || scale == 0.0f)
+            {
+               result.check(e[3] == g[3], test, "handedness differs", i);
+            }
+         }
+      }
+
+      /*! Run the orthogonalise tests over each available kernel */
+      static void testOrthogonalise(TestResult& result)
+      {
+         /* Counts not multiple of 4 nor 8, to exercise the tails */
+         TestTangentSpace random("random", 1003, false);
+         TestTangentSpace degenerated("degenerated", 517, true);
+         TestTangentSpace tiny("tiny", 3, true);
+         const TestTangentSpace* meshes[] = {&random, &degenerated, &tiny};
+
+         for(int m = 0; m < 3; m++)
+         {
+            const TestTangentSpace& mesh = *meshes[m];
+            uint32_t count = (uint32_t)mesh.tsU.size();
+            /* The whole mesh and a range with unaligned start and end,
+             * as done by each thread of generateTangentsParallel. */
+            uint32_t ranges[2][2] = {{0, count}, {count / 3 + 1, count - 2}};
+            for(int r = 0; r < 2; r++)
+            {
+               testOrthogonalise(result, "Simd4",
+                     orthogonaliseTangentsSimd4, mesh, ranges[r][0],
+                     ranges[r][1]);
+#if defined(GOBLIN_SIMD_AVX2)
+               if(Simd::hasAvx2())
+               {
+                  testOrthogonalise(result, "Simd8",
+                        orthogonaliseTangentsSimd8, mesh, ranges[r][0],
+                        ranges[r][1]);
+               }
+#endif
+            }
+         }
+      }
+
+      /*! Check that generateTangents, with a compile time layout, gives
+       * the same tangents (within the kernels tolerance) on each available
+       * #SimdPath than on the scalar one. */
+      static void testGenerateTangents(TestResult& result)
+      {
+         typedef StaticVertexLayout<TEST_FLOATS_PER_VERTEX, 0, 3, 6, 10> 
+            Layout;
+
+         /* A waved grid, with its analytic normals */
+         const uint32_t side = 21;
+         std::vector<float> mesh((side + 1) * (side + 1) * 
+               TEST_FLOATS_PER_VERTEX, 0.0f);
+         for(uint32_t z = 0; z <= side; z++)
+         {
+            for(uint32_t x = 0; x <= side; x++)
+            {
+               float u = x / (float)side;
+               float v = z / (float)side;
+               float* f = &mesh[(z * (side + 1) + x) * 
+                  TEST_FLOATS_PER_VERTEX];
+               f[0] = u * 10.0f; 
+               f[1] = sinf(u * 6.0f) * cosf(v * 6.0f);
+               f[2] = v * 10.0f;
+               Ogre::Vector3 n(-0.6f * cosf(u * 6.0f) * cosf(v * 6.0f), 1.0f,
+                     0.6f * sinf(u * 6.0f) * sinf(v * 6.0f));
+               n.normalise();
+               f[3] = n.x; f[4] = n.y; f[5] = n.z;
+               /* Mirrored uvs on half of the grid, for both handedness */
+               f[10] = (x < side / 2) ? u : 1.0f - u;
+               f[11] = v;
+            }
+         }
+         std::vector<Ogre::uint32> indices;
+         for(uint32_t z = 0; z < side; z++)
+         {
+            for(uint32_t x = 0; x < side; x++)
+            {
+               Ogre::uint32 a = z * (side + 1) + x;
+               Ogre::uint32 b = a + side + 1;
+               Ogre::uint32 quad[6] = {a, b, a + 1, a + 1, b, b + 1};
+               indices.insert(indices.end(), quad, quad + 6);
+            }
+         }
+         uint32_t vertexCount = (side + 1) * (side + 1);
+
+         SimdPath defaultPath = getSimdPath();
+         setSimdPath(SIMD_PATH_SCALAR);
+         std::vector<float> expected = mesh;
+         generateTangents(&expected[0], &indices[0], vertexCount,
+               (Ogre::uint32)indices.size(), Layout());
+
+         const char* names[] = {"generateTangents 4", "generateTangents 8"};
+         SimdPath paths[] = {SIMD_PATH_4, SIMD_PATH_8};
+         for(int p = 0; p < 2; p++)
+         {
+            setSimdPath(paths[p]);
+            if(getSimdPath() != paths[p])
+            {
+               continue;
+            }
+            std::vector<float> got = mesh;
+            generateTangents(&got[0], &indices[0], vertexCount,
+                  (Ogre::uint32)indices.size(), Layout());
+            for(uint32_t i = 0; i < vertexCount; i++)
+            {
+               const float* e = &expected[i * TEST_FLOATS_PER_VERTEX + 6];
+               const float* g = &got[i * TEST_FLOATS_PER_VERTEX + 6];
+               bool ok = true;
+               for(int c = 0; c < 3; c++)
+               {
+                  ok &= (fabsf(e[c] - g[c]) <= TEST_TANGENT_TOLERANCE);
+               }
+               result.check(ok, names[p], "tangent differs", i);
+               result.check(e[3] == g[3], names[p], "handedness differs", i);
+            }
+         }
+         setSimdPath(defaultPath);
+      }
+
+      /*! Signature of the stream conversion functions */
+      typedef void (*StreamFunction)(const uint8_t* src, 
+            uint32_t srcBytesPerVertex, uint8_t* dst, 
+            uint32_t dstBytesPerVertex, uint32_t components, uint32_t count);
+
+      /*! Convert src (3 components per element) with the function, 
+       * either tightly packed or with a padding component (the last won't
+       * take the contiguous 8-wide paths).
+       * \param dst receive the converted components, tightly packed */
+      template<typename Src, typename Dst> static void convert(
+            StreamFunction function, const std::vector<Src>& src, 
+            std::vector<Dst>& dst, bool strided)
+      {
+         uint32_t count = (uint32_t)(src.size() / 3);
+         uint32_t srcStride = (strided ? 4 : 3) * sizeof(Src);
+         uint32_t dstStride = (strided ? 4 : 3) * sizeof(Dst);
+         std::vector<uint8_t> in(count * srcStride, 0);
+         std::vector<uint8_t> out(count * dstStride, 0);
+         for(uint32_t i = 0; i < count * 3; i++)
+         {
+            memcpy(&in[(i / 3) * srcStride + (i % 3) * sizeof(Src)], 
+                  &src[i], sizeof(Src));
+         }
+         function(&in[0], srcStride, &out[0], dstStride, 3, count);
+         dst.resize(count * 3);
+         for(uint32_t i = 0; i < count * 3; i++)
+         {
+            memcpy(&dst[i], &out[(i / 3) * dstStride + 
+                  (i % 3) * sizeof(Dst)], sizeof(Dst));
+         }
+      }
+
+      /*! \return value of the half h, calculated in double */
+      static double halfValue(uint16_t h)
+      {
+         int e = (h >> 10) & 0x1F;
+         int m = h & 0x3FF;
+         double v;
+         if(e == 0x1F)
+         {
+            v = (m == 0) ? HUGE_VAL : NAN;
+         }
+         else if(e == 0)
+         {
+            v = ldexp((double)m, -24);
+         }
+         else
+         {
+            v = ldexp((double)(1024 + m), e - 25);
+         }
+         return (h & 0x8000) ? -v : v;
+      }
+
+      /*! \return if h is a half NaN */
+      static bool isHalfNaN(uint16_t h)
+      {
+         return ((h & 0x7C00) == 0x7C00) && ((h & 0x3FF) != 0);
+      }
+
+      /*! Half float round trips on current #SimdPath */
+      static void testHalf(TestResult& result, const char* path, 
+            bool strided)
+      {
+         char test[128];
+         snprintf(test, sizeof(test), "half %s%s", path, 
+               strided ? " strided" : "");
+
+         /* Each half (including subnormals, infinities and NaNs) must
+          * decode to its exact value and encode back to itself. */
+         std::vector<uint16_t> halfs(65538, 0);
+         for(uint32_t i = 0; i < 65536; i++)
+         {
+            halfs[i] = (uint16_t)i;
+         }
+         std::vector<float> floats;
+         std::vector<uint16_t> back;
+         convert(unpackHalf, halfs, floats, strided);
+         convert(packHalf, floats, back, strided);
+         for(uint32_t i = 0; i < 65536; i++)
+         {
+            if(isHalfNaN((uint16_t)i))
+            {
+               result.check(isnan(floats[i]), test, "NaN not decoded as NaN",
+                     i);
+               result.check(isHalfNaN(back[i]), test, 
+                     "NaN not encoded as NaN", i);
+               continue;
+            }
+            double expected = halfValue((uint16_t)i);
+            result.check((floats[i] == expected) && 
+                  (signbit(floats[i]) == signbit(expected)), test, 
+                  "wrong decoded value", i);
+            result.check(back[i] == i, test, "decode-encode changed it", i);
+         }
+
+         /* Floats to half and back: error bounded by half an ulp (of the 
+          * subnormal spacing, on the subnormal range), saturating to
+          * infinity only past the biggest half (65504) midpoint. */
+         float specials[] = {0.0f, -0.0f, 1.0f, -1.0f, 65504.0f, -65504.0f,
+            65519.0f, -65519.0f, 65520.0f, -65520.0f, 1e10f, -1e10f,
+            HUGE_VALF, -HUGE_VALF, NAN, 6.1035156e-5f, -6.1035156e-5f,
+            5.9604645e-8f, -5.9604645e-8f, 2.9802322e-8f, 1e-40f, -1e-40f,
+            3.0e-5f, -4.2e-6f, 0.33333334f, 2048.5f, 2049.0f};
+         uint32_t numSpecials = sizeof(specials) / sizeof(float);
+         std::vector<float> values(specials, specials + numSpecials);
+         for(uint32_t i = 0; i < 3000; i++)
+         {
+            float mag = ldexpf(1.0f + TestTangentSpace::random() * 0.5f,
+                  (rand() % 44) - 27);
+            values.push_back((rand() & 1) ? mag : -mag);
+         }
+         while(values.size() % 3 != 0)
+         {
+            values.push_back(0.0f);
+         }
+         std::vector<uint16_t> packed;
+         std::vector<float> unpacked;
+         convert(packHalf, values, packed, strided);
+         convert(unpackHalf, packed, unpacked, strided);
+         for(uint32_t i = 0; i < values.size(); i++)
+         {
+            float v = values[i];
+            float r = unpacked[i];
+            if(isnan(v))
+            {
+               result.check(isnan(r), test, "NaN lost", i);
+               continue;
+            }
+            result.check(signbit(v) == signbit(r), test, "sign lost", i);
+            float a = fabsf(v);
+            if(a >= 65520.0f)
+            {
+               result.check(isinf(r), test, "overflow isn't infinity", i);
+            }
+            else
+            {
+               double maxError = (a < 6.1035156e-5f) ? ldexp(1.0, -25) : 
+                  ldexp((double)a, -11);
+               result.check(fabs((double)r - v) <= maxError, test, 
+                     "error too big", i);
+            }
+         }
+      }
+
+      /*! Signed normalized 16 bits round trips on current #SimdPath */
+      static void testSnorm16(TestResult& result, const char* path,
+            bool strided)
+      {
+         char test[128];
+         snprintf(test, sizeof(test), "snorm16 %s%s", path, 
+               strided ? " strided" : "");
+
+         float specials[] = {0.0f, 1.0f, -1.0f, 1.5f, -7.0f, 0.5f, -0.5f,
+            1.0f / 32767.0f, -1.0f / 32767.0f, 0.99999f, -0.99999f,
+            1e-30f, -1e-30f};
+         uint32_t numSpecials = sizeof(specials) / sizeof(float);
+         std::vector<float> values(specials, specials + numSpecials);
+         for(uint32_t i = 0; i < 3000; i++)
+         {
+            values.push_back(TestTangentSpace::random());
+         }
+         while(values.size() % 3 != 0)
+         {
+            values.push_back(0.0f);
+         }
+         std::vector<Ogre::int16> packed;
+         std::vector<float> unpacked;
+         convert(packSnorm16, values, packed, strided);
+         convert(unpackSnorm16, packed, unpacked, strided);
+         for(uint32_t i = 0; i < values.size(); i++)
+         {
+            float v = values[i];
+            float clamped = (v > 1.0f) ? 1.0f : ((v < -1.0f) ? -1.0f : v);
+            if(fabsf(clamped) == 1.0f)
+            {
+               /* The range limits must be exact */
+               result.check(packed[i] == (clamped > 0.0f ? 32767 : -32767),
+                     test, "limit not exactly encoded", i);
+               result.check(unpacked[i] == clamped, test, 
+                     "limit not exactly decoded", i);
+               continue;
+            }
+            result.check(fabsf(unpacked[i] - clamped) <= 
+                  0.5f / 32767.0f + 1e-7f, test, "error too big", i);
+         }
+
+         /* -32768 is out of the symmetric range: must decode to -1 */
+         std::vector<Ogre::int16> minimum(3, -32768);
+         convert(unpackSnorm16, minimum, unpacked, strided);
+         result.check(unpacked[0] == -1.0f, test, "-32768 isn't -1", 0);
+      }
+
+      /*! Check a decoded QTangent vector against the original one */
+      static bool closeTo(const float* a, const float* b)
+      {
+         const float tolerance = 1e-3f;
+         return (fabsf(a[0] - b[0]) <= tolerance) && 
+                (fabsf(a[1] - b[1]) <= tolerance) &&
+                (fabsf(a[2] - b[2]) <= tolerance);
+      }
+
+      /*! QTangents round trips on current #SimdPath */
+      static void testQTangents(TestResult& result, const char* path)
+      {
+         char test[128];
+         snprintf(test, sizeof(test), "qtangents %s", path);
+
+         /* All the axis aligned frames, with both handedness (including
+          * the half turn rotations, whose w is zero before the bias), 
+          * followed by random ones. */
+         std::vector<float> normals;
+         std::vector<float> tangents;
+         for(int n = 0; n < 6; n++)
+         {
+            for(int t = 0; t < 6; t++)
+            {
+               if((n / 2) == (t / 2))
+               {
+                  continue;
+               }
+               for(int h = 0; h < 2; h++)
+               {
+                  float nv[3] = {0.0f, 0.0f, 0.0f};
+                  float tv[4] = {0.0f, 0.0f, 0.0f, h ? -1.0f : 1.0f};
+                  nv[n / 2] = (n & 1) ? -1.0f : 1.0f;
+                  tv[t / 2] = (t & 1) ? -1.0f : 1.0f;
+                  normals.insert(normals.end(), nv, nv + 3);
+                  tangents.insert(tangents.end(), tv, tv + 4);
+               }
+            }
+         }
+         for(uint32_t i = 0; i < 1001; i++)
+         {
+            Ogre::Vector3 n = TestTangentSpace::randomUnit();
+            Ogre::Vector3 t;
+            do
+            {
+               t = TestTangentSpace::randomUnit();
+               t = t - n * n.dotProduct(t);
+            } while(t.squaredLength() < 0.01f);
+            t.normalise();
+            normals.push_back(n.x); normals.push_back(n.y); 
+            normals.push_back(n.z);
+            tangents.push_back(t.x); tangents.push_back(t.y);
+            tangents.push_back(t.z); 
+            tangents.push_back((rand() & 1) ? -1.0f : 1.0f);
+         }
+
+         uint32_t count = (uint32_t)(normals.size() / 3);
+         std::vector<Ogre::int16> packed(count * 4);
+         std::vector<float> outNormals(count * 3);
+         std::vector<float> outTangents(count * 4);
+         packQTangents((const uint8_t*)&normals[0], 3 * sizeof(float), 
+               (const uint8_t*)&tangents[0], 4 * sizeof(float), 
+               (uint8_t*)&packed[0], 4 * sizeof(Ogre::int16), count);
+         unpackQTangents((const uint8_t*)&packed[0], 
+               4 * sizeof(Ogre::int16), (uint8_t*)&outNormals[0], 
+               3 * sizeof(float), (uint8_t*)&outTangents[0], 
+               4 * sizeof(float), count);
+         for(uint32_t i = 0; i < count; i++)
+         {
+            result.check(closeTo(&normals[i * 3], &outNormals[i * 3]), test,
+                  "normal error too big", i);
+            result.check(closeTo(&tangents[i * 4], &outTangents[i * 4]), 
+                  test, "tangent error too big", i);
+            result.check(outTangents[i * 4 + 3] == tangents[i * 4 + 3], 
+                  test, "handedness lost", i);
+         }
+      }
+
+      /*! Run the round trip tests on each available #SimdPath */
+      static void testRoundTrips(TestResult& result)
+      {
+         SimdPath defaultPath = getSimdPath();
+         const char* names[] = {"scalar", "4", "8"};
+         SimdPath paths[] = {SIMD_PATH_SCALAR, SIMD_PATH_4, SIMD_PATH_8};
+         for(int p = 0; p < 3; p++)
+         {
+            setSimdPath(paths[p]);
+            if(getSimdPath() != paths[p])
+            {
+               printf("SIMD path %s not available: skipped.\n", names[p]);
+               continue;
+            }
+            for(int strided = 0; strided < 2; strided++)
+            {
+               testHalf(result, names[p], strided != 0);
+               testSnorm16(result, names[p], strided != 0);
+            }
+            testQTangents(result, names[p]);
+         }
+         setSimdPath(defaultPath);
+      }
+};
+
+int main(int argc, char* argv[])
+{
+   TestResult result;
+   srand(42);
+
+   VertexUtilsTest::testOrthogonalise(result);
+   VertexUtilsTest::testGenerateTangents(result);
+   VertexUtilsTest::testRoundTrips(result);
+
+   bool avx2 = false;
+#if defined(GOBLIN_SIMD_AVX2)
+   avx2 = Simd::hasAvx2();
+#endif
+   printf("%u checks, %u failed (8-wide kernels %s)\n", result.checks,
+         result.failures, avx2 ? "tested" : "not available");
+
+   return (result.failures == 0) ? 0 : 1;
+}
+
+#else
+
+#include <stdio.h>
+
+int main(int argc, char* argv[])
+{
+   printf("VertexUtils tests need Ogre 2 or newer: skipped.\n");
+   return 0;
+}
+
+#endif
+